@@ -15,13 +15,27 @@
 //#define ENABLE_DEBUG
 
 // Function pointers to init routines in the binary, so we can resume
-// regular execution of the function that we hooked.
-extern void (*__bolt_hugify_init_ptr)();
+// regular execution of the function that we hooked. The pointer holds the
+// link-time address of the routine.
+extern void (*__bolt_hugify_init_ptr)()
+    __attribute__((visibility("hidden")));
 
 // The __hot_start and __hot_end symbols set by Bolt. We use them to figure
 // out the rage for marking huge pages.
-extern uint64_t __hot_start;
-extern uint64_t __hot_end;
+extern uint64_t __hot_start __attribute__((visibility("hidden")));
+extern uint64_t __hot_end __attribute__((visibility("hidden")));
+
+/// Return the difference between the run-time and the link-time addresses of
+/// the binary. RuntimeDyld resolves the absolute reference at link time while
+/// the PC-relative one reflects the address the binary was loaded at.
+static uint64_t getLoadBias() {
+  uint64_t RunTimeAddr;
+  uint64_t LinkTimeAddr;
+  __asm__ __volatile__("leaq __hot_start(%%rip), %0\n"
+                       "movabsq $__hot_start, %1\n"
+                       : "=r"(RunTimeAddr), "=r"(LinkTimeAddr));
+  return RunTimeAddr - LinkTimeAddr;
+}
 
 #ifdef MADV_HUGEPAGE
 /// Check whether the kernel supports THP via corresponding sysfs entry.
@@ -85,7 +99,14 @@ static void hugify_for_old_kernel(uint8_t *from, uint8_t *to) {
 }
 #endif
 
-extern "C" void __bolt_hugify_self_impl() {
+/// Remap hot text to huge pages. Return the run-time address of the init
+/// routine, i.e. __bolt_hugify_init_ptr adjusted by the load bias of PIE
+/// executables and shared objects. The runtime has no writable data, as the
+/// sections of the runtime library are placed with the code.
+extern "C" uint64_t __bolt_hugify_self_impl() {
+  const uint64_t loadBias = getLoadBias();
+  const uint64_t initAddr =
+      reinterpret_cast<uint64_t>(__bolt_hugify_init_ptr) + loadBias;
 #ifdef MADV_HUGEPAGE
   uint8_t *hotStart = (uint8_t *)&__hot_start;
   uint8_t *hotEnd = (uint8_t *)&__hot_end;
@@ -95,16 +116,29 @@ extern "C" void __bolt_hugify_self_impl() {
   uint8_t *to = hotEnd + (hugePageBytes - 1);
   to -= (intptr_t)to & (hugePageBytes - 1);
 
+  // Bolt aligns hot text on a huge page in the file, but the loader may place
+  // a PIE executable or a shared object at an address that is only aligned on
+  // a regular page. Only the huge pages fully covered by hot text are safe to
+  // remap then, as the memory around it may belong to other mappings.
+  if (loadBias && from != hotStart) {
+    from += hugePageBytes;
+    to = hotEnd - ((intptr_t)hotEnd & (hugePageBytes - 1));
+  }
+
 #ifdef ENABLE_DEBUG
+  reportNumber("[hugify] load bias: ", loadBias, 16);
   reportNumber("[hugify] hot start: ", (uint64_t)hotStart, 16);
   reportNumber("[hugify] hot end: ", (uint64_t)hotEnd, 16);
   reportNumber("[hugify] aligned huge page from: ", (uint64_t)from, 16);
   reportNumber("[hugify] aligned huge page to: ", (uint64_t)to, 16);
 #endif
 
+  if (from >= to)
+    return initAddr;
+
   if (!has_pagecache_thp_support()) {
     hugify_for_old_kernel(from, to);
-    return;
+    return initAddr;
   }
 
   if (__madvise(from, (to - from), MADV_HUGEPAGE) == -1) {
@@ -113,14 +147,24 @@ extern "C" void __bolt_hugify_self_impl() {
     reportError(msg, sizeof(msg));
   }
 #endif
+  return initAddr;
 }
 
-/// This is hooking ELF's entry, it needs to save all machine state.
+/// This is hooking ELF's entry, it needs to save all machine state. The hook
+/// replaces e_entry of executables and DT_INIT of shared objects, so the stack
+/// alignment on entry differs and is restored before calling into C++. The
+/// address of the init routine is stored in a slot reserved above the saved
+/// registers, and the final ret resumes execution there.
 extern "C" __attribute((naked)) void __bolt_hugify_self() {
-  __asm__ __volatile__(SAVE_ALL
+  __asm__ __volatile__("sub $8, %%rsp\n"
+                       SAVE_ALL
+                       "mov %%rsp, %%rbx\n"
+                       "and $-16, %%rsp\n"
                        "call __bolt_hugify_self_impl\n"
+                       "mov %%rbx, %%rsp\n"
+                       "mov %%rax, 0x80(%%rsp)\n"
                        RESTORE_ALL
-                       "jmp *__bolt_hugify_init_ptr(%%rip)\n"
+                       "ret\n"
                        :::);
 }
 
@@ -96,6 +96,13 @@ extern char __bolt_instr_binpath[];
 // If true, append current PID to the fdata filename when creating it so
 // different invocations of the same program can be differentiated.
 extern bool __bolt_instr_use_pid;
+// Number of memcpy(), memset() and memcmp() call sites with size counters
+extern uint32_t __bolt_instr_num_memop_sites;
+// Number of size counters of each such call site
+extern uint32_t __bolt_instr_num_memop_size_counters;
+// Pairs of the input address of the call site and the index of its first size
+// counter in __bolt_instr_locations
+extern uint64_t __bolt_instr_memop_sites[];
 // Functions that will be used to instrument indirect calls. BOLT static pass
 // will identify indirect calls and modify them to load the address in these
 // trampolines and call this address instead. BOLT can't use direct calls to
@@ -1395,9 +1402,35 @@ void visitCallFlowEntry(CallFlowHashTable::MapEntry &Entry, int FD,
   __write(FD, LineBuf, Ptr - LineBuf);
 }
 
-/// Open fdata file for writing and return a valid file descriptor, aborting
-/// program upon failure.
-int openProfile() {
+/// Write the size profile of memcpy(), memset() and memcmp() call sites to the
+/// .memop file, one "<call address> <size> <count>" record per line. The last
+/// counter of a site counts all sizes not smaller than its index.
+void writeMemOpSizeProfile(int FD) {
+  const uint32_t NumCounters = __bolt_instr_num_memop_size_counters;
+  for (uint32_t I = 0; I < __bolt_instr_num_memop_sites; ++I) {
+    const uint64_t Address = __bolt_instr_memop_sites[2 * I];
+    const uint64_t *Counters =
+        &__bolt_instr_locations[__bolt_instr_memop_sites[2 * I + 1]];
+    for (uint32_t Size = 0; Size < NumCounters; ++Size) {
+      if (!Counters[Size])
+        continue;
+      char LineBuf[BufSize];
+      char *Ptr = LineBuf;
+      Ptr = intToStr(Ptr, Address, 16);
+      *Ptr++ = ' ';
+      Ptr = intToStr(Ptr, Size, 10);
+      *Ptr++ = ' ';
+      Ptr = intToStr(Ptr, Counters[Size], 10);
+      *Ptr++ = '\n';
+      __write(FD, LineBuf, Ptr - LineBuf);
+    }
+  }
+}
+
+/// Open fdata file, or the file with the name of the fdata file followed by
+/// \p Suffix, for writing and return a valid file descriptor, aborting program
+/// upon failure.
+int openProfile(const char *Suffix = "") {
   // Build the profile name string by appending our PID
   char Buf[BufSize];
   char *Ptr = Buf;
@@ -1408,6 +1441,7 @@ int openProfile() {
     Ptr = intToStr(Ptr, PID, 10);
     Ptr = strCopy(Ptr, ".fdata", BufSize - (Ptr - Buf + 1));
   }
+  Ptr = strCopy(Ptr, Suffix, BufSize - (Ptr - Buf + 1));
   *Ptr++ = '\0';
   uint64_t FD = __open(Buf,
                        /*flags=*/0x241 /*O_WRONLY|O_TRUNC|O_CREAT*/,
@@ -1486,6 +1520,12 @@ __bolt_instr_data_dump() {
   Ctx.CallFlowTable->forEachElement(visitCallFlowEntry, FD, &Ctx);
 
   __close(FD);
+
+  if (__bolt_instr_num_memop_sites) {
+    FD = openProfile(".memop");
+    writeMemOpSizeProfile(FD);
+    __close(FD);
+  }
   __munmap(Ctx.MMapPtr, Ctx.MMapSize);
   __close(Ctx.FileDesc);
   HashAlloc.destroy();
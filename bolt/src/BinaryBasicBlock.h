@@ -103,6 +103,12 @@ private:
   /// Maximum number of bytes to use for alignment of the block.
   uint32_t AlignmentMaxBytes{0};
 
+  /// Estimated number of padding bytes inserted to align the block and the
+  /// number of fetch windows saved on every execution of the block as a
+  /// result. Set by the aligner when it uses the cost model.
+  uint16_t AlignmentPadding{0};
+  uint16_t FetchWindowsSaved{0};
+
   /// Number of times this basic block was executed.
   uint64_t ExecutionCount{COUNT_NO_PROFILE};
 
@@ -588,6 +594,23 @@ public:
     return AlignmentMaxBytes;
   }
 
+  /// Record the estimated alignment padding and the number of fetch windows
+  /// saved by aligning the block.
+  void setAlignmentGain(uint16_t Padding, uint16_t WindowsSaved) {
+    AlignmentPadding = Padding;
+    FetchWindowsSaved = WindowsSaved;
+  }
+
+  /// Return the estimated number of padding bytes before the block.
+  uint16_t getAlignmentPadding() const {
+    return AlignmentPadding;
+  }
+
+  /// Return the number of fetch windows saved per execution of the block.
+  uint16_t getFetchWindowsSaved() const {
+    return FetchWindowsSaved;
+  }
+
   /// Adds block to successor list, and also updates predecessor list for
   /// successor block.
   /// Set branch info for this path.
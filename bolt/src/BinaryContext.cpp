@@ -71,6 +71,17 @@ PrintRelocations("print-relocations",
   cl::ZeroOrMore,
   cl::cat(BoltCategory));
 
+static cl::opt<bool>
+LocalLabelNames("local-label-names",
+  cl::desc("give names to basic block and other local labels of functions. "
+           "Without names, creating labels is cheaper, but printed functions "
+           "show them unnamed. By default, labels are named if functions are "
+           "printed or debug output is enabled"),
+  cl::init(false),
+  cl::ZeroOrMore,
+  cl::Hidden,
+  cl::cat(BoltCategory));
+
 static cl::opt<bool>
 PrintMemData("print-mem-data",
   cl::desc("print memory data annotations when printing functions"),
@@ -156,6 +167,68 @@ MCPlusBuilder *createMCPlusBuilder(const Triple::ArchType Arch,
   llvm_unreachable("architecture unsupport by MCPlusBuilder");
 }
 
+/// Return true if local labels should be created with names. Unless set with
+/// -local-label-names, names are given only if they can show up in the
+/// output: debug output is enabled, or functions, CFGs or basic blocks are
+/// printed.
+bool needLocalLabelNames() {
+  if (opts::LocalLabelNames.getNumOccurrences())
+    return opts::LocalLabelNames;
+
+  if (opts::Verbosity > 0 || DebugFlag)
+    return true;
+
+  static const char *const PrintOptions[] = {
+    "dump-dot-all",
+    "print-after-branch-fixup",
+    "print-after-jt-footprint-reduction",
+    "print-after-lowering",
+    "print-all",
+    "print-cfg",
+    "print-cmov-conversion",
+    "print-diff-bbs",
+    "print-diff-cfg",
+    "print-disasm",
+    "print-exceptions",
+    "print-finalized",
+    "print-fop",
+    "print-icf",
+    "print-icp",
+    "print-inline",
+    "print-jcc-erratum-mitigation",
+    "print-jump-tables",
+    "print-longjmp",
+    "print-loop-unrolling",
+    "print-loops",
+    "print-optimize-bodyless",
+    "print-outliner",
+    "print-peepholes",
+    "print-plt",
+    "print-prefetch-insertion",
+    "print-profiled-unmapped",
+    "print-regreassign",
+    "print-reordered",
+    "print-retpoline-insertion",
+    "print-sctc",
+    "print-simplify-rodata-loads",
+    "print-specialize-mem-ops",
+    "print-split",
+    "print-stoke",
+    "print-uce",
+    "print-unknown",
+    "print-unknown-cfg",
+    "print-unmapped",
+    "print-veneer-elimination",
+  };
+  StringMap<cl::Option *> &Options = cl::getRegisteredOptions();
+  for (const char *Name : PrintOptions) {
+    auto OptionI = Options.find(Name);
+    if (OptionI != Options.end() && OptionI->second->getNumOccurrences())
+      return true;
+  }
+  return false;
+}
+
 } // anonymous namespace
 
 /// Create BinaryContext for a given architecture \p ArchName and
@@ -225,6 +298,8 @@ BinaryContext::createBinaryContext(const ObjectFile *File, bool IsPIC,
   std::unique_ptr<MCObjectFileInfo> MOFI(
       TheTarget->createMCObjectFileInfo(*Ctx, IsPIC));
   Ctx->setObjectFileInfo(MOFI.get());
+  // Unnamed local labels avoid name formatting and symbol table lookups.
+  Ctx->setUseNamesOnTempLabels(needLocalLabelNames());
   // We do not support X86 Large code model. Change this in the future.
   bool Large = false;
   if (TheTriple->getArch() == llvm::Triple::aarch64)
@@ -493,6 +493,8 @@ public:
     return std::unique_lock<std::shared_timed_mutex>(CtxMutex);
   }
 
+  /// DWARF context of the input binary. Not set for ELF binaries unless
+  /// debug info is updated.
   std::unique_ptr<DWARFContext> DwCtx;
 
   std::unique_ptr<Triple> TheTriple;
@@ -819,6 +821,14 @@ public:
     return ".text.cold";
   }
 
+  const char *getWarmCodeSectionName() const {
+    return ".text.warm";
+  }
+
+  const char *getStartupCodeSectionName() const {
+    return ".text.startup";
+  }
+
   const char *getHotTextMoverSectionName() const {
     return ".text.mover";
   }
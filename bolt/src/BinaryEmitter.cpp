@@ -17,6 +17,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/LEB128.h"
 #include "llvm/Support/SMLoc.h"
+#include <unordered_set>
 
 #undef  DEBUG_TYPE
 #define DEBUG_TYPE "bolt"
@@ -989,6 +990,69 @@ void BinaryEmitter::emitLSDA(BinaryFunction &BF, bool EmitColdPart) {
 }
 
 void BinaryEmitter::emitDebugLineInfoForOriginalFunctions() {
+  // Line tables of units without emitted functions do not change. Copy them
+  // from the input instead of accumulating line entries for every row.
+  std::unordered_set<uint64_t> UpdatedUnits;
+  std::vector<const BinaryFunction *> EmittedWithoutUnit;
+  for (auto &It : BC.getBinaryFunctions()) {
+    const BinaryFunction &Function = It.second;
+    if (!Function.isEmitted())
+      continue;
+    if (Function.getDWARFUnit())
+      UpdatedUnits.insert(Function.getDWARFUnit()->getOffset());
+    else
+      EmittedWithoutUnit.push_back(&Function);
+  }
+
+  // A function missing from the address ranges of units may still have rows
+  // in a line table. Such a table must not be copied, or it would describe
+  // the original location of the emitted code.
+  auto coversEmittedFunction = [&](const DWARFDebugLine::LineTable &Table) {
+    std::vector<uint32_t> Rows;
+    for (const BinaryFunction *Function : EmittedWithoutUnit)
+      if (Table.lookupAddressRange({Function->getAddress(), 0},
+                                   Function->getMaxSize(), Rows))
+        return true;
+    return false;
+  };
+
+  StringRef LineSectionData = BC.DwCtx->getDWARFObj().getLineSection().Data;
+  std::unordered_set<uint64_t> CopiedUnits;
+  for (const std::unique_ptr<DWARFUnit> &CU : BC.DwCtx->compile_units()) {
+    const uint64_t CUID = CU->getOffset();
+    if (UpdatedUnits.count(CUID))
+      continue;
+
+    // Version 5 line tables refer to strings in .debug_line_str that is
+    // regenerated.
+    const DWARFDebugLine::LineTable *LineTable =
+        BC.DwCtx->getLineTableForUnit(CU.get());
+    if (!LineTable || LineTable->Prologue.getVersion() >= 5 ||
+        coversEmittedFunction(*LineTable))
+      continue;
+
+    Optional<uint64_t> StmtList =
+        dwarf::toSectionOffset(CU->getUnitDIE().find(dwarf::DW_AT_stmt_list));
+    const uint64_t Size = LineTable->Prologue.TotalLength +
+                          LineTable->Prologue.sizeofTotalLength();
+    if (!StmtList || *StmtList + Size > LineSectionData.size() ||
+        !BC.Ctx->getMCDwarfLineTables().count(CUID))
+      continue;
+
+    BC.Ctx->getMCDwarfLineTable(CUID).setRawData(
+        LineSectionData.substr(*StmtList, Size));
+    CopiedUnits.insert(CUID);
+  }
+
+  // RuntimeDyld only loads sections with relocations or symbols. Copied tables
+  // and rows of functions that were not emitted have no relocations. Define a
+  // symbol in .debug_line so that the section is loaded even if no emitted
+  // function has line info.
+  if (!BC.Ctx->getMCDwarfLineTables().empty()) {
+    Streamer.SwitchSection(BC.MOFI->getDwarfLineSection());
+    Streamer.emitLabel(BC.Ctx->getOrCreateSymbol("__bolt_debug_line"));
+  }
+
   for (auto &It : BC.getBinaryFunctions()) {
     const BinaryFunction &Function = It.second;
 
@@ -1002,6 +1066,10 @@ void BinaryEmitter::emitDebugLineInfoForOriginalFunctions() {
     if (!LineTable)
       continue; // nothing to update for this function
 
+    // The line table of the unit is copied as is.
+    if (CopiedUnits.count(Unit->getOffset()))
+      continue;
+
     std::vector<uint32_t> Results;
     MCSection *FunctionSection =
         BC.getCodeSection(Function.getCodeSectionName());
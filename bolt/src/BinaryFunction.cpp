@@ -54,6 +54,7 @@ extern cl::OptionCategory BoltRelocCategory;
 
 extern cl::opt<bool> EnableBAT;
 extern cl::opt<bool> Instrument;
+extern cl::opt<std::string> MemOpSizeProfile;
 extern cl::opt<bool> StrictMode;
 extern cl::opt<bool> UpdateDebugSections;
 extern cl::opt<unsigned> Verbosity;
@@ -989,7 +990,7 @@ MCSymbol *BinaryFunction::getOrCreateLocalLabel(uint64_t Address,
     }
   }
 
-  MCSymbol *Label = BC.Ctx->createNamedTempSymbol();
+  MCSymbol *Label = BC.Ctx->createTempSymbol();
   Labels[Offset] = Label;
 
   return Label;
@@ -1055,7 +1056,7 @@ bool BinaryFunction::disassemble() {
 
   // Insert a label at the beginning of the function. This will be our first
   // basic block.
-  Labels[0] = Ctx->createNamedTempSymbol("BB0");
+  Labels[0] = Ctx->createTempSymbol("BB0");
 
   auto handlePCRelOperand =
       [&](MCInst &Instruction, uint64_t Address, uint64_t Size) {
@@ -2075,7 +2076,7 @@ bool BinaryFunction::buildCFG(MCPlusBuilder::AllocatorIdTy AllocatorId) {
         MCSymbol *Label;
         {
           auto L = BC.scopeLock();
-          Label = BC.Ctx->createNamedTempSymbol("FT");
+          Label = BC.Ctx->createTempSymbol("FT");
         }
         InsertBB = addBasicBlock(
             Offset, Label, opts::PreserveBlocksAlignment && IsLastInstrNop);
@@ -2251,9 +2252,11 @@ void BinaryFunction::postProcessCFG() {
   clearList(IgnoredBranches);
 
   // Remove "Offset" annotations, unless we need an address-translation table
-  // later. This has no cost, since annotations are allocated by a bumpptr
-  // allocator and won't be released anyway until late in the pipeline.
-  if (!requiresAddressTranslation() && !opts::Instrument)
+  // or call site addresses later. This has no cost, since annotations are
+  // allocated by a bumpptr allocator and won't be released anyway until late
+  // in the pipeline.
+  if (!requiresAddressTranslation() && !opts::Instrument &&
+      opts::MemOpSizeProfile.empty())
     for (BinaryBasicBlock *BB : layout())
       for (MCInst &Inst : *BB)
         BC.MIB->removeAnnotation(Inst, "Offset");
@@ -3499,8 +3502,11 @@ MCSymbol *BinaryFunction::addEntryPoint(const BinaryBasicBlock &BB) {
   if (EntrySymbol)
     return EntrySymbol;
 
-  EntrySymbol =
-    BC.Ctx->getOrCreateSymbol("__ENTRY_" + BB.getLabel()->getName());
+  // Local labels have no names unless functions are printed.
+  EntrySymbol = BC.Ctx->getOrCreateSymbol(
+      BB.getLabel()->getName().empty()
+          ? "__ENTRY_" + getOneName() + "@BB" + Twine(BB.getIndex())
+          : "__ENTRY_" + BB.getLabel()->getName());
 
   SecondaryEntryPoints[BB.getLabel()] = EntrySymbol;
 
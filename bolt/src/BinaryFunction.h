@@ -357,6 +357,10 @@ private:
   /// Raw branch count for this function in the profile
   uint64_t RawBranchCount{0};
 
+  /// Number of executed calls removed by inlining call sites into the
+  /// function.
+  uint64_t InlinedCallCount{0};
+
   /// Indicates the type of profile the function is using.
   uint16_t ProfileFlags{PF_NONE};
 
@@ -1591,7 +1595,7 @@ public:
     assert(BC.Ctx && "cannot be called with empty context");
     if (!Label) {
       std::unique_lock<std::shared_timed_mutex> Lock(BC.CtxMutex);
-      Label = BC.Ctx->createNamedTempSymbol("BB");
+      Label = BC.Ctx->createTempSymbol("BB");
     }
     auto BB = std::unique_ptr<BinaryBasicBlock>(
       new BinaryBasicBlock(this, Label, Offset));
@@ -1619,7 +1623,7 @@ public:
 
     if (!Label) {
       std::unique_lock<std::shared_timed_mutex> Lock(BC.CtxMutex);
-      Label = BC.Ctx->createNamedTempSymbol("BB");
+      Label = BC.Ctx->createTempSymbol("BB");
     }
     std::unique_ptr<BinaryBasicBlock> BBPtr =
         createBasicBlock(Offset, Label, DeriveAlignment);
@@ -2047,6 +2051,13 @@ public:
   /// executions corresponding to this function.
   uint64_t getRawBranchCount() const { return RawBranchCount; }
 
+  /// Return the number of executed calls removed by inlining call sites into
+  /// this function.
+  uint64_t getInlinedCallCount() const { return InlinedCallCount; }
+
+  /// Account for \p Count executed calls removed by inlining a call site.
+  void addInlinedCallCount(uint64_t Count) { InlinedCallCount += Count; }
+
   /// Return the execution count for functions with known profile.
   /// Return 0 if the function has no profile.
   uint64_t getKnownExecutionCount() const {
@@ -2381,6 +2392,15 @@ public:
     }
   }
 
+  /// Release memory that is not needed once output addresses of the emitted
+  /// function are known. Basic blocks are kept as they hold address
+  /// translation data for BAT, debug info and exception handling updates.
+  void releaseEmittedState() {
+    assert(CurrentState == State::Emitted && "function must be emitted");
+    BLI.reset();
+    clearList(BasicBlocksPreviousLayout);
+  }
+
   /// Process LSDA information for the function.
   void parseLSDA(ArrayRef<uint8_t> LSDAData, uint64_t LSDAAddress);
 
@@ -9,23 +9,30 @@
 //===----------------------------------------------------------------------===//
 
 #include "BinaryPassManager.h"
+#include "MemoryStats.h"
 #include "Passes/ADRRelaxationPass.h"
 #include "Passes/Aligner.h"
 #include "Passes/AllocCombiner.h"
+#include "Passes/CMOVConversion.h"
 #include "Passes/FrameOptimizer.h"
 #include "Passes/IdenticalCodeFolding.h"
 #include "Passes/IndirectCallPromotion.h"
 #include "Passes/Inliner.h"
 #include "Passes/Instrumentation.h"
+#include "Passes/JCCErratumMitigation.h"
 #include "Passes/JTFootprintReduction.h"
 #include "Passes/LongJmp.h"
 #include "Passes/LoopInversionPass.h"
+#include "Passes/LoopUnrolling.h"
+#include "Passes/Outliner.h"
 #include "Passes/PLTCall.h"
 #include "Passes/PatchEntries.h"
+#include "Passes/PrefetchInsertion.h"
 #include "Passes/RegReAssign.h"
 #include "Passes/ReorderData.h"
 #include "Passes/ReorderFunctions.h"
 #include "Passes/RetpolineInsertion.h"
+#include "Passes/SpecializeMemOps.h"
 #include "Passes/SplitFunctions.h"
 #include "Passes/StokeInfo.h"
 #include "Passes/TailDuplication.h"
@@ -44,6 +51,8 @@ namespace opts {
 extern cl::OptionCategory BoltOptCategory;
 extern cl::OptionCategory BoltCategory;
 
+extern cl::opt<bool> AlignBlocks;
+extern cl::opt<bool> AlignBlocksCostModel;
 extern cl::opt<bool> Instrument;
 
 extern cl::opt<unsigned> Verbosity;
@@ -51,6 +60,9 @@ extern cl::opt<bool> PrintAll;
 extern cl::opt<bool> PrintDynoStats;
 extern cl::opt<bool> DumpDotAll;
 extern cl::opt<bolt::PLTCall::OptType> PLT;
+extern cl::opt<std::string> MemOpSizeProfile;
+extern cl::opt<bool> PeelLoops;
+extern cl::opt<bool> UnrollLoops;
 
 static cl::opt<bool>
 DynoStatsAll("dyno-stats-all",
@@ -66,12 +78,33 @@ EliminateUnreachable("eliminate-unreachable",
   cl::ZeroOrMore,
   cl::cat(BoltOptCategory));
 
+static cl::opt<bool>
+CMOVConversionFlag("cmov-conversion",
+  cl::desc("convert hot and frequently mispredicted branches over register "
+           "moves into conditional moves"),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
 cl::opt<bool>
 ICF("icf",
   cl::desc("fold functions with identical code"),
   cl::ZeroOrMore,
   cl::cat(BoltOptCategory));
 
+static cl::opt<bool>
+InsertPrefetches("insert-prefetches",
+  cl::desc("insert software prefetches for strided loads in loops with "
+           "frequent memory profile samples"),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+cl::opt<bool>
+JCCErratumMitigationFlag("jcc-erratum-mitigation",
+  cl::desc("insert padding before hot branches that cross or end on a 32-byte "
+           "boundary (mitigation for the Intel JCC erratum)"),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
 static cl::opt<bool>
 JTFootprintReductionFlag("jt-footprint-reduction",
   cl::desc("make jump tables size smaller at the cost of using more "
@@ -79,6 +112,13 @@ JTFootprintReductionFlag("jt-footprint-reduction",
   cl::ZeroOrMore,
   cl::cat(BoltOptCategory));
 
+static cl::opt<bool>
+OutlineColdCode("outline-cold-code",
+  cl::desc("outline instruction sequences repeated in cold fragments of split "
+           "functions into shared stubs to reduce code size"),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
 static cl::opt<bool> TailDuplicationFlag(
     "tail-duplication",
     cl::desc("duplicate unconditional branches that cross a cache line"),
@@ -312,6 +352,48 @@ static llvm::cl::opt<bool>
     cl::ZeroOrMore,
     cl::cat(BoltOptCategory));
 
+static llvm::cl::opt<bool>
+  PrintCMOVConversion("print-cmov-conversion",
+    cl::desc("print functions after cmov conversion pass"),
+    cl::init(false),
+    cl::ZeroOrMore,
+    cl::cat(BoltOptCategory));
+
+static llvm::cl::opt<bool>
+  PrintLoopUnrolling("print-loop-unrolling",
+    cl::desc("print functions after loop unrolling and peeling"),
+    cl::init(false),
+    cl::ZeroOrMore,
+    cl::cat(BoltOptCategory));
+
+static llvm::cl::opt<bool>
+  PrintOutliner("print-outliner",
+    cl::desc("print functions after cold code outlining"),
+    cl::init(false),
+    cl::ZeroOrMore,
+    cl::cat(BoltOptCategory));
+
+static llvm::cl::opt<bool>
+  PrintPrefetchInsertion("print-prefetch-insertion",
+    cl::desc("print functions after prefetch insertion pass"),
+    cl::init(false),
+    cl::ZeroOrMore,
+    cl::cat(BoltOptCategory));
+
+static llvm::cl::opt<bool>
+  PrintSpecializeMemOps("print-specialize-mem-ops",
+    cl::desc("print functions after memcpy() and memset() specialization"),
+    cl::init(false),
+    cl::ZeroOrMore,
+    cl::cat(BoltOptCategory));
+
+static llvm::cl::opt<bool>
+  PrintJCCErratumMitigation("print-jcc-erratum-mitigation",
+    cl::desc("print functions after JCC erratum mitigation pass"),
+    cl::init(false),
+    cl::ZeroOrMore,
+    cl::cat(BoltOptCategory));
+
 static llvm::cl::opt<bool>
   PrintRetpolineInsertion("print-retpoline-insertion",
     cl::desc("print functions after retpoline insertion pass"),
@@ -349,6 +431,7 @@ void BinaryFunctionPassManager::runPasses() {
 
     NamedRegionTimer T(Pass->getName(), Pass->getName(), TimerGroupName,
                        TimerGroupDesc, TimeOpts);
+    MemoryStatsScope M(Pass->getName(), "pass");
 
     callWithDynoStats(
       [this,&Pass] {
@@ -429,6 +512,10 @@ void BinaryFunctionPassManager::runAllPasses(BinaryContext &BC) {
       std::make_unique<SpecializeMemcpy1>(NeverPrint, opts::SpecializeMemcpy1),
       !opts::SpecializeMemcpy1.empty());
 
+  Manager.registerPass(
+      std::make_unique<SpecializeMemOps>(PrintSpecializeMemOps),
+      !opts::MemOpSizeProfile.empty());
+
   Manager.registerPass(std::make_unique<InlineMemcpy>(NeverPrint),
                        opts::StringOps);
 
@@ -455,6 +542,13 @@ void BinaryFunctionPassManager::runAllPasses(BinaryContext &BC) {
   Manager.registerPass(std::make_unique<ThreeWayBranch>(),
                        opts::ThreeWayBranchFlag);
 
+  Manager.registerPass(
+      std::make_unique<CMOVConversion>(PrintCMOVConversion),
+      opts::CMOVConversionFlag);
+
+  Manager.registerPass(std::make_unique<LoopUnrolling>(PrintLoopUnrolling),
+                       opts::UnrollLoops || opts::PeelLoops);
+
   Manager.registerPass(std::make_unique<ReorderBasicBlocks>(PrintReordered));
 
   Manager.registerPass(
@@ -504,8 +598,20 @@ void BinaryFunctionPassManager::runAllPasses(BinaryContext &BC) {
 
   Manager.registerPass(std::make_unique<Peepholes>(PrintPeepholes));
 
+  Manager.registerPass(
+      std::make_unique<PrefetchInsertion>(PrintPrefetchInsertion),
+      opts::InsertPrefetches);
+
   Manager.registerPass(std::make_unique<AlignerPass>());
 
+  // Alignment padding and fetch windows saved are only known after the
+  // aligner has run with the cost model.
+  Manager.registerPass(
+    std::make_unique<DynoStatsPrintPass>(
+      InitialDynoStats, "after basic block alignment"),
+    (opts::PrintDynoStats || opts::DynoStatsAll) && opts::AlignBlocks &&
+        opts::AlignBlocksCostModel);
+
   // Perform reordering on data contained in one or more sections using
   // memory profiling data.
   Manager.registerPass(std::make_unique<ReorderData>());
@@ -524,6 +630,17 @@ void BinaryFunctionPassManager::runAllPasses(BinaryContext &BC) {
   Manager.registerPass(
       std::make_unique<RetpolineInsertion>(PrintRetpolineInsertion));
 
+  // Outline code shared between cold fragments after the last pass that
+  // analyzes calls and stack accesses.
+  Manager.registerPass(std::make_unique<Outliner>(PrintOutliner),
+                       opts::OutlineColdCode);
+
+  // Pad hot branches after all code modifications and before the code is
+  // assigned to sections and lowered.
+  Manager.registerPass(
+      std::make_unique<JCCErratumMitigation>(PrintJCCErratumMitigation),
+      JCCErratumMitigationFlag);
+
   // Assign each function an output section.
   Manager.registerPass(std::make_unique<AssignSections>());
 
@@ -74,8 +74,15 @@ BinarySection::hash(const BinaryData &BD,
 void BinarySection::emitAsData(MCStreamer &Streamer, StringRef NewName) const {
   StringRef SectionName = !NewName.empty() ? NewName : getName();
   StringRef SectionContents = getContents();
+  // Reordered .bss is emitted as PROGBITS and should not be merged with the
+  // NOBITS section of the same name that MC creates by default.
   MCSectionELF *ELFSection =
-      BC.Ctx->getELFSection(SectionName, getELFType(), getELFFlags());
+      isReordered()
+          ? BC.Ctx->getELFSection(SectionName, getELFType(), getELFFlags(),
+                                  /*EntrySize=*/0, /*Group=*/"",
+                                  /*IsComdat=*/false, /*UniqueID=*/0,
+                                  /*LinkedToSym=*/nullptr)
+          : BC.Ctx->getELFSection(SectionName, getELFType(), getELFFlags());
 
   Streamer.SwitchSection(ELFSection);
   Streamer.emitValueToAlignment(getAlignment());
@@ -274,15 +281,22 @@ void BinarySection::reorderContents(const std::vector<BinaryData *> &Order,
     assert((BD->isMoved() || !Inplace) && !BD->isJumpTable());
     assert(BD->isAtomic() && BD->isMoveable());
     const uint64_t SrcOffset = BD->getAddress() - getAddress();
-    assert(SrcOffset < Contents.size());
+    assert((isVirtual() || SrcOffset < Contents.size()));
     assert(SrcOffset == BD->getOffset());
     while (OS.tell() < BD->getOutputOffset()) {
       OS.write((unsigned char)0);
     }
     LLVM_DEBUG(dbgs() << "BOLT-DEBUG: " << BD->getName() << " @ " << OS.tell()
                       << "\n");
-    OS.write(&Src[SrcOffset], BD->getOutputSize());
+    if (isVirtual())
+      OS.write_zeros(BD->getOutputSize());
+    else
+      OS.write(&Src[SrcOffset], BD->getOutputSize());
   }
+  // Zero-initialized data has no contents in the input file. Emit the
+  // reordered part with explicit zeros so that it can carry relocations.
+  if (isVirtual())
+    ELFType = ELF::SHT_PROGBITS;
   if (Relocations.empty()) {
     // If there are no existing relocations, tack a phony one at the end
     // of the reordered segment to force LLVM to recognize and map this
@@ -29,9 +29,11 @@
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/DJB.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Endian.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LEB128.h"
 #include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include <algorithm>
@@ -101,6 +103,12 @@ KeepARanges("keep-aranges",
   cl::Hidden,
   cl::cat(BoltCategory));
 
+static cl::opt<bool>
+CreateDebugNames("create-debug-names",
+  cl::desc("create .debug_names accelerator table if the input has none"),
+  cl::ZeroOrMore,
+  cl::cat(BoltCategory));
+
 static cl::opt<bool>
 DeterministicDebugInfo("deterministic-debuginfo",
   cl::desc("disables parallel execution of tasks that may produce"
@@ -179,9 +187,16 @@ void DWARFRewriter::updateDebugInfo() {
   AddrWriter = std::make_unique<DebugAddrWriter>(&BC);
   DebugLoclistWriter::setAddressWriter(AddrWriter.get());
 
+  // Deterministic output with multiple threads is achieved by processing
+  // units in parallel while deferring updates to shared ranges and
+  // abbreviations. These are applied afterwards in the order of units.
+  const bool DeferRangesUpdates = !opts::NoThreads &&
+                                  opts::DeterministicDebugInfo &&
+                                  BC.getNumDWOCUs() == 0;
+
   uint64_t NumCUs = BC.DwCtx->getNumCompileUnits();
   if ((opts::NoThreads || opts::DeterministicDebugInfo) &&
-      BC.getNumDWOCUs() == 0) {
+      !DeferRangesUpdates && BC.getNumDWOCUs() == 0) {
     // Use single entry for efficiency when running single-threaded
     NumCUs = 1;
   }
@@ -253,7 +268,33 @@ void DWARFRewriter::updateDebugInfo() {
                         RangesBase);
   };
 
-  if (opts::NoThreads || opts::DeterministicDebugInfo) {
+  if (DeferRangesUpdates) {
+    std::vector<RangesUpdatesType> UpdatesByCU(NumCUs);
+    ThreadPool &ThreadPool = ParallelUtilities::getThreadPool();
+    size_t CUIndex = 0;
+    for (std::unique_ptr<DWARFUnit> &CU : BC.DwCtx->compile_units()) {
+      ThreadPool.async(
+          [&, CUIndex](DWARFUnit *Unit) {
+            updateUnitDebugInfo(CUIndex, *Unit, *DebugInfoPatcher,
+                                *AbbrevWriter, None, &UpdatesByCU[CUIndex]);
+          },
+          CU.get());
+      CUIndex++;
+    }
+
+    ThreadPool.wait();
+
+    CUIndex = 0;
+    for (std::unique_ptr<DWARFUnit> &CU : BC.DwCtx->compile_units()) {
+      std::map<DebugAddressRangesVector, uint64_t> CachedRanges;
+      for (RangesUpdate &Update : UpdatesByCU[CUIndex])
+        applyRangesUpdate(*CU, Update, CachedRanges, *DebugInfoPatcher,
+                          *AbbrevWriter, None);
+      UpdatesByCU[CUIndex].clear();
+      AbbrevWriter->addUnitAbbreviations(*CU);
+      CUIndex++;
+    }
+  } else if (opts::NoThreads || opts::DeterministicDebugInfo) {
     for (std::unique_ptr<DWARFUnit> &CU : BC.DwCtx->compile_units()) {
       processUnitDIE(0, CU.get());
     }
@@ -271,6 +312,8 @@ void DWARFRewriter::updateDebugInfo() {
 
   flushPendingRanges(*DebugInfoPatcher);
 
+  updateDebugNamesSection();
+
   finalizeDebugSections(*DebugInfoPatcher);
 
   if (opts::WriteDWP)
@@ -284,10 +327,23 @@ void DWARFRewriter::updateDebugInfo() {
 void DWARFRewriter::updateUnitDebugInfo(uint64_t CUIndex, DWARFUnit &Unit,
                                         SimpleBinaryPatcher &DebugInfoPatcher,
                                         DebugAbbrevWriter &AbbrevWriter,
-                                        Optional<uint64_t> RangesBase) {
+                                        Optional<uint64_t> RangesBase,
+                                        RangesUpdatesType *RangesUpdates) {
   // Cache debug ranges so that the offset for identical ranges could be reused.
   std::map<DebugAddressRangesVector, uint64_t> CachedRanges;
 
+  auto addRangesUpdate = [&](RangesUpdate::UpdateKind Kind,
+                             const DWARFDebugInfoEntry &DIE,
+                             DebugAddressRangesVector &&Ranges) {
+    RangesUpdate Update{Kind, DIE, std::move(Ranges)};
+    if (RangesUpdates) {
+      RangesUpdates->emplace_back(std::move(Update));
+      return;
+    }
+    applyRangesUpdate(Unit, Update, CachedRanges, DebugInfoPatcher,
+                      AbbrevWriter, RangesBase);
+  };
+
   auto &DebugLocWriter = *LocListWritersByCU[CUIndex].get();
 
   uint64_t DIEOffset = Unit.getOffset() + Unit.getHeaderSize();
@@ -321,15 +377,8 @@ void DWARFRewriter::updateUnitDebugInfo(uint64_t CUIndex, DWARFUnit &Unit,
         break;
       }
       DWARFAddressRangesVector ModuleRanges = *ModuleRangesOrError;
-      DebugAddressRangesVector OutputRanges =
-          BC.translateModuleAddressRanges(ModuleRanges);
-      const uint64_t RangesSectionOffset =
-          RangesSectionWriter->addRanges(OutputRanges);
-      if (!Unit.isDWOUnit())
-        ARangesSectionWriter->addCURanges(Unit.getOffset(),
-                                          std::move(OutputRanges));
-      updateDWARFObjectAddressRanges(DIE, RangesSectionOffset, DebugInfoPatcher,
-                                     AbbrevWriter, RangesBase);
+      addRangesUpdate(RangesUpdate::UnitRanges, Die,
+                      BC.translateModuleAddressRanges(ModuleRanges));
       break;
     }
     case dwarf::DW_TAG_subprogram: {
@@ -353,71 +402,35 @@ void DWARFRewriter::updateUnitDebugInfo(uint64_t CUIndex, DWARFUnit &Unit,
         UsesRanges = true;
       }
 
-      // Clear cached ranges as the new function will have its own set.
-      CachedRanges.clear();
-
       DebugAddressRangesVector FunctionRanges;
       if (const BinaryFunction *Function =
               BC.getBinaryFunctionAtAddress(Address))
         FunctionRanges = Function->getOutputAddressRanges();
-      // Update ranges.
-      if (UsesRanges) {
-        updateDWARFObjectAddressRanges(
-            DIE, RangesSectionWriter->addRanges(FunctionRanges),
-            DebugInfoPatcher, AbbrevWriter);
-      } else {
-        // Delay conversion of [LowPC, HighPC) into DW_AT_ranges if possible.
-        const DWARFAbbreviationDeclaration *Abbrev =
-            DIE.getAbbreviationDeclarationPtr();
-        assert(Abbrev && "abbrev expected");
-
-        // Create a critical section.
-        static std::shared_timed_mutex CriticalSectionMutex;
-        std::unique_lock<std::shared_timed_mutex> Lock(CriticalSectionMutex);
-
-        if (FunctionRanges.size() > 1) {
-          convertPending(Unit, Abbrev, DebugInfoPatcher, AbbrevWriter);
-          // Exit critical section early.
-          Lock.unlock();
-          convertToRanges(DIE, FunctionRanges, DebugInfoPatcher);
-        } else if (ConvertedRangesAbbrevs.find(Abbrev) !=
-                   ConvertedRangesAbbrevs.end()) {
-          // Exit critical section early.
-          Lock.unlock();
-          convertToRanges(DIE, FunctionRanges, DebugInfoPatcher);
-        } else {
-          if (FunctionRanges.empty())
-            FunctionRanges.emplace_back(DebugAddressRange());
-          addToPendingRanges(Abbrev, DIE, FunctionRanges, Unit.getDWOId());
-        }
-      }
+      addRangesUpdate(UsesRanges ? RangesUpdate::FunctionRanges
+                                 : RangesUpdate::FunctionLowHighPC,
+                      Die, std::move(FunctionRanges));
       break;
     }
     case dwarf::DW_TAG_lexical_block:
     case dwarf::DW_TAG_inlined_subroutine:
     case dwarf::DW_TAG_try_block:
     case dwarf::DW_TAG_catch_block: {
-      uint64_t RangesSectionOffset =
-          RangesSectionWriter->getEmptyRangesOffset();
+      DebugAddressRangesVector OutputRanges;
       Expected<DWARFAddressRangesVector> RangesOrError = DIE.getAddressRanges();
       const BinaryFunction *Function = RangesOrError && !RangesOrError->empty()
           ? BC.getBinaryFunctionContainingAddress(RangesOrError->front().LowPC)
           : nullptr;
       if (Function) {
-        DebugAddressRangesVector OutputRanges =
-            Function->translateInputToOutputRanges(*RangesOrError);
+        OutputRanges = Function->translateInputToOutputRanges(*RangesOrError);
         LLVM_DEBUG(if (OutputRanges.empty() != RangesOrError->empty()) {
           dbgs() << "BOLT-DEBUG: problem with DIE at 0x"
                  << Twine::utohexstr(DIE.getOffset()) << " in CU at 0x"
                  << Twine::utohexstr(Unit.getOffset()) << '\n';
         });
-        RangesSectionOffset = RangesSectionWriter->addRanges(
-            std::move(OutputRanges), CachedRanges);
       } else if (!RangesOrError) {
         consumeError(RangesOrError.takeError());
       }
-      updateDWARFObjectAddressRanges(DIE, RangesSectionOffset, DebugInfoPatcher,
-                                     AbbrevWriter);
+      addRangesUpdate(RangesUpdate::BlockRanges, Die, std::move(OutputRanges));
       break;
     }
     default: {
@@ -590,7 +603,72 @@ void DWARFRewriter::updateUnitDebugInfo(uint64_t CUIndex, DWARFUnit &Unit,
            << Twine::utohexstr(Unit.getOffset()) << '\n';
   }
 
-  AbbrevWriter.addUnitAbbreviations(Unit);
+  if (!RangesUpdates)
+    AbbrevWriter.addUnitAbbreviations(Unit);
+}
+
+void DWARFRewriter::applyRangesUpdate(
+    DWARFUnit &Unit, RangesUpdate &Update,
+    std::map<DebugAddressRangesVector, uint64_t> &CachedRanges,
+    SimpleBinaryPatcher &DebugInfoPatcher, DebugAbbrevWriter &AbbrevWriter,
+    Optional<uint64_t> RangesBase) {
+  DWARFDie DIE(&Unit, &Update.DIE);
+
+  switch (Update.Kind) {
+  case RangesUpdate::UnitRanges: {
+    const uint64_t RangesSectionOffset =
+        RangesSectionWriter->addRanges(Update.Ranges);
+    if (!Unit.isDWOUnit())
+      ARangesSectionWriter->addCURanges(Unit.getOffset(),
+                                        std::move(Update.Ranges));
+    updateDWARFObjectAddressRanges(DIE, RangesSectionOffset, DebugInfoPatcher,
+                                   AbbrevWriter, RangesBase);
+    break;
+  }
+  case RangesUpdate::FunctionRanges:
+    // Clear cached ranges as the new function will have its own set.
+    CachedRanges.clear();
+    updateDWARFObjectAddressRanges(
+        DIE, RangesSectionWriter->addRanges(Update.Ranges), DebugInfoPatcher,
+        AbbrevWriter);
+    break;
+  case RangesUpdate::FunctionLowHighPC: {
+    CachedRanges.clear();
+    DebugAddressRangesVector &FunctionRanges = Update.Ranges;
+
+    // Delay conversion of [LowPC, HighPC) into DW_AT_ranges if possible.
+    const DWARFAbbreviationDeclaration *Abbrev =
+        DIE.getAbbreviationDeclarationPtr();
+    assert(Abbrev && "abbrev expected");
+
+    // Create a critical section.
+    static std::shared_timed_mutex CriticalSectionMutex;
+    std::unique_lock<std::shared_timed_mutex> Lock(CriticalSectionMutex);
+
+    if (FunctionRanges.size() > 1) {
+      convertPending(Unit, Abbrev, DebugInfoPatcher, AbbrevWriter);
+      // Exit critical section early.
+      Lock.unlock();
+      convertToRanges(DIE, FunctionRanges, DebugInfoPatcher);
+    } else if (ConvertedRangesAbbrevs.find(Abbrev) !=
+               ConvertedRangesAbbrevs.end()) {
+      // Exit critical section early.
+      Lock.unlock();
+      convertToRanges(DIE, FunctionRanges, DebugInfoPatcher);
+    } else {
+      if (FunctionRanges.empty())
+        FunctionRanges.emplace_back(DebugAddressRange());
+      addToPendingRanges(Abbrev, DIE, FunctionRanges, Unit.getDWOId());
+    }
+    break;
+  }
+  case RangesUpdate::BlockRanges:
+    updateDWARFObjectAddressRanges(
+        DIE,
+        RangesSectionWriter->addRanges(std::move(Update.Ranges), CachedRanges),
+        DebugInfoPatcher, AbbrevWriter);
+    break;
+  }
 }
 
 void DWARFRewriter::updateDWARFObjectAddressRanges(
@@ -1298,6 +1376,267 @@ void DWARFRewriter::updateGdbIndexSection() {
                                  NewGdbIndexSize);
 }
 
+namespace {
+
+/// Index entry for a DIE in .debug_names.
+struct NameIndexEntry {
+  StringRef Name;
+  /// Offset of the name in .debug_str, or None if the name is not there.
+  Optional<uint64_t> StrOffset;
+  uint32_t CUIndex;
+  dwarf::Tag Tag;
+  /// Offset of the DIE relative to its unit.
+  uint32_t DieOffset;
+};
+
+/// Returns the offset of a string attribute value in .debug_str.
+Optional<uint64_t> getStrOffset(const DWARFFormValue &Value) {
+  switch (Value.getForm()) {
+  case dwarf::DW_FORM_strp:
+    return Value.getRawUValue();
+  case dwarf::DW_FORM_strx:
+  case dwarf::DW_FORM_strx1:
+  case dwarf::DW_FORM_strx2:
+  case dwarf::DW_FORM_strx3:
+  case dwarf::DW_FORM_strx4:
+    return Value.getUnit()->getStringOffsetSectionItem(Value.getRawUValue());
+  default:
+    return None;
+  }
+}
+
+/// Returns true if \p DIE should be indexed according to DWARF v5 6.1.1.1.
+bool shouldIndexDIE(const DWARFDie &DIE) {
+  if (dwarf::toUnsigned(DIE.find(dwarf::DW_AT_declaration), 0))
+    return false;
+
+  switch (DIE.getTag()) {
+  case dwarf::DW_TAG_base_type:
+  case dwarf::DW_TAG_class_type:
+  case dwarf::DW_TAG_enumeration_type:
+  case dwarf::DW_TAG_namespace:
+  case dwarf::DW_TAG_structure_type:
+  case dwarf::DW_TAG_typedef:
+  case dwarf::DW_TAG_union_type:
+    return true;
+  case dwarf::DW_TAG_subprogram:
+  case dwarf::DW_TAG_inlined_subroutine:
+    return DIE.find(dwarf::DW_AT_low_pc) || DIE.find(dwarf::DW_AT_ranges) ||
+           DIE.find(dwarf::DW_AT_inline);
+  case dwarf::DW_TAG_variable: {
+    if (!DIE.find(dwarf::DW_AT_location))
+      return false;
+    const dwarf::Tag ParentTag = DIE.getParent().getTag();
+    return ParentTag == dwarf::DW_TAG_compile_unit ||
+           ParentTag == dwarf::DW_TAG_namespace;
+  }
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+void DWARFRewriter::updateDebugNamesSection() {
+  if (!opts::CreateDebugNames || BC.getUniqueSectionByName(".debug_names"))
+    return;
+
+  // Names of split units live in .dwo files.
+  if (BC.getNumDWOCUs()) {
+    errs() << "BOLT-WARNING: cannot create .debug_names for split DWARF\n";
+    return;
+  }
+
+  std::vector<DWARFUnit *> Units;
+  for (const std::unique_ptr<DWARFUnit> &CU : BC.DwCtx->compile_units()) {
+    // Extract all DIEs before processing units in parallel as DIEs can
+    // reference other units.
+    CU->getUnitDIE(/*ExtractUnitDIEOnly=*/false);
+    Units.push_back(CU.get());
+  }
+  if (Units.empty())
+    return;
+
+  std::vector<std::vector<NameIndexEntry>> EntriesByCU(Units.size());
+  auto collectEntries = [&](uint32_t CUIndex) {
+    DWARFUnit &Unit = *Units[CUIndex];
+    std::vector<NameIndexEntry> &Entries = EntriesByCU[CUIndex];
+    for (const DWARFDebugInfoEntry &Entry : Unit.dies()) {
+      DWARFDie DIE(&Unit, &Entry);
+      if (!shouldIndexDIE(DIE))
+        continue;
+
+      const uint32_t DieOffset = DIE.getOffset() - Unit.getOffset();
+      auto addName = [&](Optional<DWARFFormValue> Value) {
+        if (!Value)
+          return;
+        Optional<const char *> Name = Value->getAsCString();
+        if (!Name || !**Name)
+          return;
+        Entries.push_back({*Name, getStrOffset(*Value), CUIndex,
+                           DIE.getTag(), DieOffset});
+      };
+
+      // Inlined subroutines and out-of-line definitions are indexed by the
+      // names of their abstract origin or declaration.
+      addName(DIE.findRecursively(dwarf::DW_AT_name));
+      if (DIE.getTag() == dwarf::DW_TAG_subprogram ||
+          DIE.getTag() == dwarf::DW_TAG_inlined_subroutine ||
+          DIE.getTag() == dwarf::DW_TAG_variable)
+        addName(DIE.findRecursively(
+            {dwarf::DW_AT_linkage_name, dwarf::DW_AT_MIPS_linkage_name}));
+    }
+  };
+
+  if (opts::NoThreads) {
+    for (uint32_t CUIndex = 0; CUIndex < Units.size(); ++CUIndex)
+      collectEntries(CUIndex);
+  } else {
+    ThreadPool &ThreadPool = ParallelUtilities::getThreadPool();
+    for (uint32_t CUIndex = 0; CUIndex < Units.size(); ++CUIndex)
+      ThreadPool.async(collectEntries, CUIndex);
+    ThreadPool.wait();
+  }
+
+  // Group entries by name in the order of units.
+  struct NameData {
+    uint64_t StrOffset;
+    uint32_t Hash;
+    std::vector<const NameIndexEntry *> Entries;
+  };
+  StringMap<NameData> Names;
+  std::map<dwarf::Tag, uint32_t> AbbrevCodes;
+  for (const std::vector<NameIndexEntry> &Entries : EntriesByCU) {
+    for (const NameIndexEntry &Entry : Entries) {
+      auto NameIt = Names.try_emplace(Entry.Name);
+      NameData &Data = NameIt.first->second;
+      if (NameIt.second) {
+        Data.StrOffset = Entry.StrOffset ? *Entry.StrOffset
+                                         : StrWriter->addString(Entry.Name);
+        Data.Hash = caseFoldingDjbHash(Entry.Name);
+      }
+      Data.Entries.push_back(&Entry);
+      AbbrevCodes.emplace(Entry.Tag, 0);
+    }
+  }
+
+  std::vector<uint32_t> UniqueHashes;
+  UniqueHashes.reserve(Names.size());
+  for (const StringMapEntry<NameData> &Name : Names)
+    UniqueHashes.push_back(Name.second.Hash);
+  llvm::sort(UniqueHashes);
+  const uint32_t NumUniqueHashes =
+      std::unique(UniqueHashes.begin(), UniqueHashes.end()) -
+      UniqueHashes.begin();
+  uint32_t BucketCount = NumUniqueHashes;
+  if (NumUniqueHashes > 1024)
+    BucketCount = NumUniqueHashes / 4;
+  else if (NumUniqueHashes > 16)
+    BucketCount = NumUniqueHashes / 2;
+  BucketCount = std::max<uint32_t>(BucketCount, 1);
+
+  // Names are grouped by bucket and sorted by hash within a bucket.
+  std::vector<const StringMapEntry<NameData> *> SortedNames;
+  SortedNames.reserve(Names.size());
+  for (const StringMapEntry<NameData> &Name : Names)
+    SortedNames.push_back(&Name);
+  llvm::sort(SortedNames, [&](const StringMapEntry<NameData> *A,
+                              const StringMapEntry<NameData> *B) {
+    const uint32_t HashA = A->second.Hash;
+    const uint32_t HashB = B->second.Hash;
+    return std::make_tuple(HashA % BucketCount, HashA, A->first()) <
+           std::make_tuple(HashB % BucketCount, HashB, B->first());
+  });
+
+  const unsigned CUIndexSize =
+      Units.size() <= UINT8_MAX ? 1 : Units.size() <= UINT16_MAX ? 2 : 4;
+  const dwarf::Form CUIndexForm =
+      CUIndexSize == 1 ? dwarf::DW_FORM_data1
+                       : CUIndexSize == 2 ? dwarf::DW_FORM_data2
+                                          : dwarf::DW_FORM_data4;
+
+  auto writeLE = [](raw_ostream &OS, uint64_t Value, unsigned Size) {
+    for (unsigned I = 0; I < Size; ++I)
+      OS << static_cast<char>(Value >> (8 * I));
+  };
+
+  // Abbreviations: one per tag.
+  SmallString<64> AbbrevTable;
+  raw_svector_ostream AbbrevOS(AbbrevTable);
+  uint32_t AbbrevCode = 0;
+  for (std::pair<const dwarf::Tag, uint32_t> &Abbrev : AbbrevCodes) {
+    Abbrev.second = ++AbbrevCode;
+    encodeULEB128(Abbrev.second, AbbrevOS);
+    encodeULEB128(Abbrev.first, AbbrevOS);
+    encodeULEB128(dwarf::DW_IDX_compile_unit, AbbrevOS);
+    encodeULEB128(CUIndexForm, AbbrevOS);
+    encodeULEB128(dwarf::DW_IDX_die_offset, AbbrevOS);
+    encodeULEB128(dwarf::DW_FORM_ref4, AbbrevOS);
+    encodeULEB128(0, AbbrevOS);
+    encodeULEB128(0, AbbrevOS);
+  }
+  encodeULEB128(0, AbbrevOS);
+
+  // Entry pool and offsets of entries for every name.
+  SmallString<0> EntryPool;
+  raw_svector_ostream PoolOS(EntryPool);
+  std::vector<uint32_t> EntryOffsets;
+  EntryOffsets.reserve(SortedNames.size());
+  for (const StringMapEntry<NameData> *Name : SortedNames) {
+    EntryOffsets.push_back(EntryPool.size());
+    for (const NameIndexEntry *Entry : Name->second.Entries) {
+      encodeULEB128(AbbrevCodes[Entry->Tag], PoolOS);
+      writeLE(PoolOS, Entry->CUIndex, CUIndexSize);
+      writeLE(PoolOS, Entry->DieOffset, 4);
+    }
+    encodeULEB128(0, PoolOS);
+  }
+
+  const StringRef Augmentation = "BOLT";
+  DebugBufferVector NamesContents;
+  raw_svector_ostream OS(NamesContents);
+  auto writeU32 = [&](uint64_t Value) { writeLE(OS, Value, 4); };
+  // unit_length is written at the end.
+  writeU32(0);
+  writeLE(OS, 5, 2); // version
+  writeLE(OS, 0, 2); // padding
+  writeU32(Units.size());
+  writeU32(0); // local_type_unit_count
+  writeU32(0); // foreign_type_unit_count
+  writeU32(BucketCount);
+  writeU32(SortedNames.size());
+  writeU32(AbbrevTable.size());
+  writeU32(Augmentation.size());
+  OS << Augmentation;
+
+  for (const DWARFUnit *Unit : Units)
+    writeU32(Unit->getOffset());
+
+  // Buckets hold 1-based indices of the first name in the bucket.
+  std::vector<uint32_t> Buckets(BucketCount, 0);
+  for (uint32_t I = SortedNames.size(); I > 0; --I)
+    Buckets[SortedNames[I - 1]->second.Hash % BucketCount] = I;
+  for (uint32_t Bucket : Buckets)
+    writeU32(Bucket);
+
+  for (const StringMapEntry<NameData> *Name : SortedNames)
+    writeU32(Name->second.Hash);
+  for (const StringMapEntry<NameData> *Name : SortedNames)
+    writeU32(Name->second.StrOffset);
+  for (uint32_t EntryOffset : EntryOffsets)
+    writeU32(EntryOffset);
+
+  OS << AbbrevTable << EntryPool;
+
+  write32le(NamesContents.data(), NamesContents.size() - 4);
+
+  outs() << "BOLT-INFO: created .debug_names with " << SortedNames.size()
+         << " names for " << Units.size() << " compile units\n";
+
+  BC.registerOrUpdateNoteSection(".debug_names", copyByteArray(NamesContents),
+                                 NamesContents.size());
+}
+
 void DWARFRewriter::convertToRanges(DWARFDie DIE,
                                     const DebugAddressRangesVector &Ranges,
                                     SimpleBinaryPatcher &DebugInfoPatcher) {
@@ -1378,10 +1717,17 @@ DWARFRewriter::makeFinalLocListsSection(SimpleBinaryPatcher &DebugInfoPatcher) {
   std::unordered_map<uint64_t, uint64_t> SectionOffsetByCU(
       LocListWritersByCU.size());
 
+  // Emit location lists in the order of units to keep the output independent
+  // of the hash map layout.
+  std::vector<uint64_t> CUIndices;
+  CUIndices.reserve(LocListWritersByCU.size());
   for (std::pair<const uint64_t, std::unique_ptr<DebugLocWriter>> &Loc :
-       LocListWritersByCU) {
-    uint64_t CUIndex = Loc.first;
-    DebugLocWriter *LocWriter = Loc.second.get();
+       LocListWritersByCU)
+    CUIndices.push_back(Loc.first);
+  llvm::sort(CUIndices);
+
+  for (uint64_t CUIndex : CUIndices) {
+    DebugLocWriter *LocWriter = LocListWritersByCU[CUIndex].get();
     if (llvm::isa<DebugLoclistWriter>(*LocWriter))
       continue;
     SectionOffsetByCU[CUIndex] = SectionOffset;
@@ -84,11 +84,39 @@ class DWARFRewriter {
 
   std::mutex LocListDebugInfoPatchesMutex;
 
-  /// Update debug info for all DIEs in \p Unit.
+  /// Update of the address ranges of a DIE. Offsets of ranges in
+  /// .debug_ranges and abbreviation updates depend on the order in which
+  /// these updates are applied.
+  struct RangesUpdate {
+    enum UpdateKind : uint8_t {
+      UnitRanges,        /// Compile unit.
+      FunctionRanges,    /// Subprogram using DW_AT_ranges.
+      FunctionLowHighPC, /// Subprogram using DW_AT_(low|high)_pc.
+      BlockRanges,       /// Lexical block, inlined subroutine, try/catch.
+    };
+
+    UpdateKind Kind;
+    DWARFDebugInfoEntry DIE;
+    DebugAddressRangesVector Ranges;
+  };
+  using RangesUpdatesType = std::vector<RangesUpdate>;
+
+  /// Update debug info for all DIEs in \p Unit. If \p RangesUpdates is
+  /// provided, updates of address ranges are appended to it instead of being
+  /// applied, and abbreviations of \p Unit are not added to \p AbbrevWriter.
   void updateUnitDebugInfo(uint64_t CUIndex, DWARFUnit &Unit,
                            SimpleBinaryPatcher &DebugInfoPatcher,
                            DebugAbbrevWriter &AbbrevWriter,
-                           Optional<uint64_t> RangesBase = None);
+                           Optional<uint64_t> RangesBase = None,
+                           RangesUpdatesType *RangesUpdates = nullptr);
+
+  /// Apply \p Update of a DIE in \p Unit. \p CachedRanges holds offsets of
+  /// ranges written for blocks of the current function in \p Unit.
+  void applyRangesUpdate(
+      DWARFUnit &Unit, RangesUpdate &Update,
+      std::map<DebugAddressRangesVector, uint64_t> &CachedRanges,
+      SimpleBinaryPatcher &DebugInfoPatcher, DebugAbbrevWriter &AbbrevWriter,
+      Optional<uint64_t> RangesBase);
 
   /// Patches the binary for an object's address ranges to be updated.
   /// The object can be anything that has associated address ranges via either
@@ -118,6 +146,10 @@ class DWARFRewriter {
   /// Rewrite .gdb_index section if present.
   void updateGdbIndexSection();
 
+  /// Create .debug_names section if it is missing in the input. An existing
+  /// section remains valid as offsets of DIEs and strings do not change.
+  void updateDebugNamesSection();
+
   /// Output .dwo files.
   void writeDWOFiles(std::unordered_map<uint64_t, std::string> &DWOIdToName);
 
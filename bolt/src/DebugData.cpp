@@ -19,7 +19,9 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <limits>
+#include <tuple>
 
 #undef  DEBUG_TYPE
 #define DEBUG_TYPE "bolt-debug-info"
@@ -337,31 +339,60 @@ uint64_t DebugLoclistWriter::addList(const DebugLocationsVector &LocList) {
   return EntryOffset;
 }
 
+void BinaryPatcher::writePatched(raw_ostream &OS, StringRef Contents) {
+  std::string Data = Contents.str();
+  patchBinary(Data, 0);
+  assert(Data.size() == Contents.size() && "patcher changed the data size");
+  OS << Data;
+}
+
+void SimpleBinaryPatcher::addPatch(uint32_t Offset, const uint8_t *Bytes,
+                                   uint32_t Size) {
+  if (!Size)
+    return;
+
+  Patch P{Offset, Size, 0, static_cast<uint32_t>(Patches.size())};
+  if (Size <= sizeof(P.Value)) {
+    memcpy(&P.Value, Bytes, Size);
+  } else {
+    P.Value = BytesArena.size();
+    BytesArena.insert(BytesArena.end(), Bytes, Bytes + Size);
+  }
+
+  if (!Patches.empty() && Patches.back().Offset > Offset)
+    IsSorted = false;
+  Patches.push_back(P);
+}
+
 void SimpleBinaryPatcher::addBinaryPatch(uint32_t Offset,
                                          const std::string &NewValue) {
-  Patches.emplace_back(Offset, NewValue);
+  addPatch(Offset, reinterpret_cast<const uint8_t *>(NewValue.data()),
+           NewValue.size());
 }
 
 void SimpleBinaryPatcher::addBytePatch(uint32_t Offset, uint8_t Value) {
-  Patches.emplace_back(Offset, std::string(1, Value));
+  addPatch(Offset, &Value, 1);
 }
 
 void SimpleBinaryPatcher::addLEPatch(uint32_t Offset, uint64_t NewValue,
                                      size_t ByteSize) {
-  std::string LE64(ByteSize, 0);
-  for (size_t I = 0; I < ByteSize; ++I) {
-    LE64[I] = NewValue & 0xff;
-    NewValue >>= 8;
-  }
-  Patches.emplace_back(Offset, LE64);
+  uint8_t LE64[8];
+  assert(ByteSize <= sizeof(LE64) && "invalid patch size");
+  support::endian::write64le(LE64, NewValue);
+  addPatch(Offset, LE64, ByteSize);
 }
 
 void SimpleBinaryPatcher::addUDataPatch(uint32_t Offset, uint64_t Value, uint64_t Size) {
-  std::string Buff;
-  raw_string_ostream OS(Buff);
-  encodeULEB128(Value, OS, Size);
+  uint8_t Buff[16];
+  if (Size <= sizeof(Buff)) {
+    addPatch(Offset, Buff, encodeULEB128(Value, Buff, Size));
+    return;
+  }
 
-  Patches.emplace_back(Offset, OS.str());
+  std::string LargeBuff;
+  raw_string_ostream OS(LargeBuff);
+  encodeULEB128(Value, OS, Size);
+  addBinaryPatch(Offset, OS.str());
 }
 
 void SimpleBinaryPatcher::addLE64Patch(uint32_t Offset, uint64_t NewValue) {
@@ -372,17 +403,82 @@ void SimpleBinaryPatcher::addLE32Patch(uint32_t Offset, uint32_t NewValue) {
   addLEPatch(Offset, NewValue, 4);
 }
 
+void SimpleBinaryPatcher::sortPatches() {
+  if (IsSorted)
+    return;
+  std::sort(Patches.begin(), Patches.end(),
+            [](const Patch &A, const Patch &B) {
+              return std::tie(A.Offset, A.Index) < std::tie(B.Offset, B.Index);
+            });
+  IsSorted = true;
+}
+
+void SimpleBinaryPatcher::applyPatches(std::vector<Patch>::const_iterator Begin,
+                                       std::vector<Patch>::const_iterator End,
+                                       char *Buffer, uint64_t Start) const {
+  if (std::next(Begin) == End) {
+    memcpy(Buffer + (Begin->Offset - Start), getPatchBytes(*Begin),
+           Begin->Size);
+    return;
+  }
+
+  // A patch at a lower offset may have been added after a patch it overlaps.
+  SmallVector<const Patch *, 4> Group;
+  for (auto I = Begin; I != End; ++I)
+    Group.push_back(&*I);
+  std::sort(Group.begin(), Group.end(), [](const Patch *A, const Patch *B) {
+    return A->Index < B->Index;
+  });
+  for (const Patch *P : Group)
+    memcpy(Buffer + (P->Offset - Start), getPatchBytes(*P), P->Size);
+}
+
 void SimpleBinaryPatcher::patchBinary(std::string &BinaryContents,
                                       uint32_t DWPOffset = 0) {
-  for (const auto &Patch : Patches) {
-    uint32_t Offset = Patch.first - DWPOffset;
-    const std::string &ByteSequence = Patch.second;
-    assert(Offset + ByteSequence.size() <= BinaryContents.size() &&
-        "Applied patch runs over binary size.");
-    for (uint64_t I = 0, Size = ByteSequence.size(); I < Size; ++I) {
-      BinaryContents[Offset + I] = ByteSequence[I];
+  sortPatches();
+  for (auto I = Patches.cbegin(), E = Patches.cend(); I != E;) {
+    assert(I->Offset - DWPOffset + I->Size <= BinaryContents.size() &&
+           "Applied patch runs over binary size.");
+    uint64_t End = I->Offset + I->Size;
+    auto GroupEnd = std::next(I);
+    while (GroupEnd != E && GroupEnd->Offset < End) {
+      End = std::max<uint64_t>(End, GroupEnd->Offset + GroupEnd->Size);
+      ++GroupEnd;
+    }
+    applyPatches(I, GroupEnd, &BinaryContents[0], DWPOffset);
+    I = GroupEnd;
+  }
+}
+
+void SimpleBinaryPatcher::writePatched(raw_ostream &OS, StringRef Contents) {
+  sortPatches();
+
+  // Overlapping patches are combined in a temporary buffer.
+  std::string Buffer;
+  uint64_t Pos = 0;
+  for (auto I = Patches.begin(), E = Patches.end(); I != E;) {
+    assert(I->Offset + I->Size <= Contents.size() &&
+           "Applied patch runs over binary size.");
+    const uint64_t Start = I->Offset;
+    uint64_t End = Start + I->Size;
+    auto GroupEnd = std::next(I);
+    while (GroupEnd != E && GroupEnd->Offset < End) {
+      End = std::max<uint64_t>(End, GroupEnd->Offset + GroupEnd->Size);
+      ++GroupEnd;
+    }
+
+    OS << Contents.slice(Pos, Start);
+    if (GroupEnd == std::next(I)) {
+      OS.write(reinterpret_cast<const char *>(getPatchBytes(*I)), I->Size);
+    } else {
+      Buffer = Contents.slice(Start, End).str();
+      applyPatches(I, GroupEnd, &Buffer[0], Start);
+      OS << Buffer;
     }
+    Pos = End;
+    I = GroupEnd;
   }
+  OS << Contents.substr(Pos);
 }
 
 void DebugStrWriter::create() {
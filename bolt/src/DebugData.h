@@ -367,13 +367,59 @@ public:
   /// Applies in-place modifications to the binary string \p BinaryContents .
   /// \p DWPOffset used to correctly patch sections that come from DWP file.
   virtual void patchBinary(std::string &BinaryContents, uint32_t DWPOffset) = 0;
+
+  /// Writes \p Contents with modifications applied to \p OS. The size of the
+  /// written data matches the size of \p Contents.
+  virtual void writePatched(raw_ostream &OS, StringRef Contents);
 };
 
 /// Applies simple modifications to a binary string, such as directly replacing
 /// the contents of a certain portion with a string or an integer.
+///
+/// Patches are kept as fixed-size records. Values of up to 8 bytes are stored
+/// in the record itself, while longer values are stored in a separate byte
+/// arena. Patches are applied in the order of their offsets, and patches at
+/// the same offset are applied in the order they were added.
 class SimpleBinaryPatcher : public BinaryPatcher {
 private:
-  std::vector<std::pair<uint32_t, std::string>> Patches;
+  struct Patch {
+    uint32_t Offset;
+    uint32_t Size;
+    /// Patch bytes if Size <= 8, or the offset of the bytes in BytesArena.
+    uint64_t Value;
+    /// Order in which the patch was added. Of overlapping patches, the one
+    /// added last wins.
+    uint32_t Index;
+  };
+
+  std::vector<Patch> Patches;
+
+  /// Storage for patches longer than 8 bytes.
+  std::vector<uint8_t> BytesArena;
+
+  /// True if Patches are sorted by offset.
+  bool IsSorted{true};
+
+  /// Adds a patch of \p Size bytes at \p Offset.
+  void addPatch(uint32_t Offset, const uint8_t *Bytes, uint32_t Size);
+
+  /// Returns the bytes of \p P.
+  const uint8_t *getPatchBytes(const Patch &P) const {
+    return P.Size <= sizeof(P.Value)
+               ? reinterpret_cast<const uint8_t *>(&P.Value)
+               : BytesArena.data() + P.Value;
+  }
+
+  /// Sorts patches by offset, and patches at the same offset in the order
+  /// they were added.
+  void sortPatches();
+
+  /// Writes the sorted and overlapping patches in [\p Begin, \p End) to
+  /// \p Buffer holding the contents starting at offset \p Start. Patches are
+  /// applied in the order they were added.
+  void applyPatches(std::vector<Patch>::const_iterator Begin,
+                    std::vector<Patch>::const_iterator End, char *Buffer,
+                    uint64_t Start) const;
 
   /// Adds a patch to replace the contents of \p ByteSize bytes with the integer
   /// \p NewValue encoded in little-endian, with the least-significant byte
@@ -428,6 +474,9 @@ public:
 
   virtual void patchBinary(std::string &BinaryContents,
                            uint32_t DWPOffset) override;
+
+  /// Writes patched \p Contents to \p OS without making a copy of them.
+  virtual void writePatched(raw_ostream &OS, StringRef Contents) override;
 };
 
 /// Class to facilitate modifying and writing abbreviations for compilation
@@ -179,6 +179,23 @@ DynoStats getDynoStats(const BinaryFunction &BF) {
   // direction.
   BF.updateLayoutIndices();
 
+  Stats[DynoStats::INLINED_CALLS] += BF.getInlinedCallCount();
+
+  const BinaryBasicBlock *PrevBB = nullptr;
+  for (BinaryBasicBlock *const &BB : BF.layout()) {
+    // Alignment padding is executed when the block is reached by falling
+    // through from the previous block in the layout.
+    if (PrevBB && BB->getAlignmentPadding() &&
+        PrevBB->getFallthrough() == BB) {
+      const uint64_t FTCount =
+        const_cast<BinaryBasicBlock *>(PrevBB)->getBranchInfo(*BB).Count;
+      if (FTCount != BinaryBasicBlock::COUNT_NO_PROFILE)
+        Stats[DynoStats::ALIGNMENT_PADDING] +=
+          FTCount * BB->getAlignmentPadding();
+    }
+    PrevBB = BB;
+  }
+
   for (BinaryBasicBlock *const &BB : BF.layout()) {
     // The basic block execution count equals to the sum of incoming branch
     // frequencies. This may deviate from the sum of outgoing branches of the
@@ -190,6 +207,9 @@ DynoStats getDynoStats(const BinaryFunction &BF) {
     if (BB->getNumNonPseudos() == 0 || BBExecutionCount == 0)
       continue;
 
+    Stats[DynoStats::FETCH_WINDOWS_SAVED] +=
+      BBExecutionCount * BB->getFetchWindowsSaved();
+
     // Count AArch64 linker-inserted veneers
     if(BF.isAArch64Veneer())
         Stats[DynoStats::VENEER_CALLS_AARCH64] += BF.getKnownExecutionCount();
@@ -330,7 +350,17 @@ DynoStats getDynoStats(const BinaryFunction &BF) {
 
     if (UncondBranch) {
       Stats[DynoStats::UNCOND_BRANCHES] += NonTakenCount;
+      continue;
     }
+
+    // Mispredictions are only attributed to blocks terminated by the
+    // conditional branch. Otherwise the fall-through edge also carries the
+    // mispredictions of the unconditional branch.
+    uint64_t MispredictedCount = 0;
+    for (const BinaryBasicBlock::BinaryBranchInfo &BI : BB->branch_info())
+      if (BI.MispredictedCount != BinaryBasicBlock::COUNT_INFERRED)
+        MispredictedCount += BI.MispredictedCount;
+    Stats[DynoStats::MISPREDICTED_COND_BRANCHES] += MispredictedCount;
   }
 
   return Stats;
@@ -31,6 +31,7 @@ class DynoStats {
   D(FORWARD_COND_BRANCHES_TAKEN,  "taken forward branches", Fn)\
   D(BACKWARD_COND_BRANCHES,       "executed backward branches", Fn)\
   D(BACKWARD_COND_BRANCHES_TAKEN, "taken backward branches", Fn)\
+  D(MISPREDICTED_COND_BRANCHES,   "mispredicted conditional branches", Fn)\
   D(UNCOND_BRANCHES,              "executed unconditional branches", Fn)\
   D(FUNCTION_CALLS,               "all function calls", Fn)\
   D(INDIRECT_CALLS,               "indirect calls", Fn)\
@@ -40,6 +41,9 @@ class DynoStats {
   D(STORES,                       "executed store instructions", Fn)\
   D(JUMP_TABLE_BRANCHES,          "taken jump table branches", Fn)\
   D(UNKNOWN_INDIRECT_BRANCHES,    "taken unknown indirect branches", Fn)\
+  D(ALIGNMENT_PADDING,            "executed alignment padding bytes", Fn)\
+  D(FETCH_WINDOWS_SAVED,          "fetch windows saved by alignment", Fn)\
+  D(INLINED_CALLS,                "executed calls removed by inlining", Fn)\
   D(ALL_BRANCHES,                 "total branches",\
       Fadd(ALL_CONDITIONAL, UNCOND_BRANCHES))\
   D(ALL_TAKEN,                    "taken branches",\
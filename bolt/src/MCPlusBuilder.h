@@ -335,6 +335,14 @@ public:
     }
   }
 
+  /// Return the number of bytes allocated for annotation values.
+  size_t getAnnotationValuesMemory() const {
+    size_t Size = 0;
+    for (const auto &Element : AnnotationAllocators)
+      Size += Element.second.ValueAllocator.getTotalMemory();
+    return Size;
+  }
+
   using CompFuncTy = std::function<bool(const MCSymbol *, const MCSymbol *)>;
 
   bool equals(const MCInst &A, const MCInst &B, CompFuncTy Comp) const;
@@ -534,6 +542,14 @@ public:
     return false;
   }
 
+  /// Return true if \p Inst adds a constant to a register and leaves the
+  /// result in the same register, e.g. "add $imm, %reg" or "lea imm(%reg),
+  /// %reg". Set \p Reg to the register and \p Increment to the constant.
+  virtual bool isRegisterIncrement(const MCInst &Inst, MCPhysReg &Reg,
+                                   int64_t &Increment) const {
+    return false;
+  }
+
   virtual bool isMOVSX64rm32(const MCInst &Inst) const {
     llvm_unreachable("not implemented");
     return false;
@@ -1400,6 +1416,22 @@ public:
     return false;
   }
 
+  /// Create a sequence of no-op instructions with the total size of \p Size
+  /// bytes using as few instructions as possible.
+  virtual std::vector<MCInst> createNoops(uint64_t Size) const {
+    llvm_unreachable("not implemented");
+    return {};
+  }
+
+  /// Create a prefetch of the memory accessed by \p MemInst with the address
+  /// adjusted by \p Offset bytes.
+  ///
+  /// Returns false if the memory operand of \p MemInst is not supported.
+  virtual bool createPrefetch(MCInst &Inst, const MCInst &MemInst,
+                              int64_t Offset) const {
+    return false;
+  }
+
   /// Create a return instruction.
   virtual bool createReturn(MCInst &Inst) const {
     llvm_unreachable("not implemented");
@@ -1539,6 +1571,25 @@ public:
     return {};
   }
 
+  /// Create an inline version of memcpy(dest, src, \p Size).
+  virtual std::vector<MCInst> createFixedSizeMemcpy(uint64_t Size) const {
+    llvm_unreachable("not implemented");
+    return {};
+  }
+
+  /// Create an inline version of memset(dest, c, \p Size).
+  virtual std::vector<MCInst> createFixedSizeMemset(uint64_t Size) const {
+    llvm_unreachable("not implemented");
+    return {};
+  }
+
+  /// Create an inline version of memcmp(s1, s2, \p Size). Only the sign of
+  /// the result matches the library function.
+  virtual std::vector<MCInst> createFixedSizeMemcmp(uint64_t Size) const {
+    llvm_unreachable("not implemented");
+    return {};
+  }
+
   /// Create a sequence of instructions to compare contents of a register
   /// \p RegNo to immediate \Imm and jump to \p Target if they are equal.
   virtual std::vector<MCInst>
@@ -1613,6 +1664,17 @@ public:
     return false;
   }
 
+  /// Convert a register-to-register move \p Inst into a conditional move
+  /// executed only if the condition of the conditional branch \p Branch holds,
+  /// or does not hold if \p Invert is set. When the condition fails, the
+  /// converted instruction must leave the destination register unchanged.
+  ///
+  /// Returns false if either \p Inst or \p Branch is not supported.
+  virtual bool convertMoveToConditionalMove(MCInst &Inst, const MCInst &Branch,
+                                            bool Invert) const {
+    return false;
+  }
+
   /// Sets the taken target of the branch instruction to Target.
   ///
   /// Returns true on success.
@@ -1823,6 +1885,17 @@ public:
     return std::vector<MCInst>();
   }
 
+  /// Create a sequence of instructions incrementing the 8-byte counter at
+  /// \p Counters + 8 * min(\p SizeReg, \p MaxIndex). Registers and flags
+  /// are preserved.
+  virtual std::vector<MCInst>
+  createInstrSizeCounterIncrement(MCPhysReg SizeReg, uint64_t MaxIndex,
+                                  const MCSymbol *Counters,
+                                  MCContext *Ctx) const {
+    llvm_unreachable("not implemented");
+    return std::vector<MCInst>();
+  }
+
   virtual std::vector<MCInst> createInstrumentedIndCallHandlerExitBB() const {
     llvm_unreachable("not implemented");
     return std::vector<MCInst>();
@@ -0,0 +1,279 @@
+//===--- MemoryStats.cpp - Memory usage statistics ------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+//===----------------------------------------------------------------------===//
+
+#include "MemoryStats.h"
+#include "BinaryContext.h"
+#include "BinaryFunction.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <sys/resource.h>
+
+using namespace llvm;
+
+namespace opts {
+
+extern cl::OptionCategory BoltOutputCategory;
+
+cl::opt<std::string>
+MemoryStatsFile("memory-stats",
+  cl::desc("write memory usage of rewriting phases and optimization passes "
+           "to a JSON file"),
+  cl::value_desc("filename"),
+  cl::ZeroOrMore,
+  cl::cat(BoltOutputCategory));
+
+static cl::opt<bool>
+MemoryStatsResetPeak("memory-stats-reset-peak",
+  cl::desc("measure the peak resident set size of each phase separately "
+           "where the system supports resetting it"),
+  cl::init(true),
+  cl::ZeroOrMore,
+  cl::Hidden,
+  cl::cat(BoltOutputCategory));
+
+} // namespace opts
+
+namespace llvm {
+namespace bolt {
+
+namespace {
+
+struct PhaseRecord {
+  std::string Group;
+  std::string Name;
+  uint64_t RSSBefore;
+  uint64_t RSSAfter;
+  /// Peak resident set size while the phase was running, or the peak of the
+  /// process up to the end of the phase if per-phase peaks are unavailable.
+  uint64_t PeakRSS;
+  bool PerPhasePeak;
+  uint64_t HeapBefore;
+  uint64_t HeapAfter;
+};
+
+struct StructureRecord {
+  uint64_t NumFunctions{0};
+  uint64_t NumBasicBlocks{0};
+  uint64_t NumInstructions{0};
+  uint64_t InstructionBytes{0};
+  uint64_t NumAnnotatedInstructions{0};
+  uint64_t AnnotationBytes{0};
+  uint64_t NumMCSymbols{0};
+  uint64_t NumBinaryData{0};
+  uint64_t NumSections{0};
+  uint64_t SectionBytes{0};
+};
+
+std::vector<PhaseRecord> Phases;
+std::vector<StructureRecord> Structures;
+
+/// Indices of phases in progress, outermost first.
+std::vector<size_t> ActivePhases;
+
+/// Peak resident set size of the process observed before the last reset of
+/// the high water mark.
+uint64_t ProcessPeakRSS = 0;
+
+/// Return the resident set size of the process in bytes, or 0 if unknown.
+uint64_t getCurrentRSS() {
+#if defined(__linux__)
+  std::ifstream Statm("/proc/self/statm");
+  uint64_t Size = 0;
+  uint64_t Resident = 0;
+  if (Statm >> Size >> Resident)
+    return Resident * sys::Process::getPageSizeEstimate();
+#endif
+  return 0;
+}
+
+/// Return the peak resident set size of the process in bytes. On Linux, the
+/// peak is reset by resetPeakRSS().
+uint64_t getPeakRSS() {
+#if defined(__linux__)
+  std::ifstream Status("/proc/self/status");
+  std::string Line;
+  while (std::getline(Status, Line)) {
+    uint64_t KiB;
+    if (sscanf(Line.c_str(), "VmHWM: %" SCNu64 " kB", &KiB) == 1)
+      return KiB * 1024;
+  }
+#endif
+  struct rusage RU;
+  if (::getrusage(RUSAGE_SELF, &RU))
+    return 0;
+#if defined(__APPLE__)
+  return RU.ru_maxrss;
+#else
+  return RU.ru_maxrss * 1024ULL;
+#endif
+}
+
+/// Reset the peak resident set size of the process to the current one.
+/// Return false if not supported, e.g. if /proc/self/clear_refs is not
+/// writable.
+bool resetPeakRSS() {
+  if (!opts::MemoryStatsResetPeak)
+    return false;
+#if defined(__linux__)
+  std::ofstream ClearRefs("/proc/self/clear_refs");
+  ClearRefs << "5";
+  ClearRefs.flush();
+  return ClearRefs.good();
+#else
+  return false;
+#endif
+}
+
+/// Fold the peak observed since the last reset into the peaks of phases in
+/// progress and of the process.
+void updatePeakRSS() {
+  const uint64_t Peak = getPeakRSS();
+  ProcessPeakRSS = std::max(ProcessPeakRSS, Peak);
+  for (size_t Index : ActivePhases)
+    Phases[Index].PeakRSS = std::max(Phases[Index].PeakRSS, Peak);
+}
+
+/// Return the number of bytes taken by operands of \p Inst that do not fit
+/// into the inline storage of MCInst.
+uint64_t getOutOfLineSize(const MCInst &Inst) {
+  const unsigned NumInlineOperands = 8;
+  return Inst.getNumOperands() > NumInlineOperands
+             ? Inst.getNumOperands() * sizeof(MCOperand)
+             : 0;
+}
+
+} // end anonymous namespace
+
+MemoryStatsScope::MemoryStatsScope(StringRef Name, StringRef Group)
+    : Index(Phases.size()), Enabled(!opts::MemoryStatsFile.empty()) {
+  if (!Enabled)
+    return;
+
+  // The high water mark is shared by all phases, so the peak reached so far
+  // is credited to enclosing phases before it is reset for this one.
+  updatePeakRSS();
+  const bool PerPhasePeak = resetPeakRSS();
+  Phases.push_back({std::string(Group), std::string(Name), getCurrentRSS(), 0,
+                    0, PerPhasePeak, sys::Process::GetMallocUsage(), 0});
+  ActivePhases.push_back(Index);
+}
+
+MemoryStatsScope::~MemoryStatsScope() {
+  if (!Enabled)
+    return;
+
+  // Read the peak last, so that it covers the resident set size at the end.
+  PhaseRecord &Record = Phases[Index];
+  Record.RSSAfter = getCurrentRSS();
+  Record.HeapAfter = sys::Process::GetMallocUsage();
+
+  updatePeakRSS();
+  assert(ActivePhases.back() == Index && "phases are not properly nested");
+  ActivePhases.pop_back();
+}
+
+void recordMemoryStatsFor(const BinaryContext &BC) {
+  if (opts::MemoryStatsFile.empty())
+    return;
+
+  StructureRecord Record;
+  for (const auto &BFI : BC.getBinaryFunctions()) {
+    const BinaryFunction &BF = BFI.second;
+    ++Record.NumFunctions;
+    for (const BinaryBasicBlock *BB : BF.layout()) {
+      ++Record.NumBasicBlocks;
+      for (const MCInst &Inst : *BB) {
+        ++Record.NumInstructions;
+        Record.InstructionBytes += sizeof(MCInst) + getOutOfLineSize(Inst);
+
+        // Annotations are kept in an extra MCInst operand.
+        if (MCPlus::getNumPrimeOperands(Inst) == Inst.getNumOperands())
+          continue;
+        const MCInst *AnnotationInst =
+            Inst.getOperand(Inst.getNumOperands() - 1).getInst();
+        ++Record.NumAnnotatedInstructions;
+        Record.AnnotationBytes +=
+            sizeof(MCInst) + getOutOfLineSize(*AnnotationInst);
+      }
+    }
+  }
+  Record.AnnotationBytes += BC.MIB->getAnnotationValuesMemory();
+
+  Record.NumMCSymbols = BC.Ctx->getSymbols().size();
+  Record.NumBinaryData = std::distance(BC.getBinaryData().begin(),
+                                      BC.getBinaryData().end());
+  for (const BinarySection &Section : BC.sections()) {
+    ++Record.NumSections;
+    Record.SectionBytes += Section.getOutputContents().size();
+  }
+
+  Structures.push_back(Record);
+}
+
+void writeMemoryStats() {
+  if (opts::MemoryStatsFile.empty())
+    return;
+
+  std::error_code EC;
+  raw_fd_ostream OS(opts::MemoryStatsFile, EC, sys::fs::OF_None);
+  if (EC) {
+    errs() << "BOLT-WARNING: cannot write memory statistics to "
+           << opts::MemoryStatsFile << ": " << EC.message() << '\n';
+    return;
+  }
+
+  json::OStream J(OS, 2);
+  J.object([&] {
+    J.attributeArray("phases", [&] {
+      for (const PhaseRecord &Record : Phases) {
+        J.object([&] {
+          J.attribute("group", Record.Group);
+          J.attribute("name", Record.Name);
+          J.attribute("rss-before", int64_t(Record.RSSBefore));
+          J.attribute("rss-after", int64_t(Record.RSSAfter));
+          J.attribute(Record.PerPhasePeak ? "peak-rss" : "process-peak-rss",
+                      int64_t(Record.PeakRSS));
+          J.attribute("heap-before", int64_t(Record.HeapBefore));
+          J.attribute("heap-after", int64_t(Record.HeapAfter));
+        });
+      }
+    });
+    J.attributeArray("structures", [&] {
+      for (const StructureRecord &Record : Structures) {
+        J.object([&] {
+          J.attribute("functions", int64_t(Record.NumFunctions));
+          J.attribute("basic-blocks", int64_t(Record.NumBasicBlocks));
+          J.attribute("instructions", int64_t(Record.NumInstructions));
+          J.attribute("instruction-bytes", int64_t(Record.InstructionBytes));
+          J.attribute("annotated-instructions",
+                      int64_t(Record.NumAnnotatedInstructions));
+          J.attribute("annotation-bytes", int64_t(Record.AnnotationBytes));
+          J.attribute("mc-symbols", int64_t(Record.NumMCSymbols));
+          J.attribute("binary-data", int64_t(Record.NumBinaryData));
+          J.attribute("sections", int64_t(Record.NumSections));
+          J.attribute("section-bytes", int64_t(Record.SectionBytes));
+        });
+      }
+    });
+    updatePeakRSS();
+    J.attribute("peak-rss", int64_t(ProcessPeakRSS));
+  });
+  OS << '\n';
+
+  outs() << "BOLT-INFO: memory statistics written to "
+         << opts::MemoryStatsFile << '\n';
+}
+
+} // namespace bolt
+} // namespace llvm
@@ -0,0 +1,55 @@
+//===--- MemoryStats.h - Memory usage statistics --------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Memory usage of rewriting phases and optimization passes, collected with
+// -memory-stats=<file> and written out as a JSON report. For every phase the
+// report has the resident set size and the heap usage at its start and end,
+// and the peak resident set size while it ran. Per-phase peaks rely on
+// resetting the high water mark of the process on Linux; elsewhere the report
+// has the peak of the process up to the end of the phase instead, under
+// "process-peak-rss". The report also has an estimate of the memory used by
+// the main data structures of the binary context after optimization passes.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TOOLS_LLVM_BOLT_MEMORY_STATS_H
+#define LLVM_TOOLS_LLVM_BOLT_MEMORY_STATS_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include <cstddef>
+
+namespace opts {
+extern llvm::cl::opt<std::string> MemoryStatsFile;
+}
+
+namespace llvm {
+namespace bolt {
+
+class BinaryContext;
+
+/// Record memory usage of the phase \p Name in \p Group while in scope.
+class MemoryStatsScope {
+  size_t Index;
+  bool Enabled;
+
+public:
+  MemoryStatsScope(StringRef Name, StringRef Group);
+  ~MemoryStatsScope();
+};
+
+/// Record memory used by data structures of \p BC.
+void recordMemoryStatsFor(const BinaryContext &BC);
+
+/// Write memory statistics collected so far to the -memory-stats file.
+void writeMemoryStats();
+
+} // namespace bolt
+} // namespace llvm
+
+#endif
@@ -9,6 +9,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "Aligner.h"
+#include "JCCErratumMitigation.h"
 #include "ParallelUtilities.h"
 
 #define DEBUG_TYPE "bolt-aligner"
@@ -20,6 +21,7 @@ namespace opts {
 extern cl::OptionCategory BoltOptCategory;
 
 extern cl::opt<bool> AlignBlocks;
+extern cl::opt<bool> JCCErratumMitigationFlag;
 extern cl::opt<bool> PreserveBlocksAlignment;
 
 cl::opt<unsigned>
@@ -62,6 +64,23 @@ BlockAlignment("block-alignment",
   cl::ZeroOrMore,
   cl::cat(BoltOptCategory));
 
+cl::opt<bool>
+AlignBlocksCostModel("align-blocks-cost-model",
+  cl::desc("decide basic block alignment based on the estimated number of "
+           "fetch windows saved instead of fixed thresholds"),
+  cl::init(false),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+cl::opt<unsigned>
+AlignBlocksFetchWindow("align-blocks-fetch-window",
+  cl::desc("size of the instruction fetch window in bytes used by the block "
+           "alignment cost model (32 for the decoded uop cache)"),
+  cl::init(32),
+  cl::ZeroOrMore,
+  cl::Hidden,
+  cl::cat(BoltOptCategory));
+
 cl::opt<bool>
 UseCompactAligner("use-compact-aligner",
   cl::desc("Use compact approach for aligning functions"),
@@ -161,6 +180,118 @@ void AlignerPass::alignBlocks(BinaryFunction &Function,
   }
 }
 
+void AlignerPass::alignBlocksWithCostModel(BinaryFunction &Function,
+                                           const MCCodeEmitter *Emitter) {
+  if (!Function.hasValidProfile() || !Function.isSimple())
+    return;
+
+  const BinaryContext &BC = Function.getBinaryContext();
+  const uint64_t Window = opts::AlignBlocksFetchWindow;
+  // Maximum size of a single nop instruction used for padding.
+  const uint64_t MaxNopSize = BC.isX86() ? 15 : 4;
+
+  const uint64_t FuncCount =
+      std::max<uint64_t>(1, Function.getKnownExecutionCount());
+
+  const BinaryFunction::BasicBlockOrderType &Layout = Function.getLayout();
+  std::vector<std::vector<uint64_t>> InstSizes(Layout.size());
+  for (unsigned I = 0, E = Layout.size(); I != E; ++I) {
+    InstSizes[I].reserve(Layout[I]->size());
+    for (const MCInst &Inst : *Layout[I])
+      InstSizes[I].push_back(BC.MIB->isPseudo(Inst)
+                                 ? 0
+                                 : BC.computeInstructionSize(Inst, Emitter));
+  }
+
+  // Return the offset past block I placed at Offset. With the JCC erratum
+  // mitigation, include the padding the mitigation inserts later in front of
+  // hot branches crossing a 32-byte boundary.
+  auto layoutBlock = [&](unsigned I, uint64_t Offset) {
+    if (opts::JCCErratumMitigationFlag)
+      return JCCErratumMitigation::layoutBlock(*Layout[I], Offset,
+                                               InstSizes[I]);
+    for (const uint64_t Size : InstSizes[I])
+      Offset += Size;
+    return Offset;
+  };
+
+  // Estimate block offsets assuming the function starts on a window boundary,
+  // which is enforced below once a block is aligned. Padding inserted for
+  // earlier blocks shifts all following blocks.
+  uint64_t Offset = 0;
+  BinaryBasicBlock *PrevBB = nullptr;
+  bool AlignedAny = false;
+  for (unsigned I = 0, E = Layout.size(); I != E; ++I) {
+    BinaryBasicBlock *BB = Layout[I];
+    if (BB->isCold())
+      break;
+
+    BB->setAlignmentGain(0, 0);
+    const uint64_t Count = BB->getKnownExecutionCount();
+    uint64_t FTCount = 0;
+    if (PrevBB && PrevBB->getFallthrough() == BB)
+      FTCount = PrevBB->getBranchInfo(*BB).Count;
+    // A fall-through edge without profile executes no padding nops we know of.
+    if (FTCount == BinaryBasicBlock::COUNT_NO_PROFILE)
+      FTCount = 0;
+    PrevBB = BB;
+
+    const uint64_t Padding = alignTo(Offset, Window) - Offset;
+    if (!Padding || Count <= FuncCount * opts::AlignBlocksThreshold / 100) {
+      Offset = layoutBlock(I, Offset);
+      continue;
+    }
+
+    // The block starts a hot region that extends over the following blocks
+    // reached by fall-through with at least half of its execution count,
+    // e.g. the body of a loop or a hot fall-through chain.
+    unsigned RegionEnd = I + 1;
+    while (RegionEnd < E && !Layout[RegionEnd]->isCold() &&
+           Layout[RegionEnd]->getKnownExecutionCount() >= Count / 2)
+      ++RegionEnd;
+
+    // Count the windows spanned by the region placed at Start.
+    auto countWindows = [&](uint64_t Start) {
+      uint64_t End = Start;
+      for (unsigned J = I; J < RegionEnd; ++J)
+        End = layoutBlock(J, End);
+      return alignTo(End, Window) / Window - Start / Window;
+    };
+
+    const uint64_t Windows = countWindows(Offset);
+    const uint64_t AlignedWindows = countWindows(Offset + Padding);
+    const uint64_t Saved = Windows > AlignedWindows ? Windows - AlignedWindows
+                                                    : 0;
+    const uint64_t NumNops = (Padding + MaxNopSize - 1) / MaxNopSize;
+    const uint64_t BlockSize = layoutBlock(I, 0);
+
+    if (!Saved || Count * Saved <= FTCount * NumNops ||
+        (opts::AlignBlocksMinSize && BlockSize < opts::AlignBlocksMinSize)) {
+      Offset = layoutBlock(I, Offset);
+      continue;
+    }
+
+    BB->setAlignment(Window);
+    BB->setAlignmentMaxBytes(Padding);
+    BB->setAlignmentGain(Padding, Saved);
+    Offset = layoutBlock(I, Offset + Padding);
+    AlignedAny = true;
+
+    PaddingBytes += Padding;
+    WindowsSaved += Count * Saved;
+    AlignedBlocksCount += Count;
+  }
+
+  // Make sure the function starts on a window boundary so that the estimated
+  // offsets hold.
+  if (AlignedAny && BC.HasRelocations &&
+      (Function.getAlignment() < Window ||
+       Function.getMaxAlignmentBytes() < Function.getAlignment() - 1)) {
+    Function.setAlignment(std::max<uint64_t>(Function.getAlignment(), Window));
+    Function.setMaxAlignmentBytes(Function.getAlignment() - 1);
+  }
+}
+
 void AlignerPass::runOnFunctions(BinaryContext &BC) {
   if (!BC.HasRelocations)
     return;
@@ -177,14 +308,25 @@ void AlignerPass::runOnFunctions(BinaryContext &BC) {
     else
       alignMaxBytes(BF);
 
-    if (opts::AlignBlocks && !opts::PreserveBlocksAlignment)
-      alignBlocks(BF, Emitter.MCE.get());
+    if (opts::AlignBlocks && !opts::PreserveBlocksAlignment) {
+      if (opts::AlignBlocksCostModel)
+        alignBlocksWithCostModel(BF, Emitter.MCE.get());
+      else
+        alignBlocks(BF, Emitter.MCE.get());
+    }
   };
 
   ParallelUtilities::runOnEachFunction(
       BC, ParallelUtilities::SchedulingPolicy::SP_TRIVIAL, WorkFun,
       ParallelUtilities::PredicateTy(nullptr), "AlignerPass");
 
+  if (opts::AlignBlocks && opts::AlignBlocksCostModel) {
+    outs() << "BOLT-INFO: aligner: " << PaddingBytes
+           << " bytes of padding inserted, saving " << WindowsSaved
+           << " executed fetch windows in blocks executed "
+           << AlignedBlocksCount << " times\n";
+  }
+
   LLVM_DEBUG(
     dbgs() << "BOLT-DEBUG: max bytes per basic block alignment distribution:\n";
     for (unsigned I = 1; I < AlignHistogram.size(); ++I) {
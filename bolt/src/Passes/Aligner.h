@@ -25,9 +25,20 @@ private:
   /// Stats: execution count of blocks that were aligned.
   std::atomic<uint64_t> AlignedBlocksCount{0};
 
+  /// Stats: estimated padding bytes and fetch windows saved (weighted by
+  /// execution count) by the cost model.
+  std::atomic<uint64_t> PaddingBytes{0};
+  std::atomic<uint64_t> WindowsSaved{0};
+
   /// Assign alignment to basic blocks based on profile.
   void alignBlocks(BinaryFunction &Function, const MCCodeEmitter *Emitter);
 
+  /// Assign alignment to basic blocks when the estimated reduction in the
+  /// number of fetch windows executed outweighs the cost of executing the
+  /// padding.
+  void alignBlocksWithCostModel(BinaryFunction &Function,
+                                const MCCodeEmitter *Emitter);
+
 public:
   explicit AlignerPass() : BinaryFunctionPass(false) {}
 
@@ -13,6 +13,7 @@
 #include "Passes/ReorderAlgorithm.h"
 #include "Passes/ReorderFunctions.h"
 #include "llvm/Support/CommandLine.h"
+#include <fstream>
 
 #include <numeric>
 #include <vector>
@@ -228,6 +229,30 @@ StaleThreshold("stale-threshold",
     cl::Hidden,
     cl::cat(BoltOptCategory));
 
+static cl::opt<std::string>
+StartupFunctions("startup-functions",
+  cl::desc("file with names of functions executed during startup, one per "
+           "line. With -text-tiers, the functions that are not hot are placed "
+           "into a separate section"),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+cl::opt<bool>
+TextTiers("text-tiers",
+  cl::desc("split text into page-aligned .text (hot), .text.warm, "
+           ".text.startup and .text.cold (unlikely) sections based on "
+           "profile (relocation mode)"),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+TextTiersHotCoverage("text-tiers-hot-coverage",
+  cl::desc("percentage of executed instructions that should be covered by "
+           "functions in the hot text tier"),
+  cl::init(99),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
 static cl::opt<unsigned>
 TSPThreshold("tsp-threshold",
   cl::desc("maximum number of hot basic blocks in a function for which to use "
@@ -1152,6 +1177,10 @@ void AssignSections::runOnFunctions(BinaryContext &BC) {
   const bool UseColdSection =
       BC.NumProfiledFuncs > 0 ||
       opts::ReorderFunctions == ReorderFunctions::RT_USER;
+  const bool UseTiers = opts::TextTiers && UseColdSection;
+  if (UseTiers)
+    assignTiers(BC);
+
   for (auto &BFI : BC.getBinaryFunctions()) {
     BinaryFunction &Function = BFI.second;
     if (opts::isHotTextMover(Function)) {
@@ -1160,9 +1189,13 @@ void AssignSections::runOnFunctions(BinaryContext &BC) {
       continue;
     }
 
-    if (!UseColdSection ||
-        Function.hasValidIndex() ||
-        Function.hasValidProfile()) {
+    if (UseTiers && WarmFunctions.count(&Function)) {
+      Function.setCodeSectionName(BC.getWarmCodeSectionName());
+    } else if (UseTiers && StartupFunctions.count(&Function)) {
+      Function.setCodeSectionName(BC.getStartupCodeSectionName());
+    } else if (!UseColdSection ||
+               Function.hasValidIndex() ||
+               Function.hasValidProfile()) {
       Function.setCodeSectionName(BC.getMainCodeSectionName());
     } else {
       Function.setCodeSectionName(BC.getColdCodeSectionName());
@@ -1173,6 +1206,87 @@ void AssignSections::runOnFunctions(BinaryContext &BC) {
   }
 }
 
+void AssignSections::assignTiers(BinaryContext &BC) {
+  // Rank profiled functions by the density of executed instructions and put
+  // the densest ones covering the requested share of all executed
+  // instructions into the hot tier, so that it occupies as few pages as
+  // possible. The rest of profiled functions are warm.
+  struct FunctionWeight {
+    BinaryFunction *BF;
+    uint64_t NumExecutedInsts;
+    double Density;
+  };
+  std::vector<FunctionWeight> Weights;
+  uint64_t TotalExecutedInsts = 0;
+  for (auto &BFI : BC.getBinaryFunctions()) {
+    BinaryFunction &Function = BFI.second;
+    if (!Function.hasValidProfile() || opts::isHotTextMover(Function))
+      continue;
+
+    uint64_t NumExecutedInsts = 0;
+    for (const BinaryBasicBlock &BB : Function)
+      NumExecutedInsts += BB.getKnownExecutionCount() * BB.getNumNonPseudos();
+    const size_t HotSize = std::max<size_t>(1, Function.estimateHotSize());
+    Weights.push_back({&Function, NumExecutedInsts,
+                       static_cast<double>(NumExecutedInsts) / HotSize});
+    TotalExecutedInsts += NumExecutedInsts;
+  }
+
+  std::stable_sort(Weights.begin(), Weights.end(),
+                   [](const FunctionWeight &A, const FunctionWeight &B) {
+                     return A.Density > B.Density;
+                   });
+
+  const uint64_t HotThreshold =
+      TotalExecutedInsts *
+      std::min<uint64_t>(100, opts::TextTiersHotCoverage) / 100;
+  uint64_t Covered = 0;
+  uint64_t NumHot = 0;
+  for (const FunctionWeight &FW : Weights) {
+    // Functions with profile but without executed instructions never make
+    // it into the hot tier.
+    if (Covered >= HotThreshold || !FW.NumExecutedInsts) {
+      WarmFunctions.insert(FW.BF);
+      continue;
+    }
+    Covered += FW.NumExecutedInsts;
+    ++NumHot;
+  }
+
+  if (!opts::StartupFunctions.empty()) {
+    std::ifstream FuncsFile(opts::StartupFunctions, std::ios::in);
+    if (!FuncsFile) {
+      errs() << "BOLT-ERROR: startup functions file \""
+             << opts::StartupFunctions << "\" can't be opened\n";
+      exit(1);
+    }
+    std::unordered_set<std::string> Names;
+    std::string FuncName;
+    while (std::getline(FuncsFile, FuncName))
+      if (!FuncName.empty())
+        Names.insert(FuncName);
+
+    // Hot functions stay in the hot tier even if executed during startup.
+    for (auto &BFI : BC.getBinaryFunctions()) {
+      BinaryFunction &Function = BFI.second;
+      if (opts::isHotTextMover(Function) ||
+          (Function.hasValidProfile() && !WarmFunctions.count(&Function)))
+        continue;
+      if (!Function.forEachName(
+              [&](StringRef Name) { return Names.count(Name.str()) > 0; }))
+        continue;
+      WarmFunctions.erase(&Function);
+      StartupFunctions.insert(&Function);
+    }
+  }
+
+  outs() << "BOLT-INFO: text tiers: " << NumHot << " hot functions cover "
+         << Covered << " out of " << TotalExecutedInsts
+         << " executed instructions, " << WarmFunctions.size()
+         << " warm functions, " << StartupFunctions.size()
+         << " startup functions\n";
+}
+
 void PrintProfileStats::runOnFunctions(BinaryContext &BC) {
   double FlowImbalanceMean = 0.0;
   size_t NumBlocksConsidered = 0;
@@ -344,6 +344,14 @@ public:
 
 /// Assign output sections to all functions.
 class AssignSections : public BinaryFunctionPass {
+  /// Functions assigned to the warm and startup text tiers.
+  std::unordered_set<const BinaryFunction *> WarmFunctions;
+  std::unordered_set<const BinaryFunction *> StartupFunctions;
+
+  /// Split functions into text tiers based on profile and the list of
+  /// startup functions.
+  void assignTiers(BinaryContext &BC);
+
  public:
   explicit AssignSections()
     : BinaryFunctionPass(false) {
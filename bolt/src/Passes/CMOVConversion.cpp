@@ -0,0 +1,170 @@
+//===--- Passes/CMOVConversion.cpp ----------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+//===----------------------------------------------------------------------===//
+
+#include "CMOVConversion.h"
+#include "llvm/Support/CommandLine.h"
+
+#define DEBUG_TYPE "bolt-cmov"
+
+using namespace llvm;
+
+namespace opts {
+
+extern cl::OptionCategory BoltOptCategory;
+
+static cl::opt<unsigned>
+CMOVMispredictThreshold("cmov-conversion-mispredict-threshold",
+  cl::desc("minimum misprediction rate in percent for a branch to be "
+           "converted into conditional moves"),
+  cl::init(10),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+CMOVMaxMoves("cmov-conversion-max-moves",
+  cl::desc("maximum number of moves in both arms of a converted branch"),
+  cl::init(4),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+} // namespace opts
+
+namespace llvm {
+namespace bolt {
+
+bool CMOVConversion::convertArm(const BinaryBasicBlock &Arm,
+                                const MCInst &Branch, bool Invert,
+                                std::vector<MCInst> &Moves) const {
+  const BinaryContext &BC = Arm.getFunction()->getBinaryContext();
+  for (const MCInst &Inst : Arm) {
+    if (BC.MIB->isUnconditionalBranch(Inst) && &Inst == &Arm.back())
+      continue;
+
+    MCInst Move = Inst;
+    if (!BC.MIB->convertMoveToConditionalMove(Move, Branch, Invert))
+      return false;
+    Moves.emplace_back(std::move(Move));
+  }
+  return true;
+}
+
+bool CMOVConversion::runOnFunction(BinaryFunction &BF) {
+  bool Modified = false;
+
+  // Blocks are removed as the CFG changes, so iterate over a copy.
+  const BinaryFunction::BasicBlockOrderType Layout = BF.getLayout();
+  for (BinaryBasicBlock *BB : Layout) {
+    if (!BB->isValid() || BB->succ_size() != 2 || BB->hasJumpTable())
+      continue;
+
+    const uint64_t Count = BB->getKnownExecutionCount();
+    if (!Count)
+      continue;
+
+    const MCSymbol *TBB = nullptr;
+    const MCSymbol *FBB = nullptr;
+    MCInst *CondBranch = nullptr;
+    MCInst *UncondBranch = nullptr;
+    if (!BB->analyzeBranch(TBB, FBB, CondBranch, UncondBranch) || !CondBranch)
+      continue;
+
+    uint64_t MispredictedCount = 0;
+    for (const BinaryBasicBlock::BinaryBranchInfo &BI : BB->branch_info())
+      if (BI.MispredictedCount != BinaryBasicBlock::COUNT_INFERRED)
+        MispredictedCount += BI.MispredictedCount;
+    if (MispredictedCount * 100 < Count * opts::CMOVMispredictThreshold)
+      continue;
+
+    BinaryBasicBlock *Taken = BB->getConditionalSuccessor(true);
+    BinaryBasicBlock *NotTaken = BB->getConditionalSuccessor(false);
+    auto isArm = [&](const BinaryBasicBlock *Arm) {
+      return Arm != BB && Arm->pred_size() == 1 && Arm->succ_size() == 1 &&
+             !Arm->isLandingPad() && !Arm->isEntryPoint();
+    };
+
+    // Find the join block and the arms that lead to it.
+    BinaryBasicBlock *Join = nullptr;
+    std::vector<std::pair<BinaryBasicBlock *, bool>> Arms;
+    if (isArm(Taken) && isArm(NotTaken) &&
+        Taken->getSuccessor() == NotTaken->getSuccessor()) {
+      Join = Taken->getSuccessor();
+      Arms = {{NotTaken, true}, {Taken, false}};
+    } else if (isArm(NotTaken) && NotTaken->getSuccessor() == Taken) {
+      Join = Taken;
+      Arms = {{NotTaken, true}};
+    } else if (isArm(Taken) && Taken->getSuccessor() == NotTaken) {
+      Join = NotTaken;
+      Arms = {{Taken, false}};
+    } else {
+      continue;
+    }
+    if (Join == BB)
+      continue;
+
+    ++NumCandidateBranches;
+    CandidateMispredictedCount += MispredictedCount;
+
+    // The moves of both arms execute unconditionally after conversion. Moves
+    // of the two arms of a diamond can be applied in any order, as only the
+    // moves of one arm take effect.
+    std::vector<MCInst> Moves;
+    bool Convertible = true;
+    for (const std::pair<BinaryBasicBlock *, bool> &Arm : Arms)
+      Convertible &= convertArm(*Arm.first, *CondBranch, Arm.second, Moves);
+    if (!Convertible || Moves.empty() || Moves.size() > opts::CMOVMaxMoves)
+      continue;
+
+    LLVM_DEBUG(dbgs() << "BOLT-DEBUG: converting branch in " << BB->getName()
+                      << " of " << BF << " with " << Moves.size()
+                      << " moves. Count: " << Count
+                      << ", mispredicted: " << MispredictedCount << '\n');
+
+    if (UncondBranch)
+      BB->eraseInstruction(BB->findInstruction(UncondBranch));
+    BB->eraseInstruction(BB->findInstruction(CondBranch));
+    BB->addInstructions(Moves.begin(), Moves.end());
+
+    BB->removeAllSuccessors();
+    BB->addSuccessor(Join, Count, 0);
+    for (const std::pair<BinaryBasicBlock *, bool> &Arm : Arms)
+      Arm.first->markValid(false);
+
+    ++NumConvertedBranches;
+    ConvertedCount += Count;
+    ConvertedMispredictedCount += MispredictedCount;
+    Modified = true;
+  }
+
+  if (Modified) {
+    BF.eraseInvalidBBs();
+    BF.fixBranches();
+  }
+
+  return Modified;
+}
+
+void CMOVConversion::runOnFunctions(BinaryContext &BC) {
+  for (auto &BFI : BC.getBinaryFunctions()) {
+    BinaryFunction &BF = BFI.second;
+    if (!shouldOptimize(BF) || !BF.hasValidProfile())
+      continue;
+    runOnFunction(BF);
+  }
+
+  outs() << "BOLT-INFO: converted " << NumConvertedBranches << " out of "
+         << NumCandidateBranches
+         << " frequently mispredicted branches into conditional moves, "
+         << "removing " << ConvertedMispredictedCount << " out of "
+         << CandidateMispredictedCount << " mispredictions in "
+         << ConvertedCount << " executions\n";
+}
+
+} // end namespace bolt
+} // end namespace llvm
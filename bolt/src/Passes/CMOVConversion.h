@@ -0,0 +1,69 @@
+//===--- Passes/CMOVConversion.h ------------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Convert hot and frequently mispredicted conditional branches into
+// conditional moves. The pass looks for triangles and diamonds in the CFG
+// whose arms consist only of register-to-register moves:
+//
+//   BB:  jcc T              BB:  jcc T
+//   F:   mov %r1, %r0       F:   mov %r1, %r0
+//   T:   ...                     jmp J
+//                           T:   mov %r2, %r0
+//                           J:   ...
+//
+// and replaces the branch with conditional moves guarded by the branch
+// condition:
+//
+//   BB:  cmovncc %r1, %r0   BB:  cmovncc %r1, %r0
+//   T:   ...                     cmovcc %r2, %r0
+//                           J:   ...
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TOOLS_LLVM_BOLT_PASSES_CMOV_CONVERSION_H
+#define LLVM_TOOLS_LLVM_BOLT_PASSES_CMOV_CONVERSION_H
+
+#include "BinaryPasses.h"
+
+namespace llvm {
+namespace bolt {
+
+class CMOVConversion : public BinaryFunctionPass {
+  /// Stats: number of converted branches, their execution and misprediction
+  /// counts.
+  uint64_t NumConvertedBranches{0};
+  uint64_t ConvertedCount{0};
+  uint64_t ConvertedMispredictedCount{0};
+
+  /// Stats: number of candidate branches and their misprediction count.
+  uint64_t NumCandidateBranches{0};
+  uint64_t CandidateMispredictedCount{0};
+
+  /// Append to \p Moves conditional moves for instructions in \p Arm, executed
+  /// if the condition of \p Branch holds (or fails, if \p Invert is set).
+  /// Return false if \p Arm contains anything other than convertible moves
+  /// and an unconditional branch.
+  bool convertArm(const BinaryBasicBlock &Arm, const MCInst &Branch,
+                  bool Invert, std::vector<MCInst> &Moves) const;
+
+  /// Convert eligible branches in \p BF. Return true if \p BF was modified.
+  bool runOnFunction(BinaryFunction &BF);
+
+public:
+  explicit CMOVConversion(const cl::opt<bool> &PrintPass)
+      : BinaryFunctionPass(PrintPass) {}
+
+  const char *getName() const override { return "cmov-conversion"; }
+
+  void runOnFunctions(BinaryContext &BC) override;
+};
+
+} // namespace bolt
+} // namespace llvm
+
+#endif
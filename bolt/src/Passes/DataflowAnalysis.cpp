@@ -10,8 +10,27 @@
 
 #include "DataflowAnalysis.h"
 
+#include <atomic>
+
 #define DEBUG_TYPE "dataflow"
 
+using namespace llvm;
+
+namespace opts {
+
+extern cl::OptionCategory BoltOptCategory;
+
+cl::opt<bool>
+DataflowDenseState("dataflow-dense-state",
+  cl::desc("keep the per-instruction states of dataflow analyses supporting "
+           "it in storage owned by the analysis instead of in annotations"),
+  cl::init(true),
+  cl::ZeroOrMore,
+  cl::Hidden,
+  cl::cat(BoltOptCategory));
+
+} // namespace opts
+
 namespace llvm {
 
 raw_ostream &operator<<(raw_ostream &OS, const BitVector &State) {
@@ -42,6 +61,11 @@ raw_ostream &operator<<(raw_ostream &OS, const BitVector &State) {
 
 namespace bolt {
 
+uint64_t getNextDataflowInstanceId() {
+  static std::atomic<uint64_t> NextId{1};
+  return NextId++;
+}
+
 void doForAllPreds(const BinaryContext &BC, const BinaryBasicBlock &BB,
                    std::function<void(ProgramPoint)> Task) {
   for (BinaryBasicBlock *Pred : BB.predecessors()) {
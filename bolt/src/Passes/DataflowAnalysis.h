@@ -13,9 +13,16 @@
 
 #include "BinaryContext.h"
 #include "BinaryFunction.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Errc.h"
+#include <deque>
 #include <queue>
 
+namespace opts {
+extern llvm::cl::opt<bool> DataflowDenseState;
+}
+
 namespace llvm {
 namespace bolt {
 
@@ -100,6 +107,26 @@ void doForAllPreds(const BinaryContext &BC, const BinaryBasicBlock &BB,
 void doForAllSuccs(const BinaryBasicBlock &BB,
                    std::function<void(ProgramPoint)> Task);
 
+/// Annotation value of an instruction whose state is owned by an analysis
+/// with dense state.
+struct DenseStateRef {
+  /// Id of the analysis instance owning the state.
+  uint64_t Owner;
+  /// Index of the state in the storage of its owner.
+  unsigned Index;
+
+  bool operator==(const DenseStateRef &Other) const {
+    return Owner == Other.Owner && Index == Other.Index;
+  }
+};
+
+inline raw_ostream &operator<<(raw_ostream &OS, const DenseStateRef &Ref) {
+  return OS << "DenseState(" << Ref.Owner << ", " << Ref.Index << ")";
+}
+
+/// Return a new id for an analysis instance, unique for the process.
+uint64_t getNextDataflowInstanceId();
+
 /// Default printer for State data.
 template <typename StateTy>
 class StatePrinter {
@@ -179,6 +206,28 @@ protected:
   /// otherwise our clients need to keep "prev" pointers themselves.
   DenseMap<const MCInst *, ProgramPoint> PrevPoint;
 
+  /// Owns the state at each instruction for analyses with dense state, see
+  /// hasDenseState(). Instructions are annotated with a DenseStateRef holding
+  /// the index of their state. A deque keeps references to the states valid
+  /// while new ones are created.
+  std::deque<StateTy> DenseState;
+
+  /// Tells the DenseStateRef annotations of this instance apart from the ones
+  /// left with the same name by other instances of the analysis.
+  const uint64_t InstanceId{getNextDataflowInstanceId()};
+
+  /// Return true if the state at each instruction is stored in DenseState
+  /// instead of in its own annotation. This saves allocating, tracking and
+  /// destroying one annotation value per instruction and keeps the states of
+  /// the function contiguous in memory.
+  bool hasDenseState() const {
+    return false;
+  }
+
+  bool usesDenseState() const {
+    return opts::DataflowDenseState && const_derived().hasDenseState();
+  }
+
   /// Perform any bookkeeping before dataflow starts
   void preflight() {
     llvm_unreachable("Unimplemented method");
@@ -241,8 +290,20 @@ protected:
   }
 
   StateTy &getOrCreateStateAt(MCInst &Point) {
-    return BC.MIB->getOrCreateAnnotationAs<StateTy>(
+    if (!usesDenseState())
+      return BC.MIB->getOrCreateAnnotationAs<StateTy>(
+          Point, derived().getAnnotationIndex(), AllocatorId);
+
+    DenseStateRef &Ref = BC.MIB->getOrCreateAnnotationAs<DenseStateRef>(
         Point, derived().getAnnotationIndex(), AllocatorId);
+    if (Ref.Owner == InstanceId && Ref.Index < DenseState.size())
+      return DenseState[Ref.Index];
+
+    // The annotation is new or was left by another instance.
+    Ref.Owner = InstanceId;
+    Ref.Index = DenseState.size();
+    DenseState.emplace_back();
+    return DenseState.back();
   }
 
   StateTy &getOrCreateStateAt(ProgramPoint Point) {
@@ -290,8 +351,18 @@ public:
   /// Track the state at the end (start) of each MCInst in this function if
   /// the direction of the dataflow is forward (backward).
   ErrorOr<const StateTy &> getStateAt(const MCInst &Point) const {
-    return BC.MIB->tryGetAnnotationAs<StateTy>(
-        Point, const_derived().getAnnotationIndex());
+    if (!usesDenseState())
+      return BC.MIB->tryGetAnnotationAs<StateTy>(
+          Point, const_derived().getAnnotationIndex());
+
+    ErrorOr<const DenseStateRef &> Ref =
+        BC.MIB->tryGetAnnotationAs<DenseStateRef>(
+            Point, const_derived().getAnnotationIndex());
+    if (!Ref)
+      return Ref.getError();
+    if (Ref->Owner != InstanceId || Ref->Index >= DenseState.size())
+      return make_error_code(errc::result_out_of_range);
+    return DenseState[Ref->Index];
   }
 
   /// Return the out set (in set) of a given program point if the direction of
@@ -322,6 +393,7 @@ public:
         BC.MIB->removeAnnotation(Inst, derived().getAnnotationIndex());
       }
     }
+    DenseState.clear();
   }
 
   /// Public entry point that will perform the entire analysis form start to
@@ -340,12 +412,23 @@ public:
     }
     assert(Func.begin() != Func.end() && "Unexpected empty function");
 
+    // Blocks are queued at most once at any time, so that a block reached by
+    // several changed predecessors (successors) is only recomputed once.
     std::queue<BinaryBasicBlock *> Worklist;
+    BitVector InWorklist(Func.size());
+    auto pushBB = [&](BinaryBasicBlock *BB) {
+      assert(BB->getIndex() < Func.size() && "invalid basic block index");
+      if (InWorklist[BB->getIndex()])
+        return;
+      InWorklist.set(BB->getIndex());
+      Worklist.push(BB);
+    };
+
     // TODO: Pushing this in a DFS ordering will greatly speed up the dataflow
     // performance.
     if (!Backward) {
       for (BinaryBasicBlock &BB : Func) {
-        Worklist.push(&BB);
+        pushBB(&BB);
         MCInst *Prev = nullptr;
         for (MCInst &Inst : BB) {
           PrevPoint[&Inst] = Prev ? ProgramPoint(Prev) : ProgramPoint(&BB);
@@ -354,7 +437,7 @@ public:
       }
     } else {
       for (auto I = Func.rbegin(), E = Func.rend(); I != E; ++I) {
-        Worklist.push(&*I);
+        pushBB(&*I);
         MCInst *Prev = nullptr;
         for (auto J = (*I).rbegin(), E2 = (*I).rend(); J != E2; ++J) {
           MCInst &Inst = *J;
@@ -368,6 +451,7 @@ public:
     while (!Worklist.empty()) {
       BinaryBasicBlock *BB = Worklist.front();
       Worklist.pop();
+      InWorklist.reset(BB->getIndex());
 
       // Calculate state at the entry of first instruction in BB
       StateTy StateAtEntry = getOrCreateStateAt(*BB);
@@ -439,17 +523,17 @@ public:
       if (Changed) {
         if (!Backward) {
           for (BinaryBasicBlock *Succ : BB->successors()) {
-            Worklist.push(Succ);
+            pushBB(Succ);
           }
           for (BinaryBasicBlock *LandingPad : BB->landing_pads()) {
-            Worklist.push(LandingPad);
+            pushBB(LandingPad);
           }
         } else {
           for (BinaryBasicBlock *Pred : BB->predecessors()) {
-            Worklist.push(Pred);
+            pushBB(Pred);
           }
           for (BinaryBasicBlock *Thrower : BB->throwers()) {
-            Worklist.push(Thrower);
+            pushBB(Thrower);
           }
         }
       }
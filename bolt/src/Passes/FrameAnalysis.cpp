@@ -260,10 +260,9 @@ void FrameAnalysis::addArgInStackAccessFor(MCInst &Inst,
   Set.emplace(Arg);
 }
 
-void FrameAnalysis::addFIEFor(MCInst &Inst, const FrameIndexEntry &FIE) {
-  BC.MIB->addAnnotation(Inst, "FrameAccessEntry",
-                        (unsigned)FIEVector.size());
-  FIEVector.emplace_back(FIE);
+void FrameAnalysis::addFIEFor(MCInst &Inst, const FrameIndexEntry &FIE,
+                              MCPlusBuilder::AllocatorIdTy AllocId) {
+  BC.MIB->addAnnotation(Inst, "FrameAccessEntry", FIE, AllocId);
 }
 
 ErrorOr<ArgAccesses &> FrameAnalysis::getArgAccessesFor(const MCInst &Inst) {
@@ -285,12 +284,7 @@ FrameAnalysis::getArgAccessesFor(const MCInst &Inst) const {
 
 ErrorOr<const FrameIndexEntry &>
 FrameAnalysis::getFIEFor(const MCInst &Inst) const {
-  if (auto Idx =
-          BC.MIB->tryGetAnnotationAs<unsigned>(Inst, "FrameAccessEntry")) {
-    assert(FIEVector.size() > *Idx && "Out of bounds");
-    return FIEVector[*Idx];
-  }
-  return make_error_code(errc::result_out_of_range);
+  return BC.MIB->tryGetAnnotationAs<FrameIndexEntry>(Inst, "FrameAccessEntry");
 }
 
 void FrameAnalysis::traverseCG(BinaryFunctionCallGraph &CG) {
@@ -464,7 +458,8 @@ bool FrameAnalysis::computeArgsAccessed(BinaryFunction &BF) {
   return UpdatedArgsTouched;
 }
 
-bool FrameAnalysis::restoreFrameIndex(BinaryFunction &BF) {
+bool FrameAnalysis::restoreFrameIndex(BinaryFunction &BF,
+                                      MCPlusBuilder::AllocatorIdTy AllocId) {
   FrameAccessAnalysis FAA(BC, BF, getSPT(BF));
 
   LLVM_DEBUG(dbgs() << "Restoring frame indices for \"" << BF.getPrintName()
@@ -487,7 +482,7 @@ bool FrameAnalysis::restoreFrameIndex(BinaryFunction &BF) {
 
       const FrameIndexEntry &FIE = FAA.getFIE();
 
-      addFIEFor(Inst, FIE);
+      addFIEFor(Inst, FIE, AllocId);
       LLVM_DEBUG({
         dbgs() << "Frame index annotation " << FIE << " added to:\n";
         BC.printInstruction(dbgs(), Inst, 0, &BF, true);
@@ -497,6 +492,40 @@ bool FrameAnalysis::restoreFrameIndex(BinaryFunction &BF) {
   return true;
 }
 
+void FrameAnalysis::restoreFrameIndices(
+    const std::vector<BinaryFunction *> &Funcs) {
+  // Create an index for the annotation and map entries for the results to
+  // allow lock-free parallel execution
+  BC.MIB->getOrCreateAnnotationIndex("FrameAccessEntry");
+  std::unordered_map<const BinaryFunction *, bool> Restored;
+  for (const BinaryFunction *BF : Funcs)
+    Restored.emplace(BF, false);
+
+  ParallelUtilities::WorkFuncWithAllocTy WorkFunction =
+      [&](BinaryFunction &BF, MCPlusBuilder::AllocatorIdTy AllocId) {
+        Restored.find(&BF)->second = restoreFrameIndex(BF, AllocId);
+      };
+
+  ParallelUtilities::PredicateTy SkipPredicate = [&](const BinaryFunction &BF) {
+    return !Restored.count(&BF);
+  };
+
+  ParallelUtilities::runOnEachFunctionWithUniqueAllocId(
+      BC, ParallelUtilities::SchedulingPolicy::SP_INST_LINEAR, WorkFunction,
+      SkipPredicate, "restoreFrameIndices");
+
+  for (BinaryFunction *BF : Funcs) {
+    if (Restored[BF]) {
+      AnalyzedFunctions.insert(BF);
+      continue;
+    }
+    ++NumFunctionsFailedRestoreFI;
+    const uint64_t Count = BF->getExecutionCount();
+    if (Count != BinaryFunction::COUNT_NO_PROFILE)
+      CountFunctionsFailedRestoreFI += Count;
+  }
+}
+
 void FrameAnalysis::cleanAnnotations() {
   NamedRegionTimer T("cleanannotations", "clean annotations", "FA",
                      "FA breakdown", opts::TimeFA);
@@ -533,6 +562,7 @@ FrameAnalysis::FrameAnalysis(BinaryContext &BC, BinaryFunctionCallGraph &CG)
     traverseCG(CG);
   }
 
+  std::vector<BinaryFunction *> Funcs;
   for (auto &I : BC.getBinaryFunctions()) {
     uint64_t Count = I.second.getExecutionCount();
     if (Count != BinaryFunction::COUNT_NO_PROFILE)
@@ -547,18 +577,13 @@ FrameAnalysis::FrameAnalysis(BinaryContext &BC, BinaryFunctionCallGraph &CG)
       continue;
     }
 
-    {
-      NamedRegionTimer T1("restorefi", "restore frame index", "FA",
-                          "FA breakdown", opts::TimeFA);
-      if (!restoreFrameIndex(I.second)) {
-        ++NumFunctionsFailedRestoreFI;
-        uint64_t Count = I.second.getExecutionCount();
-        if (Count != BinaryFunction::COUNT_NO_PROFILE)
-          CountFunctionsFailedRestoreFI += Count;
-        continue;
-      }
-    }
-    AnalyzedFunctions.insert(&I.second);
+    Funcs.push_back(&I.second);
+  }
+
+  {
+    NamedRegionTimer T1("restorefi", "restore frame index", "FA",
+                        "FA breakdown", opts::TimeFA);
+    restoreFrameIndices(Funcs);
   }
 
   {
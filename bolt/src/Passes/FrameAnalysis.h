@@ -44,6 +44,14 @@ struct FrameIndexEntry {
   bool IsSimple;
 
   uint16_t StackPtrReg;
+
+  bool operator==(const FrameIndexEntry &Other) const {
+    return IsLoad == Other.IsLoad && IsStore == Other.IsStore &&
+           IsStoreFromReg == Other.IsStoreFromReg &&
+           RegOrImm == Other.RegOrImm && StackOffset == Other.StackOffset &&
+           Size == Other.Size && IsSimple == Other.IsSimple &&
+           StackPtrReg == Other.StackPtrReg;
+  }
 };
 
 /// Record an access to an argument in stack. This should be attached to
@@ -126,9 +134,9 @@ class FrameAnalysis {
 
   /// Owns ArgAccesses for all instructions. References to elements are
   /// attached to instructions as indexes to this vector, in MCAnnotations.
+  /// FrameIndexEntries are attached to instructions by value, so that they can
+  /// be created for different functions in parallel.
   std::vector<ArgAccesses> ArgAccessesVector;
-  /// Same for FrameIndexEntries.
-  std::vector<FrameIndexEntry> FIEVector;
 
   /// Analysis stats counters
   uint64_t NumFunctionsNotOptimized{0};
@@ -141,7 +149,8 @@ class FrameAnalysis {
   /// our specific data
   void addArgAccessesFor(MCInst &Inst, ArgAccesses &&AA);
   void addArgInStackAccessFor(MCInst &Inst, const ArgInStackAccess &Arg);
-  void addFIEFor(MCInst &Inst, const FrameIndexEntry &FIE);
+  void addFIEFor(MCInst &Inst, const FrameIndexEntry &FIE,
+                 MCPlusBuilder::AllocatorIdTy AllocId);
 
   /// Perform the step of building the set of registers clobbered by each
   /// function execution, populating RegsKilledMap and RegsGenMap.
@@ -163,7 +172,13 @@ class FrameAnalysis {
   /// instruction in function \p BF. Add MCAnnotation<FrameIndexEntry> to
   /// instructions that access a frame position. Return false if it failed
   /// to analyze and this information can't be safely determined for \p BF.
-  bool restoreFrameIndex(BinaryFunction &BF);
+  /// Annotation values are allocated with \p AllocId.
+  bool restoreFrameIndex(BinaryFunction &BF,
+                         MCPlusBuilder::AllocatorIdTy AllocId = 0);
+
+  /// Run restoreFrameIndex() on all functions in \p Funcs in parallel and
+  /// update the set of analyzed functions.
+  void restoreFrameIndices(const std::vector<BinaryFunction *> &Funcs);
 
   /// A store for SPT info per function
   std::unordered_map<const BinaryFunction *,
@@ -54,11 +54,10 @@ RemoveStores("frame-opt-rm-stores",
 namespace llvm {
 namespace bolt {
 
-void FrameOptimizerPass::removeUnnecessaryLoads(const RegAnalysis &RA,
-                                                const FrameAnalysis &FA,
-                                                const BinaryContext &BC,
-                                                BinaryFunction &BF) {
-  StackAvailableExpressions SAE(RA, FA, BC, BF);
+void FrameOptimizerPass::removeUnnecessaryLoads(
+    const RegAnalysis &RA, const FrameAnalysis &FA, const BinaryContext &BC,
+    BinaryFunction &BF, MCPlusBuilder::AllocatorIdTy AllocId) {
+  StackAvailableExpressions SAE(RA, FA, BC, BF, AllocId);
   SAE.run();
 
   LLVM_DEBUG(dbgs() << "Performing unnecessary loads removal\n");
@@ -159,10 +158,10 @@ void FrameOptimizerPass::removeUnnecessaryLoads(const RegAnalysis &RA,
   }
 }
 
-void FrameOptimizerPass::removeUnusedStores(const FrameAnalysis &FA,
-                                            const BinaryContext &BC,
-                                            BinaryFunction &BF) {
-  StackReachingUses SRU(FA, BC, BF);
+void FrameOptimizerPass::removeUnusedStores(
+    const FrameAnalysis &FA, const BinaryContext &BC, BinaryFunction &BF,
+    MCPlusBuilder::AllocatorIdTy AllocId) {
+  StackReachingUses SRU(FA, BC, BF, AllocId);
   SRU.run();
 
   LLVM_DEBUG(dbgs() << "Performing unused stores removal\n");
@@ -250,37 +249,7 @@ void FrameOptimizerPass::runOnFunctions(BinaryContext &BC) {
 
   // Perform caller-saved register optimizations, then callee-saved register
   // optimizations (shrink wrapping)
-  for (auto &I : BC.getBinaryFunctions()) {
-    if (!FA->hasFrameInfo(I.second))
-      continue;
-    // Restrict pass execution if user asked to only run on hot functions
-    if (opts::FrameOptimization == FOP_HOT) {
-      if (I.second.getKnownExecutionCount() < BC.getHotThreshold())
-        continue;
-      LLVM_DEBUG(
-          dbgs() << "Considering " << I.second.getPrintName()
-                 << " for frame optimizations because its execution count ( "
-                 << I.second.getKnownExecutionCount()
-                 << " ) exceeds our hotness threshold ( "
-                 << BC.getHotThreshold() << " )\n");
-    }
-
-    {
-      NamedRegionTimer T1("removeloads", "remove loads", "FOP", "FOP breakdown",
-                          opts::TimeOpts);
-      removeUnnecessaryLoads(*RA, *FA, BC, I.second);
-    }
-
-    if (opts::RemoveStores) {
-      NamedRegionTimer T1("removestores", "remove stores", "FOP",
-                          "FOP breakdown", opts::TimeOpts);
-      removeUnusedStores(*FA, BC, I.second);
-    }
-    // Don't even start shrink wrapping if no profiling info is available
-    if (I.second.getKnownExecutionCount() == 0)
-      continue;
-
-  }
+  performFrameAccessRemoval(*RA, *FA, BC);
 
   {
     NamedRegionTimer T1("shrinkwrapping", "shrink wrapping", "FOP",
@@ -300,6 +269,51 @@ void FrameOptimizerPass::runOnFunctions(BinaryContext &BC) {
   ShrinkWrapping::printStats();
 }
 
+void FrameOptimizerPass::performFrameAccessRemoval(const RegAnalysis &RA,
+                                                   const FrameAnalysis &FA,
+                                                   BinaryContext &BC) {
+  // Initialize necessary annotations to allow safe parallel accesses to
+  // annotation index in MIB
+  BC.MIB->getOrCreateAnnotationIndex("StackAvailableExpressions");
+  BC.MIB->getOrCreateAnnotationIndex("StackReachingUses");
+
+  ParallelUtilities::PredicateTy SkipPredicate = [&](const BinaryFunction &BF) {
+    if (!FA.hasFrameInfo(BF))
+      return true;
+
+    // Restrict pass execution if user asked to only run on hot functions
+    if (opts::FrameOptimization == FOP_HOT &&
+        BF.getKnownExecutionCount() < BC.getHotThreshold())
+      return true;
+
+    return false;
+  };
+
+  {
+    NamedRegionTimer T1("removeloads", "remove loads", "FOP", "FOP breakdown",
+                        opts::TimeOpts);
+    ParallelUtilities::WorkFuncWithAllocTy WorkFunction =
+        [&](BinaryFunction &BF, MCPlusBuilder::AllocatorIdTy AllocatorId) {
+          removeUnnecessaryLoads(RA, FA, BC, BF, AllocatorId);
+        };
+    ParallelUtilities::runOnEachFunctionWithUniqueAllocId(
+        BC, ParallelUtilities::SchedulingPolicy::SP_INST_QUADRATIC,
+        WorkFunction, SkipPredicate, "remove-loads");
+  }
+
+  if (opts::RemoveStores) {
+    NamedRegionTimer T1("removestores", "remove stores", "FOP",
+                        "FOP breakdown", opts::TimeOpts);
+    ParallelUtilities::WorkFuncWithAllocTy WorkFunction =
+        [&](BinaryFunction &BF, MCPlusBuilder::AllocatorIdTy AllocatorId) {
+          removeUnusedStores(FA, BC, BF, AllocatorId);
+        };
+    ParallelUtilities::runOnEachFunctionWithUniqueAllocId(
+        BC, ParallelUtilities::SchedulingPolicy::SP_INST_QUADRATIC,
+        WorkFunction, SkipPredicate, "remove-stores");
+  }
+}
+
 void FrameOptimizerPass::performShrinkWrapping(const RegAnalysis &RA,
                                                const FrameAnalysis &FA,
                                                BinaryContext &BC) {
@@ -12,6 +12,7 @@
 #define LLVM_TOOLS_LLVM_BOLT_PASSES_FRAMEOPTIMIZER_H
 
 #include "BinaryPasses.h"
+#include <atomic>
 
 namespace llvm {
 namespace bolt {
@@ -77,11 +78,11 @@ class RegAnalysis;
 ///
 class FrameOptimizerPass : public BinaryFunctionPass {
   /// Stats aggregating variables
-  uint64_t NumRedundantLoads{0};
-  uint64_t NumRedundantStores{0};
-  uint64_t NumLoadsChangedToReg{0};
-  uint64_t NumLoadsChangedToImm{0};
-  uint64_t NumLoadsDeleted{0};
+  std::atomic<uint64_t> NumRedundantLoads{0};
+  std::atomic<uint64_t> NumRedundantStores{0};
+  std::atomic<uint64_t> NumLoadsChangedToReg{0};
+  std::atomic<uint64_t> NumLoadsChangedToImm{0};
+  std::atomic<uint64_t> NumLoadsDeleted{0};
 
   DenseSet<const BinaryFunction *> FuncsChanged;
 
@@ -93,12 +94,18 @@ class FrameOptimizerPass : public BinaryFunctionPass {
   void removeUnnecessaryLoads(const RegAnalysis &RA,
                               const FrameAnalysis &FA,
                               const BinaryContext &BC,
-                              BinaryFunction &BF);
+                              BinaryFunction &BF,
+                              MCPlusBuilder::AllocatorIdTy AllocId = 0);
 
   /// Use information from stack frame usage to delete unused stores.
   void removeUnusedStores(const FrameAnalysis &FA,
                           const BinaryContext &BC,
-                          BinaryFunction &BF);
+                          BinaryFunction &BF,
+                          MCPlusBuilder::AllocatorIdTy AllocId = 0);
+
+  /// Run the caller-saved register optimizations on all functions in parallel.
+  void performFrameAccessRemoval(const RegAnalysis &RA,
+                                 const FrameAnalysis &FA, BinaryContext &BC);
 
   /// Perform shrinkwrapping step
   void performShrinkWrapping(const RegAnalysis &RA, const FrameAnalysis &FA,
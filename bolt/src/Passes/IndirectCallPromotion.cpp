@@ -133,6 +133,16 @@ EliminateLoads(
     cl::ZeroOrMore,
     cl::cat(BoltOptCategory));
 
+static cl::opt<bool>
+ICPStaticVtables(
+    "icp-static-vtables",
+    cl::desc("when eliminating method loads, find vtables of targets without "
+             "memory profile in vtable symbols of the binary if the target "
+             "occupies a unique vtable slot for the call"),
+    cl::init(false),
+    cl::ZeroOrMore,
+    cl::cat(BoltOptCategory));
+
 static cl::opt<unsigned>
 ICPTopCallsites(
     "icp-top-callsites",
@@ -674,14 +684,34 @@ IndirectCallPromotion::findCallTargetSymbols(
   return SymTargets;
 }
 
+void IndirectCallPromotion::buildMethodToVtableSlots(BinaryContext &BC) {
+  const unsigned PtrSize = BC.AsmInfo->getCodePointerSize();
+  for (const std::pair<const uint64_t, BinaryData *> &BDI :
+       BC.getBinaryData()) {
+    const BinaryData *BD = BDI.second;
+    if (!BD->nameStartsWith("_ZTV"))
+      continue;
+
+    for (uint64_t Slot = BD->getAddress();
+         Slot + PtrSize <= BD->getEndAddress(); Slot += PtrSize) {
+      ErrorOr<uint64_t> MethodAddr = BC.getPointerAtAddress(Slot);
+      if (!MethodAddr || !BC.getBinaryFunctionAtAddress(*MethodAddr))
+        continue;
+      MethodToVtableSlots[*MethodAddr].push_back(Slot);
+    }
+  }
+}
+
 IndirectCallPromotion::MethodInfoType
 IndirectCallPromotion::maybeGetVtableSyms(
    BinaryContext &BC,
    BinaryFunction &Function,
    BinaryBasicBlock *BB,
    MCInst &Inst,
-   const SymTargetsType &SymTargets
+   const SymTargetsType &SymTargets,
+   bool &FromVtableSymbols
 ) const {
+  FromVtableSymbols = false;
   std::vector<std::pair<MCSymbol *, uint64_t>> VtableSyms;
   std::vector<MCInst *> MethodFetchInsns;
   unsigned VtableReg, MethodReg;
@@ -690,7 +720,8 @@ IndirectCallPromotion::maybeGetVtableSyms(
   assert(!Function.getJumpTable(Inst) &&
          "Can't get vtable addrs for jump tables.");
 
-  if (!Function.hasMemoryProfile() || !opts::EliminateLoads)
+  if (!opts::EliminateLoads ||
+      (!Function.hasMemoryProfile() && !opts::ICPStaticVtables))
     return MethodInfoType();
 
   MutableArrayRef<MCInst> Insts(&BB->front(), &Inst + 1);
@@ -721,21 +752,36 @@ IndirectCallPromotion::maybeGetVtableSyms(
     }
   });
 
+  // Find the vtable that each method belongs to.
+  std::map<const MCSymbol *, uint64_t> MethodToVtable;
+
   // Try to get value profiling data for the method load instruction.
   auto ErrorOrMemAccesssProfile =
     BC.MIB->tryGetAnnotationAs<MemoryAccessProfile>(*MethodFetchInsns.back(),
                                                     "MemoryAccessProfile");
-  if (!ErrorOrMemAccesssProfile) {
+  if (!ErrorOrMemAccesssProfile && opts::ICPStaticVtables) {
+    // Without the profile, a vtable is known only if it is the only one that
+    // holds the target at the offset used by the call. The guard is correct
+    // either way, as other vtables take the fallback path.
+    for (const std::pair<MCSymbol *, uint64_t> &Target : SymTargets) {
+      const BinaryFunction *Method = BC.getFunctionForSymbol(Target.first);
+      if (!Method)
+        continue;
+      auto SlotsI = MethodToVtableSlots.find(Method->getAddress());
+      if (SlotsI == MethodToVtableSlots.end() || SlotsI->second.size() != 1)
+        continue;
+      MethodToVtable[Target.first] = SlotsI->second.front() - MethodOffset;
+    }
+  } else if (!ErrorOrMemAccesssProfile) {
     DEBUG_VERBOSE(1,
                   dbgs() << "BOLT-INFO: ICP no memory profiling data found\n");
     return MethodInfoType();
   }
-  MemoryAccessProfile &MemAccessProfile = ErrorOrMemAccesssProfile.get();
 
-  // Find the vtable that each method belongs to.
-  std::map<const MCSymbol *, uint64_t> MethodToVtable;
-
-  for (const AddressAccess &AccessInfo : MemAccessProfile.AddressAccessInfo) {
+  ArrayRef<AddressAccess> AddressAccessInfo;
+  if (ErrorOrMemAccesssProfile)
+    AddressAccessInfo = ErrorOrMemAccesssProfile.get().AddressAccessInfo;
+  for (const AddressAccess &AccessInfo : AddressAccessInfo) {
     uint64_t Address = AccessInfo.Offset;
     if (AccessInfo.MemoryObject) {
       Address += AccessInfo.MemoryObject->getAddress();
@@ -794,6 +840,8 @@ IndirectCallPromotion::maybeGetVtableSyms(
     }
   }
 
+  FromVtableSymbols = !ErrorOrMemAccesssProfile;
+
   return MethodInfoType(VtableSyms, MethodFetchInsns);
 }
 
@@ -1203,6 +1251,9 @@ void IndirectCallPromotion::runOnFunctions(BinaryContext &BC) {
     (opts::IndirectCallPromotion == ICP_JUMP_TABLES ||
      opts::IndirectCallPromotion == ICP_ALL);
 
+  if (OptimizeCalls && opts::EliminateLoads && opts::ICPStaticVtables)
+    buildMethodToVtableSlots(BC);
+
   std::unique_ptr<RegAnalysis> RA;
   std::unique_ptr<BinaryFunctionCallGraph> CG;
   if (OptimizeJumpTables) {
@@ -1417,12 +1468,16 @@ void IndirectCallPromotion::runOnFunctions(BinaryContext &BC) {
         MethodInfoType MethodInfo;
 
         if (!IsJumpTable) {
+          bool FromVtableSymbols;
           MethodInfo = maybeGetVtableSyms(BC,
                                           Function,
                                           BB,
                                           Inst,
-                                          SymTargets);
+                                          SymTargets,
+                                          FromVtableSymbols);
           TotalMethodLoadsEliminated += MethodInfo.first.empty() ? 0 : 1;
+          if (FromVtableSymbols)
+            ++TotalStaticVtableMethodCalls;
           LLVM_DEBUG(dbgs()
                      << "BOLT-INFO: ICP "
                      << (!MethodInfo.first.empty() ? "found" : "did not find")
@@ -1531,6 +1586,10 @@ void IndirectCallPromotion::runOnFunctions(BinaryContext &BC) {
          << format("%.1f", (100.0 * TotalMethodLoadsEliminated) /
                    std::max<uint64_t>(TotalMethodLoadEliminationCandidates, 1))
          << "%\n"
+         << "BOLT-INFO: ICP number of method calls with vtables found in "
+            "vtable symbols = "
+         << TotalStaticVtableMethodCalls
+         << "\n"
          << "BOLT-INFO: ICP percentage of indirect branches that are "
             "optimized = "
          << format("%.1f", (100.0 * TotalNumFrequentJmps) /
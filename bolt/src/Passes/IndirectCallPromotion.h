@@ -14,6 +14,7 @@
 #define LLVM_TOOLS_LLVM_BOLT_PASSES_INDIRECT_CALL_PROMOTION_H
 
 #include "BinaryPasses.h"
+#include <atomic>
 
 namespace llvm {
 namespace bolt {
@@ -159,6 +160,14 @@ class IndirectCallPromotion : public BinaryFunctionPass {
   // Total number of method callsites that had loads eliminated.
   uint64_t TotalMethodLoadsEliminated{0};
 
+  // Total number of method calls with vtables found in vtable symbols of the
+  // binary rather than in the memory profile.
+  std::atomic<uint64_t> TotalStaticVtableMethodCalls{0};
+
+  /// Map of a virtual method address to the addresses of vtable slots holding
+  /// it. Built from vtable symbols of the binary with -icp-static-vtables.
+  std::unordered_map<uint64_t, std::vector<uint64_t>> MethodToVtableSlots;
+
   // Total number of jump table callsites that are optimized by ICP.
   uint64_t TotalOptimizedJumpTableCallsites{0};
 
@@ -210,11 +219,17 @@ class IndirectCallPromotion : public BinaryFunctionPass {
                                        MCInst &Inst,
                                        MCInst *&TargetFetchInst) const;
 
+  void buildMethodToVtableSlots(BinaryContext &BC);
+
+  /// Find vtables of the targets of the method call \p Inst. Set
+  /// \p FromVtableSymbols if they were found in vtable symbols of the binary
+  /// rather than in the memory profile.
   MethodInfoType maybeGetVtableSyms(BinaryContext &BC,
                                     BinaryFunction &Function,
                                     BinaryBasicBlock *BB,
                                     MCInst &Inst,
-                                    const SymTargetsType &SymTargets) const;
+                                    const SymTargetsType &SymTargets,
+                                    bool &FromVtableSymbols) const;
 
   std::vector<std::unique_ptr<BinaryBasicBlock>>
   rewriteCall(BinaryContext &BC,
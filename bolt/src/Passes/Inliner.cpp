@@ -10,7 +10,8 @@
 // (see Inliner::getInliningInfo() for the most up-to-date details):
 //
 //  * No exception handling
-//  * No jump tables
+//  * No jump tables, unless inlining hot call sites (-inline-hot) on x86 in
+//    relocation mode with jump tables moved (-jump-tables=move or higher)
 //  * Single entry point
 //  * CFI update not supported - breaks unwinding
 //  * Regular Call Sites:
@@ -26,6 +27,7 @@
 #include "MCPlus.h"
 #include "llvm/Support/CommandLine.h"
 #include <map>
+#include <numeric>
 
 #define DEBUG_TYPE "bolt-inliner"
 
@@ -35,6 +37,8 @@ namespace opts {
 
 extern cl::OptionCategory BoltOptCategory;
 
+extern cl::opt<bolt::JumpTableSupportLevel> JumpTables;
+
 static cl::opt<bool>
 AdjustProfile("inline-ap",
   cl::desc("adjust function profile after inlining"),
@@ -56,6 +60,31 @@ InlineAll("inline-all",
   cl::ZeroOrMore,
   cl::cat(BoltOptCategory));
 
+static cl::opt<bool>
+InlineHot("inline-hot",
+  cl::desc("inline hot call sites in the order of decreasing benefit, i.e. "
+           "call count per byte of code growth, within a code growth budget"),
+  cl::init(false),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+InlineHotBudget("inline-hot-budget",
+  cl::desc("code growth budget for -inline-hot in percent of the total size "
+           "of functions"),
+  cl::init(1),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+InlineHotMinCount("inline-hot-min-count",
+  cl::desc("minimum execution count of a call site to be inlined with "
+           "-inline-hot"),
+  cl::init(1),
+  cl::ZeroOrMore,
+  cl::Hidden,
+  cl::cat(BoltOptCategory));
+
 static cl::opt<bool>
 InlineIgnoreLeafCFI("inline-ignore-leaf-cfi",
   cl::desc("inline leaf functions with CFI programs (can break unwinding)"),
@@ -119,6 +148,7 @@ bool inliningEnabled() {
   return !NoInline &&
     (InlineAll ||
      InlineSmallFunctions ||
+     InlineHot ||
      !ForceInlineFunctions.empty());
 }
 
@@ -188,8 +218,20 @@ Inliner::InliningInfo Inliner::getInliningInfo(const BinaryFunction &BF) const {
     if (BF.isMultiEntry())
       return INL_NONE;
 
-    if (BF.hasJumpTables())
-      return INL_NONE;
+    // Jump tables of the callee are duplicated for every inlined instance.
+    // The copies have to be emitted separately from the original tables, and
+    // all their entries must point to basic blocks of the callee.
+    if (BF.hasJumpTables()) {
+      if (!opts::InlineHot || !BC.isX86() || !BC.HasRelocations ||
+          opts::JumpTables == JTS_BASIC)
+        return INL_NONE;
+
+      for (const std::pair<const uint64_t, JumpTable *> &JTI :
+           BF.jumpTables())
+        for (const MCSymbol *Entry : JTI.second->Entries)
+          if (!BF.getBasicBlockForLabel(Entry))
+            return INL_NONE;
+    }
 
     const MCPhysReg SPReg = BC.MIB->getStackPointer();
     for (const BinaryBasicBlock *BB : BF.layout()) {
@@ -270,7 +312,7 @@ Inliner::inlineCall(BinaryBasicBlock &CallerBB,
   assert(MIB.isCall(*CallInst) && "can only inline a call or a tail call");
   assert(!Callee.isMultiEntry() &&
          "cannot inline function with multiple entries");
-  assert(!Callee.hasJumpTables() &&
+  assert((!Callee.hasJumpTables() || opts::JumpTables != JTS_BASIC) &&
          "cannot inline function with jump table(s)");
 
   // Get information about the call site.
@@ -313,6 +355,7 @@ Inliner::inlineCall(BinaryBasicBlock &CallerBB,
   // Save execution count of the first block as we don't want it to change
   // later due to profile adjustment rounding errors.
   const uint64_t FirstInlinedBBCount = FirstInlinedBB->getKnownExecutionCount();
+  CallerFunction.addInlinedCallCount(FirstInlinedBBCount);
 
   // Copy basic blocks and maintain a map from their origin.
   std::unordered_map<const BinaryBasicBlock *, BinaryBasicBlock *> InlinedBBMap;
@@ -328,6 +371,40 @@ Inliner::inlineCall(BinaryBasicBlock &CallerBB,
     }
   }
 
+  // Duplicate jump tables of the callee for the inlined instance and point
+  // their entries to the inlined blocks. Map labels and IDs of the original
+  // tables to the labels and IDs of the copies. Instructions reference a
+  // table from the input by its address plus the offset of the label, and a
+  // duplicated table, e.g. one inlined into the callee earlier, by its ID.
+  std::unordered_map<const MCSymbol *, const MCSymbol *> JTLabelMap;
+  std::unordered_map<uint64_t, uint64_t> JTIDMap;
+  for (const std::pair<const uint64_t, JumpTable *> &JTI :
+       Callee.jumpTables()) {
+    JumpTable *JT = JTI.second;
+    for (const std::pair<const unsigned, MCSymbol *> &Label : JT->Labels) {
+      uint64_t NewJTID;
+      const MCSymbol *NewJTLabel;
+      std::tie(NewJTID, NewJTLabel) =
+          BC.duplicateJumpTable(CallerFunction, JT, Label.second);
+      JTLabelMap[Label.second] = NewJTLabel;
+      const uint64_t JTID =
+          JTI.first == JT->getAddress() ? JTI.first + Label.first : JTI.first;
+      JTIDMap[JTID] = NewJTID;
+
+      for (const std::pair<const uint64_t, JumpTable *> &NewJTI :
+           CallerFunction.jumpTables()) {
+        if (NewJTI.first != NewJTID)
+          continue;
+        for (MCSymbol *&Entry : NewJTI.second->Entries) {
+          const BinaryBasicBlock *TargetBB =
+              Callee.getBasicBlockForLabel(Entry);
+          assert(TargetBB && "jump table entry is not a basic block");
+          Entry = InlinedBBMap.at(TargetBB)->getLabel();
+        }
+      }
+    }
+  }
+
   // Copy over instructions and edges.
   for (const BinaryBasicBlock &BB : Callee) {
     BinaryBasicBlock *InlinedBB = InlinedBBMap[&BB];
@@ -340,15 +417,33 @@ Inliner::inlineCall(BinaryBasicBlock &CallerBB,
       if (MIB.isPseudo(Inst))
         continue;
 
+      const uint64_t JTID = MIB.getJumpTable(Inst);
+      const uint16_t JTIndexReg = JTID ? MIB.getJumpTableIndexReg(Inst) : 0;
+
       MIB.stripAnnotations(Inst, /*KeepTC=*/BC.isX86());
 
+      // Use copies of jump tables in the inlined instance.
+      if (JTID) {
+        auto JTI = JTIDMap.find(JTID);
+        assert(JTI != JTIDMap.end() && "jump table was not duplicated");
+        MIB.setJumpTable(Inst, JTI->second, JTIndexReg);
+      }
+      if (!JTLabelMap.empty()) {
+        for (unsigned I = 0; I < MCPlus::getNumPrimeOperands(Inst); ++I) {
+          auto LI = JTLabelMap.find(MIB.getTargetSymbol(Inst, I));
+          if (LI != JTLabelMap.end())
+            Inst.getOperand(I) = MCOperand::createExpr(
+                MCSymbolRefExpr::create(LI->second, *BC.Ctx));
+        }
+      }
+
       // Fix branch target. Strictly speaking, we don't have to do this as
       // targets of direct branches will be fixed later and don't matter
       // in the CFG state. However, disassembly may look misleading, and
       // hence we do the fixing.
-      if (MIB.isBranch(Inst)) {
-        assert(!MIB.isIndirectBranch(Inst) &&
-               "unexpected indirect branch in callee");
+      assert((!MIB.isIndirectBranch(Inst) || JTID) &&
+             "unexpected indirect branch in callee");
+      if (MIB.isBranch(Inst) && !MIB.isIndirectBranch(Inst)) {
         const BinaryBasicBlock *TargetBB =
             Callee.getBasicBlockForLabel(MIB.getTargetSymbol(Inst));
         assert(TargetBB && "cannot find target block in callee");
@@ -538,6 +633,155 @@ bool Inliner::inlineCallsInFunction(BinaryFunction &Function) {
   return DidInlining;
 }
 
+void Inliner::inlineHotCallSites(BinaryContext &BC, uint64_t TotalSize) {
+  struct CallSite {
+    BinaryFunction *Caller;
+    BinaryBasicBlock *BB;
+    size_t Index;
+    BinaryFunction *Callee;
+    uint64_t Count;
+    int64_t SizeAfterInlining;
+  };
+
+  InliningCandidates.clear();
+  findInliningCandidates(BC);
+
+  // Collect direct calls executed at least InlineHotMinCount times. Sites are
+  // collected in a deterministic order: by caller address, then by position
+  // in the caller.
+  std::vector<CallSite> CallSites;
+  for (auto &BFI : BC.getBinaryFunctions()) {
+    BinaryFunction &Function = BFI.second;
+    if (!shouldOptimize(Function) || !Function.hasValidProfile())
+      continue;
+
+    for (BinaryBasicBlock &BB : Function) {
+      const uint64_t Count = BB.getKnownExecutionCount();
+      if (!Count || Count < opts::InlineHotMinCount)
+        continue;
+
+      for (size_t Index = 0; Index < BB.size(); ++Index) {
+        const MCInst &Inst = BB.getInstructionAtIndex(Index);
+        if (!BC.MIB->isCall(Inst) || MCPlus::getNumPrimeOperands(Inst) != 1 ||
+            !Inst.getOperand(0).isExpr())
+          continue;
+
+        uint64_t EntryID = 0;
+        BinaryFunction *Callee =
+            BC.getFunctionForSymbol(BC.MIB->getTargetSymbol(Inst), &EntryID);
+        if (!Callee || EntryID != 0 || Callee == &Function)
+          continue;
+
+        auto IInfo = InliningCandidates.find(Callee);
+        if (IInfo == InliningCandidates.end())
+          continue;
+
+        const bool IsTailCall = BC.MIB->isTailCall(Inst);
+        if (!IsTailCall && IInfo->second.Type == INL_TAILCALL)
+          continue;
+
+        const int64_t SizeAfterInlining =
+            IsTailCall ? IInfo->second.SizeAfterTailCallInlining -
+                             getSizeOfTailCallInst(BC)
+                       : IInfo->second.SizeAfterInlining -
+                             getSizeOfCallInst(BC);
+
+        CallSites.push_back(
+            {&Function, &BB, Index, Callee, Count, SizeAfterInlining});
+      }
+    }
+  }
+
+  // Rank call sites by the number of calls eliminated per byte of code
+  // growth. Sites that do not grow the code come first.
+  std::vector<size_t> Order(CallSites.size());
+  std::iota(Order.begin(), Order.end(), 0);
+  std::stable_sort(Order.begin(), Order.end(), [&](size_t A, size_t B) {
+    const CallSite &CSA = CallSites[A];
+    const CallSite &CSB = CallSites[B];
+    if ((CSA.SizeAfterInlining <= 0) != (CSB.SizeAfterInlining <= 0))
+      return CSA.SizeAfterInlining <= 0;
+    return (double)CSA.Count / std::max<int64_t>(CSA.SizeAfterInlining, 1) >
+           (double)CSB.Count / std::max<int64_t>(CSB.SizeAfterInlining, 1);
+  });
+
+  const uint64_t Budget = TotalSize * opts::InlineHotBudget / 100;
+  uint64_t Growth = 0;
+  std::vector<bool> Selected(CallSites.size(), false);
+  uint64_t NumSelected = 0;
+  for (size_t I : Order) {
+    if (opts::InlineLimit && NumSelected >= opts::InlineLimit)
+      break;
+    const CallSite &CS = CallSites[I];
+    if (CS.SizeAfterInlining > 0) {
+      if (Growth + CS.SizeAfterInlining > Budget)
+        continue;
+      Growth += CS.SizeAfterInlining;
+    }
+    Selected[I] = true;
+    ++NumSelected;
+  }
+
+  // Inline selected sites in the reverse order of collection, so that the
+  // indices of the remaining sites in the same block stay valid.
+  for (size_t I = CallSites.size(); I-- > 0; ) {
+    if (!Selected[I])
+      continue;
+
+    CallSite &CS = CallSites[I];
+    auto IInfo = InliningCandidates.find(CS.Callee);
+    auto CallInst = CS.BB->begin() + CS.Index;
+    const bool IsTailCall = BC.MIB->isTailCall(*CallInst);
+
+    // If code was inlined into the callee, its size has changed and it could
+    // have become a tail-call-only candidate. Charge the budget with the
+    // current size.
+    if (Modified.count(CS.Callee)) {
+      IInfo->second = getInliningInfo(*CS.Callee);
+      Growth -= std::max<int64_t>(CS.SizeAfterInlining, 0);
+      CS.SizeAfterInlining =
+          IsTailCall ? IInfo->second.SizeAfterTailCallInlining -
+                           getSizeOfTailCallInst(BC)
+                     : IInfo->second.SizeAfterInlining - getSizeOfCallInst(BC);
+      Growth += std::max<int64_t>(CS.SizeAfterInlining, 0);
+    }
+
+    if (IInfo->second.Type == INL_NONE ||
+        (!IsTailCall && IInfo->second.Type == INL_TAILCALL) ||
+        Growth > Budget) {
+      Growth -= std::max<int64_t>(CS.SizeAfterInlining, 0);
+      --NumSelected;
+      continue;
+    }
+
+    LLVM_DEBUG(dbgs() << "BOLT-DEBUG: inlining hot call to " << *CS.Callee
+                      << " in " << *CS.Caller << " : " << CS.BB->getName()
+                      << ". Count: " << CS.Count << ". Size change: "
+                      << CS.SizeAfterInlining << " bytes.\n");
+
+    inlineCall(*CS.BB, CallInst, *CS.Callee);
+    Modified.insert(CS.Caller);
+
+    TotalInlinedBytes += CS.SizeAfterInlining;
+    ++NumInlinedCallSites;
+    NumInlinedDynamicCalls += CS.Count;
+
+    if (opts::AdjustProfile)
+      CS.Callee->adjustExecutionCount(CS.Count);
+
+    if (IInfo->second.Type == INL_TAILCALL) {
+      auto CallerIInfo = InliningCandidates.find(CS.Caller);
+      if (CallerIInfo != InliningCandidates.end() &&
+          CallerIInfo->second.Type == INL_ANY)
+        CallerIInfo->second.Type = INL_TAILCALL;
+    }
+  }
+
+  outs() << "BOLT-INFO: hot inlining used " << Growth << " of " << Budget
+         << " bytes of code growth budget for " << NumSelected << " out of "
+         << CallSites.size() << " eligible call sites\n";
+}
+
 void Inliner::runOnFunctions(BinaryContext &BC) {
   opts::syncOptions();
 
@@ -548,42 +792,47 @@ void Inliner::runOnFunctions(BinaryContext &BC) {
   for (auto &BFI : BC.getBinaryFunctions())
     TotalSize += BFI.second.getSize();
 
-  bool InlinedOnce;
   unsigned NumIters = 0;
-  do {
-    if (opts::InlineLimit && NumInlinedCallSites >= opts::InlineLimit)
-      break;
+  if (opts::InlineHot) {
+    inlineHotCallSites(BC, TotalSize);
+    NumIters = 1;
+  } else {
+    bool InlinedOnce;
+    do {
+      if (opts::InlineLimit && NumInlinedCallSites >= opts::InlineLimit)
+        break;
 
-    InlinedOnce = false;
+      InlinedOnce = false;
 
-    InliningCandidates.clear();
-    findInliningCandidates(BC);
+      InliningCandidates.clear();
+      findInliningCandidates(BC);
 
-    std::vector<BinaryFunction *> ConsideredFunctions;
-    for (auto &BFI : BC.getBinaryFunctions()) {
-      BinaryFunction &Function = BFI.second;
-      if (!shouldOptimize(Function))
-        continue;
-      ConsideredFunctions.push_back(&Function);
-    }
-    std::sort(ConsideredFunctions.begin(), ConsideredFunctions.end(),
-        [](const BinaryFunction *A, const BinaryFunction *B) {
-        return B->getKnownExecutionCount() < A->getKnownExecutionCount();
-    });
-    for (BinaryFunction *Function : ConsideredFunctions) {
-      if (opts::InlineLimit && NumInlinedCallSites >= opts::InlineLimit)
-        break;
+      std::vector<BinaryFunction *> ConsideredFunctions;
+      for (auto &BFI : BC.getBinaryFunctions()) {
+        BinaryFunction &Function = BFI.second;
+        if (!shouldOptimize(Function))
+          continue;
+        ConsideredFunctions.push_back(&Function);
+      }
+      std::sort(ConsideredFunctions.begin(), ConsideredFunctions.end(),
+          [](const BinaryFunction *A, const BinaryFunction *B) {
+          return B->getKnownExecutionCount() < A->getKnownExecutionCount();
+      });
+      for (BinaryFunction *Function : ConsideredFunctions) {
+        if (opts::InlineLimit && NumInlinedCallSites >= opts::InlineLimit)
+          break;
 
-      const bool DidInline = inlineCallsInFunction(*Function);
+        const bool DidInline = inlineCallsInFunction(*Function);
 
-      if (DidInline)
-        Modified.insert(Function);
+        if (DidInline)
+          Modified.insert(Function);
 
-      InlinedOnce |= DidInline;
-    }
+        InlinedOnce |= DidInline;
+      }
 
-    ++NumIters;
-  } while (InlinedOnce && NumIters < opts::InlineMaxIters);
+      ++NumIters;
+    } while (InlinedOnce && NumIters < opts::InlineMaxIters);
+  }
 
   if (NumInlinedCallSites) {
     outs() << "BOLT-INFO: inlined " << NumInlinedDynamicCalls << " calls at "
@@ -69,6 +69,11 @@ private:
 
   bool inlineCallsInFunction(BinaryFunction &Function);
 
+  /// Inline profiled call sites across all functions in the order of
+  /// decreasing execution count per byte of code growth, until the growth
+  /// reaches -inline-hot-budget percent of \p TotalSize.
+  void inlineHotCallSites(BinaryContext &BC, uint64_t TotalSize);
+
   /// Inline a function call \p CallInst to function \p Callee.
   ///
   /// Return the location (basic block and instruction iterator) where the code
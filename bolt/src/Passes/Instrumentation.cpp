@@ -79,6 +79,13 @@ cl::opt<bool> InstrumentCalls("instrument-calls",
                                        "control flow activity (default: true)"),
                               cl::init(true), cl::Optional,
                               cl::cat(BoltInstrCategory));
+
+cl::opt<bool> InstrumentMemOpSizes(
+    "instrument-memop-sizes",
+    cl::desc("record sizes passed to memcpy(), memset() and memcmp() calls "
+             "into <instrumentation-file>.memop, to be used with "
+             "-memop-size-profile (default: false)"),
+    cl::init(false), cl::Optional, cl::cat(BoltInstrCategory));
 }
 
 namespace llvm {
@@ -206,6 +213,23 @@ insertInstructions(std::vector<MCInst>& Instrs,
   return Iter;
 }
 
+// Return true if \p Inst is a regular call to memcpy(), memset() or memcmp().
+bool isMemOpCall(const BinaryContext &BC, const MCInst &Inst) {
+  if (!BC.MIB->isCall(Inst) || BC.MIB->isTailCall(Inst) ||
+      MCPlus::getNumPrimeOperands(Inst) != 1 || !Inst.getOperand(0).isExpr())
+    return false;
+
+  const MCSymbol *Target = BC.MIB->getTargetSymbol(Inst);
+  if (!Target)
+    return false;
+
+  const StringRef Name = Target->getName();
+  for (StringRef MemOp : {"memcpy", "memset", "memcmp"})
+    if (Name == MemOp || Name == (MemOp + "@PLT").str())
+      return true;
+  return false;
+}
+
 }
 
 void Instrumentation::instrumentLeafNode(BinaryContext &BC,
@@ -219,6 +243,35 @@ void Instrumentation::instrumentLeafNode(BinaryContext &BC,
   insertInstructions(CounterInstrs, BB, Iter);
 }
 
+void Instrumentation::instrumentMemOpSize(BinaryBasicBlock &BB,
+                                          BinaryBasicBlock::iterator &Iter,
+                                          BinaryFunction &FromFunction,
+                                          uint32_t From) {
+  BinaryContext &BC = FromFunction.getBinaryContext();
+  std::vector<MCInst> CounterInstrs;
+  {
+    auto L = BC.scopeLock();
+    MCSymbol *Label = BC.Ctx->createNamedTempSymbol("InstrMemOpSizes");
+    MemOpSiteDescription MSD;
+    MSD.Address = FromFunction.getAddress() + From;
+    MSD.Counter = Summary->Counters.size();
+    Summary->MemOpSiteDescriptions.emplace_back(MSD);
+    Summary->Counters.emplace_back(Label);
+    Summary->Counters.resize(Summary->Counters.size() +
+                             InstrumentationSummary::NUM_MEMOP_SIZE_COUNTERS -
+                             1);
+    MemOpSizeCounters += InstrumentationSummary::NUM_MEMOP_SIZE_COUNTERS;
+
+    CounterInstrs = BC.MIB->createInstrSizeCounterIncrement(
+        BC.MIB->getIntArgRegister(2),
+        InstrumentationSummary::NUM_MEMOP_SIZE_COUNTERS - 1, Label,
+        BC.Ctx.get());
+  }
+
+  // Leave Iter pointing to the call.
+  Iter = insertInstructions(CounterInstrs, BB, Iter);
+}
+
 void Instrumentation::instrumentIndirectTarget(BinaryBasicBlock &BB,
                                                BinaryBasicBlock::iterator &Iter,
                                                BinaryFunction &FromFunction,
@@ -390,6 +443,11 @@ void Instrumentation::instrumentFunction(BinaryContext &BC,
     bool IsInvokeBlock = InvokeBlocks.count(&BB) > 0;
 
     for (auto I = BB.begin(); I != BB.end(); ++I) {
+      if (opts::InstrumentMemOpSizes && isMemOpCall(BC, *I) &&
+          BC.MIB->hasAnnotation(*I, "Offset"))
+        instrumentMemOpSize(BB, I, Function,
+                            BC.MIB->getAnnotationAs<uint32_t>(*I, "Offset"));
+
       const MCInst &Inst = *I;
       if (!BC.MIB->hasAnnotation(Inst, "Offset"))
         continue;
@@ -701,6 +759,10 @@ void Instrumentation::setupRuntimeLibrary(BinaryContext &BC) {
          << LeafNodeCounters << "\n";
   outs() << "BOLT-INSTRUMENTER: Number of direct call counters: "
          << DirectCallCounters << "\n";
+  if (opts::InstrumentMemOpSizes)
+    outs() << "BOLT-INSTRUMENTER: Number of memop size counters: "
+           << MemOpSizeCounters << " for "
+           << Summary->MemOpSiteDescriptions.size() << " call sites\n";
   outs() << "BOLT-INSTRUMENTER: Total number of counters: "
          << Summary->Counters.size() << "\n";
   outs() << "BOLT-INSTRUMENTER: Total size of counters: "
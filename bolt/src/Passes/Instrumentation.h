@@ -98,6 +98,12 @@ private:
                                 BinaryBasicBlock::iterator &Iter,
                                 BinaryFunction &FromFunction, uint32_t From);
 
+  /// Insert a counter of the size argument in front of the call to memcpy(),
+  /// memset() or memcmp() in \p Iter, at offset \p From in \p FromFunction.
+  void instrumentMemOpSize(BinaryBasicBlock &BB,
+                           BinaryBasicBlock::iterator &Iter,
+                           BinaryFunction &FromFunction, uint32_t From);
+
   void createAuxiliaryFunctions(BinaryContext &BC);
 
   uint32_t getFDSize() const;
@@ -119,6 +125,7 @@ private:
   uint32_t DirectCallCounters{0};
   uint32_t BranchCounters{0};
   uint32_t LeafNodeCounters{0};
+  uint32_t MemOpSizeCounters{0};
 
   /// Indirect call instrumentation functions
   BinaryFunction *IndCallHandlerExitBBFunction;
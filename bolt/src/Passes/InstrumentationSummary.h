@@ -85,6 +85,15 @@ struct EntryNode {
   uint64_t Address;
 };
 
+// Call site of memcpy(), memset() or memcmp() instrumented to record the size
+// argument. The site owns NUM_MEMOP_SIZE_COUNTERS consecutive counters
+// starting at Counter, one for each size below the last counter, which counts
+// all larger sizes. Address is the address of the call in the input binary.
+struct MemOpSiteDescription {
+  uint64_t Address;
+  uint64_t Counter;
+};
+
 // Base struct organizing all metadata pertaining to a single function
 struct FunctionDescription {
   const BinaryFunction *Function;
@@ -115,6 +124,11 @@ struct InstrumentationSummary {
   std::vector<IndCallDescription> IndCallDescriptions;
   std::vector<IndCallTargetDescription> IndCallTargetDescriptions;
 
+  /// Call sites with size counters
+  std::vector<MemOpSiteDescription> MemOpSiteDescriptions;
+
+  static constexpr uint64_t NUM_MEMOP_SIZE_COUNTERS = 129;
+
   static constexpr uint64_t NUM_SERIALIZED_CONTAINERS = 4;
   static constexpr uint64_t SERIALIZED_CONTAINER_SIZE =
       sizeof(uint32_t) * NUM_SERIALIZED_CONTAINERS;
@@ -0,0 +1,264 @@
+//===--- Passes/JCCErratumMitigation.cpp ----------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+//===----------------------------------------------------------------------===//
+
+#include "JCCErratumMitigation.h"
+#include "ParallelUtilities.h"
+#include "llvm/MC/MCAsmBackend.h"
+#include <unordered_map>
+
+#define DEBUG_TYPE "bolt-jcc-erratum"
+
+using namespace llvm;
+
+namespace opts {
+
+extern cl::opt<bool> AlignBlocks;
+extern cl::opt<bool> PreserveBlocksAlignment;
+
+} // namespace opts
+
+namespace llvm {
+namespace bolt {
+
+namespace {
+
+/// Branches crossing or ending on this boundary are not cached in the decoded
+/// uop cache on processors with the JCC erratum microcode update.
+constexpr uint64_t BoundarySize = 32;
+
+} // end anonymous namespace
+
+uint64_t JCCErratumMitigation::processFunction(BinaryFunction &BF,
+                                               const MCCodeEmitter *Emitter,
+                                               bool Fix, uint64_t &NumBranches,
+                                               uint64_t &Count) {
+  const BinaryContext &BC = BF.getBinaryContext();
+
+  std::vector<BinaryBasicBlock *> Blocks;
+  std::unordered_map<const BinaryBasicBlock *, size_t> BlockIndex;
+  for (BinaryBasicBlock *BB : BF.layout()) {
+    if (BB->isCold())
+      break;
+    BlockIndex[BB] = Blocks.size();
+    Blocks.push_back(BB);
+  }
+
+  // Branches are emitted in the short form and relaxed by the assembler if
+  // the target is out of range. Targets outside of the hot fragment are in
+  // another section and always use the long form.
+  struct ShortBranchInfo {
+    size_t BlockIdx;
+    size_t Index;
+    size_t TargetIdx;
+    uint64_t RelaxedSize;
+  };
+  std::vector<ShortBranchInfo> ShortBranches;
+  std::vector<std::vector<uint64_t>> InstSizes(Blocks.size());
+  for (size_t I = 0; I < Blocks.size(); ++I) {
+    const BinaryBasicBlock &BB = *Blocks[I];
+    InstSizes[I].resize(BB.size());
+    for (size_t Index = 0; Index < BB.size(); ++Index) {
+      const MCInst &Inst = BB.getInstructionAtIndex(Index);
+      if (BC.MIB->isPseudo(Inst))
+        continue;
+      InstSizes[I][Index] = BC.computeInstructionSize(Inst, Emitter);
+      if (!BC.MIB->isBranch(Inst) ||
+          !BC.MAB->mayNeedRelaxation(Inst, *BC.STI))
+        continue;
+
+      MCInst Relaxed = Inst;
+      BC.MAB->relaxInstruction(Relaxed, *BC.STI);
+      const uint64_t RelaxedSize = BC.computeInstructionSize(Relaxed, Emitter);
+      const BinaryBasicBlock *TargetBB =
+          BF.getBasicBlockForLabel(BC.MIB->getTargetSymbol(Inst));
+      auto TargetI = BlockIndex.find(TargetBB);
+      if (TargetI == BlockIndex.end())
+        InstSizes[I][Index] = RelaxedSize;
+      else
+        ShortBranches.push_back({I, Index, TargetI->second, RelaxedSize});
+    }
+  }
+
+  // Estimate the layout, growing branches until it converges. With Fix, the
+  // layout includes the padding to be inserted.
+  std::vector<uint64_t> BlockOffsets(Blocks.size());
+  std::vector<std::vector<uint64_t>> InstOffsets(Blocks.size());
+  std::vector<std::vector<std::pair<size_t, uint64_t>>> Affected(
+      Blocks.size());
+  bool Changed = true;
+  while (Changed) {
+    // In relocation mode, the function is assumed to start on a boundary.
+    // Otherwise, it is emitted at its original address.
+    uint64_t Offset = BC.HasRelocations ? 0 : BF.getAddress();
+    for (size_t I = 0; I < Blocks.size(); ++I) {
+      const BinaryBasicBlock &BB = *Blocks[I];
+      // Mimic the alignment emitted by BinaryEmitter.
+      if ((opts::AlignBlocks || opts::PreserveBlocksAlignment) &&
+          BB.getAlignment() > 1) {
+        const uint64_t BlockPadding =
+            alignTo(Offset, BB.getAlignment()) - Offset;
+        if (BlockPadding <= BB.getAlignmentMaxBytes())
+          Offset += BlockPadding;
+      }
+      BlockOffsets[I] = Offset;
+      Affected[I].clear();
+      Offset = layoutBlock(BB, Offset, InstSizes[I], Fix, &InstOffsets[I],
+                           &Affected[I]);
+    }
+
+    Changed = false;
+    for (ShortBranchInfo &SB : ShortBranches) {
+      uint64_t &Size = InstSizes[SB.BlockIdx][SB.Index];
+      if (Size == SB.RelaxedSize)
+        continue;
+      const int64_t Displacement =
+          BlockOffsets[SB.TargetIdx] -
+          (InstOffsets[SB.BlockIdx][SB.Index] + Size);
+      if (isInt<8>(Displacement))
+        continue;
+      LLVM_DEBUG(dbgs() << "BOLT-DEBUG: relaxing branch in " << BF
+                        << " with displacement " << Displacement << '\n');
+      Size = SB.RelaxedSize;
+      Changed = true;
+    }
+  }
+
+  uint64_t Padding = 0;
+  for (size_t I = 0; I < Blocks.size(); ++I) {
+    NumBranches += Affected[I].size();
+    Count += Affected[I].size() * Blocks[I]->getKnownExecutionCount();
+    if (!Fix)
+      continue;
+
+    // Move every affected branch, together with the first half of a fused
+    // pair, to the start of the next window. Insert in reverse order to keep
+    // the indices valid.
+    for (auto AI = Affected[I].rbegin(); AI != Affected[I].rend(); ++AI) {
+      auto InsertAt = Blocks[I]->begin() + AI->first;
+      for (MCInst &Nop : BC.MIB->createNoops(AI->second))
+        InsertAt = std::next(
+            Blocks[I]->insertInstruction(InsertAt, std::move(Nop)));
+      Padding += AI->second;
+    }
+  }
+
+  return Padding;
+}
+
+uint64_t JCCErratumMitigation::layoutBlock(
+    const BinaryBasicBlock &BB, uint64_t Offset, ArrayRef<uint64_t> InstSizes,
+    bool Pad, std::vector<uint64_t> *InstOffsets,
+    std::vector<std::pair<size_t, uint64_t>> *Affected) {
+  assert(InstSizes.size() == BB.size() && "expected size of every instruction");
+  const BinaryContext &BC = BB.getFunction()->getBinaryContext();
+  const bool IsHot = BB.getKnownExecutionCount();
+  if (InstOffsets)
+    InstOffsets->resize(BB.size());
+  // Index and offset of the previous non-pseudo instruction, the potential
+  // first instruction of a macro-fused pair.
+  size_t PrevIndex = BB.size();
+  uint64_t PrevOffset = Offset;
+  for (size_t Index = 0; Index < BB.size(); ++Index) {
+    const MCInst &Inst = BB.getInstructionAtIndex(Index);
+    if (InstOffsets)
+      (*InstOffsets)[Index] = Offset;
+    if (BC.MIB->isPseudo(Inst))
+      continue;
+
+    const MCInstrDesc &Desc = BC.MII->get(Inst.getOpcode());
+    if (IsHot && (Desc.isBranch() || Desc.isCall() || Desc.isReturn())) {
+      size_t StartIndex = Index;
+      uint64_t Start = Offset;
+      if (PrevIndex != BB.size() &&
+          BC.MIB->isMacroOpFusionPair(
+              {BB.getInstructionAtIndex(PrevIndex), Inst})) {
+        StartIndex = PrevIndex;
+        Start = PrevOffset;
+      }
+      if (Start / BoundarySize != (Offset + InstSizes[Index]) / BoundarySize) {
+        const uint64_t Padding = alignTo(Start, BoundarySize) - Start;
+        if (Affected)
+          Affected->emplace_back(StartIndex, Padding);
+        if (Pad) {
+          if (InstOffsets)
+            for (size_t I = StartIndex; I <= Index; ++I)
+              (*InstOffsets)[I] += Padding;
+          Offset += Padding;
+        }
+      }
+    }
+    PrevIndex = Index;
+    PrevOffset = Offset;
+    Offset += InstSizes[Index];
+  }
+  return Offset;
+}
+
+void JCCErratumMitigation::runOnFunctions(BinaryContext &BC) {
+  if (!BC.isX86())
+    return;
+
+  ParallelUtilities::WorkFuncTy WorkFun = [&](BinaryFunction &BF) {
+    // Create a separate MCCodeEmitter to allow lock free execution
+    BinaryContext::IndependentCodeEmitter Emitter =
+        BC.createIndependentMCCodeEmitter();
+
+    uint64_t NumBranches = 0;
+    uint64_t Count = 0;
+    processFunction(BF, Emitter.MCE.get(), /*Fix=*/false, NumBranches, Count);
+    NumBranchesBefore += NumBranches;
+    CountBefore += Count;
+    if (!NumBranches)
+      return;
+
+    const uint64_t Padding = processFunction(BF, Emitter.MCE.get(),
+                                             /*Fix=*/true, NumBranches, Count);
+    if (!Padding)
+      return;
+
+    PaddingBytes += Padding;
+    ++NumFunctionsPadded;
+
+    // Make sure the estimated offsets hold for the padded function.
+    if (BC.HasRelocations &&
+        (BF.getAlignment() < BoundarySize ||
+         BF.getMaxAlignmentBytes() < BF.getAlignment() - 1)) {
+      BF.setAlignment(BoundarySize);
+      BF.setMaxAlignmentBytes(BoundarySize - 1);
+    }
+
+    NumBranches = 0;
+    Count = 0;
+    processFunction(BF, Emitter.MCE.get(), /*Fix=*/false, NumBranches, Count);
+    NumBranchesAfter += NumBranches;
+    CountAfter += Count;
+  };
+
+  ParallelUtilities::PredicateTy SkipFunc = [&](const BinaryFunction &BF) {
+    // Functions are finalized at this point.
+    return !BF.isSimple() || !BF.hasCFG() || BF.isIgnored() ||
+           !BF.hasValidProfile();
+  };
+
+  ParallelUtilities::runOnEachFunction(
+      BC, ParallelUtilities::SchedulingPolicy::SP_INST_LINEAR, WorkFun,
+      SkipFunc, "JCCErratumMitigation");
+
+  outs() << "BOLT-INFO: JCC erratum: " << NumBranchesBefore
+         << " hot branches executed " << CountBefore
+         << " times cross or end on a " << BoundarySize << "-byte boundary\n";
+  outs() << "BOLT-INFO: JCC erratum: inserted " << PaddingBytes
+         << " bytes of padding in " << NumFunctionsPadded << " functions, "
+         << NumBranchesAfter << " hot branches executed " << CountAfter
+         << " times remain affected\n";
+}
+
+} // end namespace bolt
+} // end namespace llvm
@@ -0,0 +1,72 @@
+//===--- Passes/JCCErratumMitigation.h ------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// On processors affected by the Intel JCC erratum, the microcode update
+// prevents jumps that cross or end on a 32-byte boundary from being cached in
+// the decoded uop cache. This pass estimates the final layout of hot code and
+// inserts nops in front of affected hot branches (and macro-fused pairs) to
+// move them past the boundary. This is an alternative to the assembler-level
+// mitigation (-x86-branches-within-32B-boundaries) that only touches hot code
+// and reports the number of affected branches.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TOOLS_LLVM_BOLT_PASSES_JCC_ERRATUM_MITIGATION_H
+#define LLVM_TOOLS_LLVM_BOLT_PASSES_JCC_ERRATUM_MITIGATION_H
+
+#include "BinaryPasses.h"
+#include <atomic>
+
+namespace llvm {
+namespace bolt {
+
+class JCCErratumMitigation : public BinaryFunctionPass {
+  /// Stats: number and execution count of hot branches crossing or ending on
+  /// a boundary before and after the pass.
+  std::atomic<uint64_t> NumBranchesBefore{0};
+  std::atomic<uint64_t> NumBranchesAfter{0};
+  std::atomic<uint64_t> CountBefore{0};
+  std::atomic<uint64_t> CountAfter{0};
+
+  /// Stats: padding inserted.
+  std::atomic<uint64_t> PaddingBytes{0};
+  std::atomic<uint64_t> NumFunctionsPadded{0};
+
+  /// Estimate the final layout of hot blocks of \p BF, relaxing branches
+  /// whose targets are out of range of the short form, and count affected
+  /// branches. If \p Fix is set, insert padding before every affected branch.
+  /// Return the number of padding bytes inserted.
+  uint64_t processFunction(BinaryFunction &BF, const MCCodeEmitter *Emitter,
+                           bool Fix, uint64_t &NumBranches, uint64_t &Count);
+
+public:
+  explicit JCCErratumMitigation(const cl::opt<bool> &PrintPass)
+      : BinaryFunctionPass(PrintPass) {}
+
+  /// Return the offset past the instructions of \p BB placed at \p Offset.
+  /// \p InstSizes holds the encoded size of every instruction in \p BB, zero
+  /// for pseudo instructions. If \p Pad is set, include the padding that the
+  /// pass inserts in front of affected branches. The offset of every
+  /// instruction is stored in \p InstOffsets, and the index of the first
+  /// instruction of every affected branch or fused pair with the padding it
+  /// needs is stored in \p Affected.
+  static uint64_t
+  layoutBlock(const BinaryBasicBlock &BB, uint64_t Offset,
+              ArrayRef<uint64_t> InstSizes, bool Pad = true,
+              std::vector<uint64_t> *InstOffsets = nullptr,
+              std::vector<std::pair<size_t, uint64_t>> *Affected = nullptr);
+
+  const char *getName() const override { return "jcc-erratum-mitigation"; }
+
+  void runOnFunctions(BinaryContext &BC) override;
+};
+
+} // namespace bolt
+} // namespace llvm
+
+#endif
@@ -168,6 +168,10 @@ protected:
   StringRef getAnnotationName() const {
     return StringRef("LivenessAnalysis");
   }
+
+  bool hasDenseState() const {
+    return true;
+  }
 };
 
 } // end namespace bolt
@@ -0,0 +1,280 @@
+//===--- Passes/LoopUnrolling.cpp -----------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+//===----------------------------------------------------------------------===//
+
+#include "LoopUnrolling.h"
+#include "llvm/Support/CommandLine.h"
+
+#define DEBUG_TYPE "bolt-loop-unroll"
+
+using namespace llvm;
+
+namespace opts {
+
+extern cl::OptionCategory BoltOptCategory;
+
+cl::opt<bool>
+UnrollLoops("unroll-loops",
+  cl::desc("unroll hot single-block loops with high average trip counts"),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+cl::opt<bool>
+PeelLoops("peel-loops",
+  cl::desc("peel the first iteration of hot single-block loops with low "
+           "average trip counts"),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+LoopUnrollFactor("loop-unroll-factor",
+  cl::desc("maximum number of copies of an unrolled loop block"),
+  cl::init(4),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+LoopUnrollMaxSize("loop-unroll-max-size",
+  cl::desc("maximum number of instructions in all copies of an unrolled loop "
+           "block"),
+  cl::init(32),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+LoopUnrollMinTripCount("loop-unroll-min-trip-count",
+  cl::desc("minimum average trip count of a loop to be unrolled"),
+  cl::init(16),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+LoopPeelMaxTripCount("loop-peel-max-trip-count",
+  cl::desc("maximum average trip count of a loop to be peeled"),
+  cl::init(2),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+LoopPeelMaxSize("loop-peel-max-size",
+  cl::desc("maximum number of instructions in a peeled loop block"),
+  cl::init(16),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+LoopUnrollMinCount("loop-unroll-min-count",
+  cl::desc("minimum execution count of a loop block to be unrolled or peeled"),
+  cl::init(100),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+} // namespace opts
+
+namespace llvm {
+namespace bolt {
+
+bool LoopUnrolling::isCandidateLoop(const BinaryBasicBlock &BB) const {
+  if (BB.succ_size() != 2 || !BB.isSuccessor(&BB) ||
+      BB.getConditionalSuccessor(true) == BB.getConditionalSuccessor(false) ||
+      BB.isEntryPoint() || BB.isLandingPad() || BB.hasJumpTable() ||
+      BB.isCold())
+    return false;
+
+  const BinaryContext &BC = BB.getFunction()->getBinaryContext();
+  for (const MCInst &Inst : BB)
+    if (BC.MIB->isCall(Inst) || BC.MIB->isCFI(Inst) ||
+        BC.MIB->isIndirectBranch(Inst))
+      return false;
+
+  const MCSymbol *TBB = nullptr;
+  const MCSymbol *FBB = nullptr;
+  MCInst *CondBranch = nullptr;
+  MCInst *UncondBranch = nullptr;
+  return const_cast<BinaryBasicBlock &>(BB).analyzeBranch(
+             TBB, FBB, CondBranch, UncondBranch) &&
+         CondBranch;
+}
+
+void LoopUnrolling::unrollLoop(BinaryBasicBlock &BB, unsigned Factor) {
+  BinaryFunction &BF = *BB.getFunction();
+  BinaryContext &BC = BF.getBinaryContext();
+
+  const uint64_t Count = BB.getKnownExecutionCount();
+  const std::vector<BinaryBasicBlock *> Succs(BB.succ_begin(), BB.succ_end());
+  const std::vector<BinaryBasicBlock::BinaryBranchInfo> BIs(
+      BB.branch_info_begin(), BB.branch_info_end());
+  auto scale = [&](uint64_t C) {
+    return C == BinaryBasicBlock::COUNT_NO_PROFILE ? C : C / Factor;
+  };
+
+  // Each copy executes one iteration of the loop and keeps the exit edge:
+  //
+  //   BB:    <body>; jcc Exit
+  //   Copy1: <body>; jcc Exit
+  //   ...
+  //   CopyN: <body>; jncc BB
+  std::vector<std::unique_ptr<BinaryBasicBlock>> NewBBs;
+  std::vector<BinaryBasicBlock *> Chain{&BB};
+  for (unsigned I = 1; I < Factor; ++I) {
+    NewBBs.emplace_back(
+        BF.createBasicBlock(0, BC.Ctx->createNamedTempSymbol("unroll")));
+    NewBBs.back()->addInstructions(BB.begin(), BB.end());
+    Chain.push_back(NewBBs.back().get());
+  }
+
+  BB.removeAllSuccessors();
+  for (unsigned I = 0; I < Factor; ++I) {
+    BinaryBasicBlock *Copy = Chain[I];
+    BinaryBasicBlock *Next = Chain[(I + 1) % Factor];
+    // Keep the order of successors to preserve the branch condition.
+    for (size_t J = 0; J < Succs.size(); ++J)
+      Copy->addSuccessor(Succs[J] == &BB ? Next : Succs[J],
+                         scale(BIs[J].Count), scale(BIs[J].MispredictedCount));
+    Copy->setExecutionCount(Count / Factor);
+  }
+
+  BF.insertBasicBlocks(&BB, std::move(NewBBs));
+}
+
+void LoopUnrolling::peelLoop(BinaryBasicBlock &BB) {
+  BinaryFunction &BF = *BB.getFunction();
+  BinaryContext &BC = BF.getBinaryContext();
+
+  const uint64_t Count = BB.getKnownExecutionCount();
+  const uint64_t BackCount = BB.getBranchInfo(BB).Count;
+  const uint64_t EntryCount = Count - BackCount;
+
+  // Every entry into the loop is followed by an exit, so the loop exits on
+  // an iteration with probability EntryCount / Count. The product of the
+  // counts can overflow 64 bits, hence the floating point.
+  const uint64_t PeelExitCount =
+      std::min<uint64_t>(EntryCount, static_cast<double>(EntryCount) *
+                                         EntryCount / Count);
+  const uint64_t PeelBackCount = EntryCount - PeelExitCount;
+
+  std::unique_ptr<BinaryBasicBlock> PeelBB =
+      BF.createBasicBlock(0, BC.Ctx->createNamedTempSymbol("peel"));
+  PeelBB->addInstructions(BB.begin(), BB.end());
+  PeelBB->setExecutionCount(EntryCount);
+  PeelBB->setCFIState(BB.getCFIState());
+
+  const std::vector<BinaryBasicBlock *> Preds(BB.pred_begin(), BB.pred_end());
+  for (BinaryBasicBlock *Pred : Preds) {
+    if (Pred == &BB)
+      continue;
+    const BinaryBasicBlock::BinaryBranchInfo BI = Pred->getBranchInfo(BB);
+    Pred->replaceSuccessor(&BB, PeelBB.get(), BI.Count, BI.MispredictedCount);
+  }
+
+  for (BinaryBasicBlock *Succ : BB.successors()) {
+    BinaryBasicBlock::BinaryBranchInfo &BI = BB.getBranchInfo(*Succ);
+    const uint64_t PeelCount = Succ == &BB ? PeelBackCount : PeelExitCount;
+    PeelBB->addSuccessor(Succ, PeelCount, 0);
+    if (BI.Count != BinaryBasicBlock::COUNT_NO_PROFILE)
+      BI.Count -= std::min(BI.Count, PeelCount);
+  }
+  BB.setExecutionCount(Count - EntryCount);
+
+  // Place the peeled iteration in front of the loop.
+  BinaryBasicBlock *PrevBB = nullptr;
+  for (BinaryBasicBlock *LayoutBB : BF.layout()) {
+    if (LayoutBB == &BB)
+      break;
+    PrevBB = LayoutBB;
+  }
+  assert(PrevBB && "loop block cannot start the layout");
+
+  std::vector<std::unique_ptr<BinaryBasicBlock>> NewBBs;
+  NewBBs.emplace_back(std::move(PeelBB));
+  BF.insertBasicBlocks(PrevBB, std::move(NewBBs), /*UpdateLayout=*/true,
+                       /*UpdateCFIState=*/false);
+}
+
+bool LoopUnrolling::runOnFunction(BinaryFunction &BF) {
+  bool Modified = false;
+
+  // Blocks are added as the CFG changes, so iterate over a copy.
+  const BinaryFunction::BasicBlockOrderType Layout = BF.getLayout();
+  for (BinaryBasicBlock *BB : Layout) {
+    if (!isCandidateLoop(*BB))
+      continue;
+
+    const uint64_t Count = BB->getKnownExecutionCount();
+    const uint64_t BackCount = BB->getBranchInfo(*BB).Count;
+    if (Count < opts::LoopUnrollMinCount ||
+        BackCount == BinaryBasicBlock::COUNT_NO_PROFILE)
+      continue;
+
+    const uint64_t EntryCount = Count > BackCount ? Count - BackCount : 0;
+    const uint64_t TripCount = Count / std::max<uint64_t>(EntryCount, 1);
+    const uint64_t Size = BB->getNumNonPseudos();
+
+    if (opts::UnrollLoops && TripCount >= opts::LoopUnrollMinTripCount) {
+      const unsigned Factor = std::min<uint64_t>(
+          opts::LoopUnrollFactor,
+          opts::LoopUnrollMaxSize / std::max<uint64_t>(Size, 1));
+      if (Factor < 2)
+        continue;
+
+      LLVM_DEBUG(dbgs() << "BOLT-DEBUG: unrolling loop " << BB->getName()
+                        << " in " << BF << " by " << Factor
+                        << ". Count: " << Count << ", trip count: "
+                        << TripCount << '\n');
+      unrollLoop(*BB, Factor);
+      ++NumUnrolledLoops;
+      UnrolledCount += Count;
+      Modified = true;
+      continue;
+    }
+
+    if (opts::PeelLoops && EntryCount &&
+        TripCount <= opts::LoopPeelMaxTripCount &&
+        Size <= opts::LoopPeelMaxSize) {
+      // Predecessors have to be redirected to the peeled iteration.
+      bool CanRedirect = true;
+      for (const BinaryBasicBlock *Pred : BB->predecessors())
+        if (Pred != BB &&
+            (Pred->hasJumpTable() ||
+             std::count(Pred->succ_begin(), Pred->succ_end(), BB) != 1))
+          CanRedirect = false;
+      if (!CanRedirect)
+        continue;
+
+      LLVM_DEBUG(dbgs() << "BOLT-DEBUG: peeling loop " << BB->getName()
+                        << " in " << BF << ". Count: " << Count
+                        << ", trip count: " << TripCount << '\n');
+      peelLoop(*BB);
+      ++NumPeeledLoops;
+      PeeledCount += Count;
+      Modified = true;
+    }
+  }
+
+  if (Modified)
+    BF.fixBranches();
+
+  return Modified;
+}
+
+void LoopUnrolling::runOnFunctions(BinaryContext &BC) {
+  for (auto &BFI : BC.getBinaryFunctions()) {
+    BinaryFunction &BF = BFI.second;
+    if (!shouldOptimize(BF) || !BF.hasValidProfile())
+      continue;
+    runOnFunction(BF);
+  }
+
+  outs() << "BOLT-INFO: unrolled " << NumUnrolledLoops << " hot loops executed "
+         << UnrolledCount << " times and peeled " << NumPeeledLoops
+         << " hot loops executed " << PeeledCount << " times\n";
+}
+
+} // end namespace bolt
+} // end namespace llvm
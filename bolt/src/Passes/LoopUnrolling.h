@@ -0,0 +1,71 @@
+//===--- Passes/LoopUnrolling.h -------------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Profile-guided unrolling and peeling of hot single-block loops, i.e. blocks
+// that branch back to themselves.
+//
+// A loop with a high average trip count is unrolled by chaining copies of the
+// loop block. Every copy keeps the exit check of the original, so the
+// transformation does not depend on the exact trip count, while the taken
+// back edge of all but the last copy becomes a fall-through.
+//
+// A loop with a low average trip count gets a copy of its block that executes
+// the first iteration before entering the loop, so that the loop is never
+// entered when it runs for a single iteration.
+//
+// Limitations:
+//   * Only loops consisting of a single basic block are considered. Loops
+//     with internal control flow, calls, CFI or jump tables are left alone.
+//   * Every unrolled copy keeps its exit test, so the number of executed
+//     compares and conditional branches is unchanged; only taken back edges
+//     are saved.
+//   * Blocks are copied verbatim. There is no liveness or dataflow analysis,
+//     so no induction variable is rewritten and no redundant instruction
+//     across copies is removed.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TOOLS_LLVM_BOLT_PASSES_LOOP_UNROLLING_H
+#define LLVM_TOOLS_LLVM_BOLT_PASSES_LOOP_UNROLLING_H
+
+#include "BinaryPasses.h"
+
+namespace llvm {
+namespace bolt {
+
+class LoopUnrolling : public BinaryFunctionPass {
+  /// Stats: loops transformed and the number of times they were executed.
+  uint64_t NumUnrolledLoops{0};
+  uint64_t NumPeeledLoops{0};
+  uint64_t UnrolledCount{0};
+  uint64_t PeeledCount{0};
+
+  /// Return true if the block \p BB is a loop by itself that can be copied.
+  bool isCandidateLoop(const BinaryBasicBlock &BB) const;
+
+  /// Unroll the loop \p BB by chaining \p Factor copies of it.
+  void unrollLoop(BinaryBasicBlock &BB, unsigned Factor);
+
+  /// Peel the first iteration of the loop \p BB.
+  void peelLoop(BinaryBasicBlock &BB);
+
+  bool runOnFunction(BinaryFunction &BF);
+
+public:
+  explicit LoopUnrolling(const cl::opt<bool> &PrintPass)
+      : BinaryFunctionPass(PrintPass) {}
+
+  const char *getName() const override { return "loop-unrolling"; }
+
+  void runOnFunctions(BinaryContext &BC) override;
+};
+
+} // namespace bolt
+} // namespace llvm
+
+#endif
@@ -0,0 +1,293 @@
+//===--- Passes/Outliner.cpp - Cold code outlining ------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+//===----------------------------------------------------------------------===//
+
+#include "Outliner.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/SuffixTree.h"
+
+#define DEBUG_TYPE "bolt-outliner"
+
+using namespace llvm;
+
+namespace opts {
+
+extern cl::OptionCategory BoltOptCategory;
+
+static cl::opt<unsigned>
+OutlineMinSavings("outline-cold-min-savings",
+  cl::desc("minimum number of bytes saved by outlining a cold sequence"),
+  cl::init(8),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+} // namespace opts
+
+namespace llvm {
+namespace bolt {
+
+namespace {
+
+/// Size of the stub code besides the outlined sequence, i.e. the return.
+constexpr uint64_t ReturnSize = 1;
+
+} // end anonymous namespace
+
+bool Outliner::canOutline(const BinaryContext &BC, const MCInst &Inst) const {
+  if (BC.MIB->isPseudo(Inst) || BC.MIB->isCFI(Inst) ||
+      BC.MIB->isPrefix(Inst) || BC.MIB->isBranch(Inst) ||
+      BC.MIB->isCall(Inst) || BC.MIB->isReturn(Inst) ||
+      BC.MIB->isTerminator(Inst) || BC.MIB->getJumpTable(Inst))
+    return false;
+
+  for (unsigned I = 0, E = MCPlus::getNumPrimeOperands(Inst); I != E; ++I) {
+    const MCOperand &Operand = Inst.getOperand(I);
+    if (!Operand.isReg() && !Operand.isImm() && !Operand.isExpr())
+      return false;
+  }
+
+  // The return address occupies the top of the stack while the stub
+  // executes, so the sequence cannot access the stack through the stack
+  // pointer.
+  BitVector Regs(BC.MRI->getNumRegs(), false);
+  BC.MIB->getTouchedRegs(Inst, Regs);
+  return !Regs[BC.MIB->getStackPointer()];
+}
+
+void Outliner::buildInstrStream(
+    BinaryFunction &BF, std::unordered_map<std::string, unsigned> &InstrIDs,
+    unsigned &IllegalID) {
+  BinaryContext &BC = BF.getBinaryContext();
+
+  auto addInstr = [&](unsigned ID, BinaryBasicBlock *BB, unsigned Index,
+                      uint64_t Size) {
+    InstrStream.push_back(ID);
+    Locations.push_back({BB, Index});
+    Sizes.push_back(Size);
+  };
+
+  for (BinaryBasicBlock *BB : BF.layout()) {
+    if (!BB->isCold())
+      continue;
+
+    unsigned Index = 0;
+    for (const MCInst &Inst : *BB) {
+      const uint64_t Size =
+          BC.MIB->isPseudo(Inst) ? 0 : BC.computeInstructionSize(Inst);
+      ColdSize += Size;
+      if (!canOutline(BC, Inst)) {
+        addInstr(IllegalID--, BB, Index++, Size);
+        continue;
+      }
+
+      // Identical instructions are identified by their opcode and operands.
+      std::string Key;
+      raw_string_ostream OS(Key);
+      OS << Inst.getOpcode();
+      for (unsigned I = 0, E = MCPlus::getNumPrimeOperands(Inst); I != E;
+           ++I) {
+        const MCOperand &Operand = Inst.getOperand(I);
+        if (Operand.isReg())
+          OS << " r" << Operand.getReg();
+        else if (Operand.isImm())
+          OS << " i" << Operand.getImm();
+        else
+          OS << " e" << *Operand.getExpr();
+      }
+      OS.flush();
+
+      const unsigned ID = InstrIDs.emplace(Key, InstrIDs.size()).first->second;
+      addInstr(ID, BB, Index++, Size);
+    }
+
+    // Sequences do not cross basic block boundaries.
+    addInstr(IllegalID--, nullptr, 0, 0);
+  }
+}
+
+std::vector<Outliner::OutlinedSequence>
+Outliner::selectSequences(uint64_t CallSize) const {
+  auto getSavings = [&](const OutlinedSequence &Seq) -> int64_t {
+    return Seq.StartIndices.size() * (Seq.Size - CallSize) -
+           (Seq.Size + ReturnSize);
+  };
+
+  SuffixTree ST(InstrStream);
+  std::vector<OutlinedSequence> Candidates;
+  for (const SuffixTree::RepeatedSubstring &RS : ST) {
+    OutlinedSequence Seq;
+    Seq.Length = RS.Length;
+    Seq.Size = 0;
+    for (unsigned I = 0; I < RS.Length; ++I)
+      Seq.Size += Sizes[RS.StartIndices.front() + I];
+    if (Seq.Size <= CallSize)
+      continue;
+
+    // Keep non-overlapping occurrences.
+    std::vector<unsigned> StartIndices = RS.StartIndices;
+    std::sort(StartIndices.begin(), StartIndices.end());
+    for (unsigned Start : StartIndices)
+      if (Seq.StartIndices.empty() ||
+          Start >= Seq.StartIndices.back() + Seq.Length)
+        Seq.StartIndices.push_back(Start);
+
+    if (Seq.StartIndices.size() > 1 &&
+        getSavings(Seq) >= (int64_t)opts::OutlineMinSavings)
+      Candidates.emplace_back(std::move(Seq));
+  }
+
+  std::stable_sort(Candidates.begin(), Candidates.end(),
+                   [&](const OutlinedSequence &A, const OutlinedSequence &B) {
+                     return getSavings(A) > getSavings(B);
+                   });
+
+  // Greedily pick the most profitable sequences, dropping occurrences that
+  // overlap with sequences picked earlier.
+  std::vector<OutlinedSequence> Selected;
+  BitVector Outlined(InstrStream.size(), false);
+  for (OutlinedSequence &Seq : Candidates) {
+    std::vector<unsigned> StartIndices;
+    for (unsigned Start : Seq.StartIndices)
+      if (Outlined.find_first_in(Start, Start + Seq.Length) == -1)
+        StartIndices.push_back(Start);
+    Seq.StartIndices = std::move(StartIndices);
+
+    if (Seq.StartIndices.size() < 2 ||
+        getSavings(Seq) < (int64_t)opts::OutlineMinSavings)
+      continue;
+
+    for (unsigned Start : Seq.StartIndices)
+      Outlined.set(Start, Start + Seq.Length);
+    Selected.emplace_back(std::move(Seq));
+  }
+
+  return Selected;
+}
+
+void Outliner::outlineSequence(
+    BinaryContext &BC, const OutlinedSequence &Seq, uint64_t CallSize,
+    std::map<BinaryBasicBlock *, std::vector<Replacement>> &Replacements) {
+  const InstrLocation &First = Locations[Seq.StartIndices.front()];
+  auto Begin = First.BB->begin() + First.Index;
+
+  std::vector<MCInst> Instrs(Begin, Begin + Seq.Length);
+  Instrs.emplace_back();
+  BC.MIB->createReturn(Instrs.back());
+
+  BinaryFunction *Stub = BC.createInjectedBinaryFunction(
+      "__bolt_outlined_cold_" + std::to_string(NumStubs), true);
+
+  std::vector<std::unique_ptr<BinaryBasicBlock>> BBs;
+  BBs.emplace_back(
+      Stub->createBasicBlock(BinaryBasicBlock::INVALID_OFFSET, nullptr));
+  BBs.back()->addInstructions(Instrs.begin(), Instrs.end());
+  BBs.back()->setCFIState(0);
+
+  // The sequence does not touch the stack pointer, so the frame of the stub is
+  // just the return address, the same as at any function entry. Describing it
+  // with a CFA rule gives the stub an FDE, and lets the unwinder step through
+  // it into the calling cold fragment.
+  Stub->addCFIInstruction(BBs.back().get(), BBs.back()->begin(),
+                          MCCFIInstruction::cfiDefCfaOffset(nullptr, 8));
+
+  uint64_t Count = 0;
+  for (unsigned Start : Seq.StartIndices) {
+    const InstrLocation &Loc = Locations[Start];
+    MCInst Call;
+    BC.MIB->createCall(Call, Stub->getSymbol(), BC.Ctx.get());
+    Replacements[Loc.BB].push_back({Loc.Index, Seq.Length, std::move(Call)});
+    Count += Loc.BB->getKnownExecutionCount();
+  }
+
+  BBs.back()->setExecutionCount(Count);
+  Stub->insertBasicBlocks(nullptr, std::move(BBs),
+                          /*UpdateLayout=*/true,
+                          /*UpdateCFIState=*/false);
+  Stub->setExecutionCount(Count);
+  Stub->updateState(BinaryFunction::State::CFG_Finalized);
+
+  LLVM_DEBUG(dbgs() << "BOLT-DEBUG: outlined " << Seq.Length
+                    << " instructions (" << Seq.Size << " bytes) at "
+                    << Seq.StartIndices.size() << " call sites into "
+                    << *Stub << '\n');
+
+  ++NumStubs;
+  NumCallSites += Seq.StartIndices.size();
+  SavedBytes += Seq.StartIndices.size() * (Seq.Size - CallSize) -
+                (Seq.Size + ReturnSize);
+}
+
+bool Outliner::shouldOptimize(const BinaryFunction &BF) const {
+  // The pass runs after the CFG has been finalized.
+  return BF.isSimple() && BF.hasCFG() && !BF.isIgnored();
+}
+
+void Outliner::runOnFunctions(BinaryContext &BC) {
+  if (!BC.isX86())
+    return;
+
+  std::unordered_map<std::string, unsigned> InstrIDs;
+  // Instructions that cannot be outlined get unique IDs counting down from
+  // the top of the range. The two largest values are reserved as empty and
+  // tombstone keys of the DenseMap used by the suffix tree.
+  unsigned IllegalID = std::numeric_limits<unsigned>::max() - 2;
+  for (auto &BFI : BC.getBinaryFunctions()) {
+    BinaryFunction &BF = BFI.second;
+    if (!shouldOptimize(BF) || !BF.isSplit())
+      continue;
+
+    // Leaf functions may keep data in the red zone below the stack pointer
+    // that a call would overwrite.
+    bool HasCalls = false;
+    for (const BinaryBasicBlock *BB : BF.layout())
+      for (const MCInst &Inst : *BB)
+        HasCalls |= BC.MIB->isCall(Inst) && !BC.MIB->isTailCall(Inst);
+    if (!HasCalls)
+      continue;
+
+    buildInstrStream(BF, InstrIDs, IllegalID);
+  }
+
+  if (InstrStream.empty())
+    return;
+
+  MCInst Call;
+  BC.MIB->createCall(Call, BC.Ctx->createNamedTempSymbol(), BC.Ctx.get());
+  const uint64_t CallSize = BC.computeInstructionSize(Call);
+
+  std::map<BinaryBasicBlock *, std::vector<Replacement>> Replacements;
+  for (const OutlinedSequence &Seq : selectSequences(CallSize))
+    outlineSequence(BC, Seq, CallSize, Replacements);
+
+  // Replace sequences starting from the end of each block to keep the indices
+  // of earlier sequences valid.
+  for (auto &BBReplacements : Replacements) {
+    BinaryBasicBlock *BB = BBReplacements.first;
+    std::vector<Replacement> &Calls = BBReplacements.second;
+    std::sort(Calls.begin(), Calls.end(),
+              [](const Replacement &A, const Replacement &B) {
+                return A.Index > B.Index;
+              });
+    for (Replacement &R : Calls) {
+      auto II = BB->begin() + R.Index;
+      for (unsigned I = 0; I < R.Length; ++I)
+        II = BB->eraseInstruction(II);
+      BB->insertInstruction(II, std::move(R.Call));
+    }
+  }
+
+  outs() << "BOLT-INFO: outlined " << NumCallSites
+         << " cold instruction sequences into " << NumStubs
+         << " stubs, saving " << SavedBytes << " out of " << ColdSize
+         << " bytes of cold code\n";
+}
+
+} // end namespace bolt
+} // end namespace llvm
@@ -0,0 +1,93 @@
+//===--- Passes/Outliner.h - Cold code outlining --------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Reduce code size by outlining instruction sequences repeated in cold
+// fragments of split functions into shared stubs. Each occurrence of a
+// sequence is replaced with a call to the stub that executes the sequence and
+// returns. Only blocks moved to cold fragments by SplitFunctions are
+// considered, so the hot code is never changed. Sequences that access the
+// stack pointer are not outlined, so every stub gets an FDE with the frame
+// state of a function entry.
+//
+// Repeated sequences are found with a suffix tree built over the cold
+// instruction stream of the whole binary, where identical instructions map to
+// the same integer.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TOOLS_LLVM_BOLT_PASSES_OUTLINER_H
+#define LLVM_TOOLS_LLVM_BOLT_PASSES_OUTLINER_H
+
+#include "BinaryPasses.h"
+
+namespace llvm {
+namespace bolt {
+
+class Outliner : public BinaryFunctionPass {
+  /// Location of an instruction in the instruction stream.
+  struct InstrLocation {
+    BinaryBasicBlock *BB;
+    unsigned Index;
+  };
+
+  /// Occurrences of a sequence selected for outlining.
+  struct OutlinedSequence {
+    unsigned Length;
+    uint64_t Size;
+    std::vector<unsigned> StartIndices;
+  };
+
+  /// Call to a stub replacing the sequence at \p Index of a basic block.
+  struct Replacement {
+    unsigned Index;
+    unsigned Length;
+    MCInst Call;
+  };
+
+  /// Integers representing cold instructions, and their locations and sizes.
+  std::vector<unsigned> InstrStream;
+  std::vector<InstrLocation> Locations;
+  std::vector<uint64_t> Sizes;
+
+  /// Stats: stubs created, call sites and saved bytes of code.
+  uint64_t NumStubs{0};
+  uint64_t NumCallSites{0};
+  uint64_t ColdSize{0};
+  int64_t SavedBytes{0};
+
+  /// Return true if the instruction \p Inst can execute in a stub.
+  bool canOutline(const BinaryContext &BC, const MCInst &Inst) const;
+
+  /// Append cold instructions of \p BF to the instruction stream.
+  void buildInstrStream(BinaryFunction &BF,
+                        std::unordered_map<std::string, unsigned> &InstrIDs,
+                        unsigned &IllegalID);
+
+  /// Pick non-overlapping repeated sequences that reduce code size.
+  std::vector<OutlinedSequence> selectSequences(uint64_t CallSize) const;
+
+  /// Create a stub for \p Seq and replace its occurrences with calls to it.
+  void outlineSequence(
+      BinaryContext &BC, const OutlinedSequence &Seq, uint64_t CallSize,
+      std::map<BinaryBasicBlock *, std::vector<Replacement>> &Replacements);
+
+public:
+  explicit Outliner(const cl::opt<bool> &PrintPass)
+      : BinaryFunctionPass(PrintPass) {}
+
+  const char *getName() const override { return "outliner"; }
+
+  bool shouldOptimize(const BinaryFunction &BF) const override;
+
+  void runOnFunctions(BinaryContext &BC) override;
+};
+
+} // namespace bolt
+} // namespace llvm
+
+#endif
@@ -0,0 +1,203 @@
+//===--- Passes/PrefetchInsertion.cpp -------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+//===----------------------------------------------------------------------===//
+
+#include "PrefetchInsertion.h"
+#include "llvm/Support/CommandLine.h"
+#include <set>
+
+#define DEBUG_TYPE "bolt-prefetch"
+
+using namespace llvm;
+
+namespace opts {
+
+extern cl::OptionCategory BoltOptCategory;
+
+static cl::opt<unsigned>
+PrefetchDistance("prefetch-distance",
+  cl::desc("number of loop iterations ahead to prefetch"),
+  cl::init(8),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+PrefetchMinSamples("prefetch-min-samples",
+  cl::desc("minimum number of memory profile samples for a load to be "
+           "prefetched"),
+  cl::init(10),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+} // namespace opts
+
+namespace llvm {
+namespace bolt {
+
+namespace {
+
+/// Loads closer than this in the same loop share a prefetch.
+constexpr int64_t CacheLineSize = 64;
+
+} // end anonymous namespace
+
+std::map<MCPhysReg, int64_t>
+PrefetchInsertion::getInductionStrides(const BinaryContext &BC,
+                                       const BinaryLoop &L,
+                                       BinaryDominatorTree &DomTree) const {
+  SmallVector<BinaryBasicBlock *, 4> Latches;
+  L.getLoopLatches(Latches);
+
+  std::map<MCPhysReg, int64_t> Strides;
+  std::set<MCPhysReg> Rejected;
+  for (BinaryBasicBlock *BB : L.getBlocks()) {
+    // The increment has to execute on every iteration, i.e. its block has to
+    // dominate all latches.
+    const bool OnEveryIteration =
+        llvm::all_of(Latches, [&](const BinaryBasicBlock *Latch) {
+          return DomTree.dominates(BB, Latch);
+        });
+    for (const MCInst &Inst : *BB) {
+      MCPhysReg Reg;
+      int64_t Increment;
+      if (!BC.MIB->isRegisterIncrement(Inst, Reg, Increment))
+        continue;
+      if (!OnEveryIteration || !Strides.emplace(Reg, Increment).second)
+        Rejected.insert(Reg);
+    }
+  }
+
+  // Drop registers defined by anything other than their only increment.
+  for (const BinaryBasicBlock *BB : L.getBlocks()) {
+    for (const MCInst &Inst : *BB) {
+      const MCInstrDesc &Desc = BC.MII->get(Inst.getOpcode());
+      MCPhysReg IncReg;
+      int64_t Increment;
+      const bool IsIncrement =
+          BC.MIB->isRegisterIncrement(Inst, IncReg, Increment);
+      for (const std::pair<const MCPhysReg, int64_t> &Stride : Strides)
+        if ((!IsIncrement || IncReg != Stride.first) &&
+            Desc.hasDefOfPhysReg(Inst, Stride.first, *BC.MRI))
+          Rejected.insert(Stride.first);
+    }
+  }
+
+  for (MCPhysReg Reg : Rejected)
+    Strides.erase(Reg);
+
+  return Strides;
+}
+
+void PrefetchInsertion::runOnLoop(BinaryFunction &BF, const BinaryLoop &L,
+                                  BinaryDominatorTree &DomTree) {
+  BinaryContext &BC = BF.getBinaryContext();
+
+  // Calls may clobber registers without listing them as definitions.
+  for (const BinaryBasicBlock *BB : L.getBlocks())
+    for (const MCInst &Inst : *BB)
+      if (BC.MIB->isCall(Inst))
+        return;
+
+  const std::map<MCPhysReg, int64_t> Strides = getInductionStrides(BC, L, DomTree);
+
+  // Prefetched cache lines, identified by the address registers and the
+  // line of the prefetched displacement.
+  std::set<std::tuple<unsigned, unsigned, int64_t>> Prefetched;
+  for (BinaryBasicBlock *BB : L.getBlocks()) {
+    for (auto II = BB->begin(); II != BB->end(); ++II) {
+      if (!BC.MIB->isLoad(*II))
+        continue;
+
+      auto MemAccessProfile = BC.MIB->tryGetAnnotationAs<MemoryAccessProfile>(
+          *II, "MemoryAccessProfile");
+      if (!MemAccessProfile)
+        continue;
+
+      uint64_t Samples = 0;
+      for (const AddressAccess &AccessInfo :
+           MemAccessProfile->AddressAccessInfo)
+        Samples += AccessInfo.Count;
+      if (Samples < opts::PrefetchMinSamples)
+        continue;
+
+      ++NumCandidateLoads;
+      CandidateSamples += Samples;
+
+      unsigned BaseReg, IndexReg, SegReg;
+      int64_t Scale, Disp;
+      const MCExpr *DispExpr;
+      if (!BC.MIB->evaluateX86MemoryOperand(*II, &BaseReg, &Scale, &IndexReg,
+                                            &Disp, &SegReg, &DispExpr))
+        continue;
+
+      // The address has to advance by a constant stride per iteration.
+      int64_t Stride = 0;
+      auto BaseI = Strides.find(BaseReg);
+      if (BaseI != Strides.end())
+        Stride += BaseI->second;
+      auto IndexI = Strides.find(IndexReg);
+      if (IndexI != Strides.end())
+        Stride += Scale * IndexI->second;
+      if (!Stride)
+        continue;
+
+      const int64_t Offset = Stride * opts::PrefetchDistance;
+      MCInst Prefetch;
+      if (!BC.MIB->createPrefetch(Prefetch, *II, Offset))
+        continue;
+
+      const int64_t Line = (Disp + Offset) / CacheLineSize;
+      if (!Prefetched.emplace(BaseReg, IndexReg, Line).second)
+        continue;
+
+      LLVM_DEBUG(dbgs() << "BOLT-DEBUG: prefetching " << Offset
+                        << " bytes ahead in " << BB->getName() << " of " << BF
+                        << ". Samples: " << Samples << '\n');
+
+      II = std::next(BB->insertInstruction(II, std::move(Prefetch)));
+      ++NumPrefetches;
+      PrefetchedSamples += Samples;
+    }
+  }
+}
+
+void PrefetchInsertion::runOnFunctions(BinaryContext &BC) {
+  if (!BC.isX86())
+    return;
+
+  for (auto &BFI : BC.getBinaryFunctions()) {
+    BinaryFunction &BF = BFI.second;
+    if (!shouldOptimize(BF) || !BF.hasMemoryProfile())
+      continue;
+
+    // Earlier passes could have changed the CFG, recompute loops.
+    BF.calculateLoopInfo();
+    const BinaryLoopInfo &BLI = BF.getLoopInfo();
+    if (BLI.empty())
+      continue;
+
+    BinaryDominatorTree DomTree;
+    DomTree.recalculate(BF);
+    std::vector<const BinaryLoop *> Loops(BLI.begin(), BLI.end());
+    while (!Loops.empty()) {
+      const BinaryLoop *L = Loops.back();
+      Loops.pop_back();
+      if (L->isInnermost())
+        runOnLoop(BF, *L, DomTree);
+      Loops.insert(Loops.end(), L->begin(), L->end());
+    }
+  }
+
+  outs() << "BOLT-INFO: inserted " << NumPrefetches << " prefetches for "
+         << PrefetchedSamples << " out of " << CandidateSamples
+         << " memory samples of " << NumCandidateLoads << " loads in loops\n";
+}
+
+} // end namespace bolt
+} // end namespace llvm
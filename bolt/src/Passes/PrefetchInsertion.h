@@ -0,0 +1,61 @@
+//===--- Passes/PrefetchInsertion.h ---------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Insert software prefetches for loads in loops that frequently appear in the
+// memory profile, i.e. loads sampled with high latency. A prefetch is inserted
+// only when the address of the load advances by a constant stride on every
+// loop iteration, which is the case when the base or the index register of
+// the load is incremented by a constant exactly once in the loop, in a block
+// that dominates the loop latches. The prefetch targets the address the load
+// will access a configurable number of iterations ahead.
+//
+// Only the number of memory samples of a load is used to select it. The
+// sampled latency is not taken into account.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TOOLS_LLVM_BOLT_PASSES_PREFETCH_INSERTION_H
+#define LLVM_TOOLS_LLVM_BOLT_PASSES_PREFETCH_INSERTION_H
+
+#include "BinaryPasses.h"
+
+namespace llvm {
+namespace bolt {
+
+class PrefetchInsertion : public BinaryFunctionPass {
+  /// Stats: loads in loops with enough memory samples, loads prefetched and
+  /// their share of memory samples.
+  uint64_t NumCandidateLoads{0};
+  uint64_t NumPrefetches{0};
+  uint64_t CandidateSamples{0};
+  uint64_t PrefetchedSamples{0};
+
+  /// Return per-iteration strides of registers incremented by a constant
+  /// exactly once on every iteration and not otherwise modified in the loop
+  /// \p L.
+  std::map<MCPhysReg, int64_t>
+  getInductionStrides(const BinaryContext &BC, const BinaryLoop &L,
+                      BinaryDominatorTree &DomTree) const;
+
+  /// Insert prefetches into blocks of the innermost loop \p L.
+  void runOnLoop(BinaryFunction &BF, const BinaryLoop &L,
+                 BinaryDominatorTree &DomTree);
+
+public:
+  explicit PrefetchInsertion(const cl::opt<bool> &PrintPass)
+      : BinaryFunctionPass(PrintPass) {}
+
+  const char *getName() const override { return "prefetch-insertion"; }
+
+  void runOnFunctions(BinaryContext &BC) override;
+};
+
+} // namespace bolt
+} // namespace llvm
+
+#endif
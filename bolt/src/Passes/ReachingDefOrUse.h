@@ -153,6 +153,10 @@ protected:
       return StringRef("ReachingDefs");
     return StringRef("ReachingUses");
   }
+
+  bool hasDenseState() const {
+    return true;
+  }
 };
 
 } // end namespace bolt
@@ -9,10 +9,10 @@
 //===----------------------------------------------------------------------===//
 
 // TODO:
-// - make sure writeable data isn't put on same cache line unless temporally local
 // - estimate temporal locality by looking at CFG?
 
 #include "ReorderData.h"
+#include "Heatmap.h"
 #include <algorithm>
 
 #undef  DEBUG_TYPE
@@ -36,13 +36,16 @@ PrintReorderedData("print-reordered-data",
 cl::list<std::string>
 ReorderData("reorder-data",
   cl::CommaSeparated,
-  cl::desc("list of sections to reorder"),
+  cl::desc("list of sections to reorder. Hot data is moved to a new writable "
+           "segment. Hot .bss data is stored there with explicit zeros and "
+           "adds its size to the output file"),
   cl::value_desc("section1,section2,section3,..."),
   cl::cat(BoltOptCategory));
 
 enum ReorderAlgo : char {
   REORDER_COUNT         = 0,
-  REORDER_FUNCS         = 1
+  REORDER_FUNCS         = 1,
+  REORDER_AFFINITY      = 2
 };
 
 static cl::opt<ReorderAlgo>
@@ -55,7 +58,10 @@ ReorderAlgorithm("reorder-data-algo",
       "sort hot data by read counts"),
     clEnumValN(REORDER_FUNCS,
       "funcs",
-      "sort hot data by hot function usage and count")),
+      "sort hot data by hot function usage and count"),
+    clEnumValN(REORDER_AFFINITY,
+      "affinity",
+      "cluster hot data accessed by the same hot functions")),
   cl::ZeroOrMore,
   cl::cat(BoltOptCategory));
 
@@ -96,6 +102,32 @@ ReorderInplace("reorder-data-inplace",
   cl::ZeroOrMore,
   cl::cat(BoltOptCategory));
 
+static cl::opt<bool>
+ReorderDataSeparateWritten("reorder-data-separate-written",
+  cl::desc("with -reorder-data-algo=affinity, place data written by sampled "
+           "stores after read-mostly data, starting on a new cache line. "
+           "The padding is stored in the file for .bss too"),
+  cl::init(true),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+ReorderDataCacheLineSize("reorder-data-cache-line-size",
+  cl::desc("cache line size used for data layout decisions"),
+  cl::init(64),
+  cl::ZeroOrMore,
+  cl::Hidden,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<std::string>
+ReorderDataHeatmap("reorder-data-heatmap",
+  cl::desc("print cache line heatmaps of reordered sections before and after "
+           "reordering to files with the given prefix"),
+  cl::value_desc("prefix"),
+  cl::ZeroOrMore,
+  cl::Hidden,
+  cl::cat(BoltCategory));
+
 }
 
 namespace llvm {
@@ -106,7 +138,7 @@ namespace {
 static constexpr uint16_t MinAlignment = 16;
 
 bool isSupported(const BinarySection &BS) {
-  return BS.isData() && !BS.isTLS();
+  return (BS.isData() || BS.isBSS()) && !BS.isTLS();
 }
 
 bool filterSymbol(const BinaryData *BD) {
@@ -202,10 +234,13 @@ void ReorderData::assignMemData(BinaryContext &BC) {
 
         const MemoryAccessProfile &MemAccessProfile =
             ErrorOrMemAccesssProfile.get();
+        const bool IsStore = BC.MII->get(Inst.getOpcode()).mayStore();
         for (const AddressAccess &AccessInfo :
              MemAccessProfile.AddressAccessInfo) {
           if (BinaryData *BD = AccessInfo.MemoryObject) {
             BinaryDataCounts[BD->getAtomicRoot()] += AccessInfo.Count;
+            if (IsStore)
+              WrittenData.insert(BD->getAtomicRoot());
             Counts[BD->getSectionName()] += AccessInfo.Count;
             if (BD->getAtomicRoot()->isJumpTable()) {
               JumpTableCounts[BD->getSectionName()] += AccessInfo.Count;
@@ -312,6 +347,100 @@ std::pair<DataOrder, unsigned> ReorderData::sortedByFunc(
   return std::make_pair(Order, SplitPoint);
 }
 
+std::pair<DataOrder, unsigned> ReorderData::sortedByAffinity(
+  BinaryContext &BC,
+  const BinarySection &Section,
+  std::map<uint64_t, BinaryFunction> &BFs
+) const {
+  std::vector<BinaryFunction *> HotFunctions;
+  for (auto &Entry : BFs) {
+    BinaryFunction &BF = Entry.second;
+    if (BF.hasValidProfile() && BF.hasMemoryProfile() &&
+        BF.getKnownExecutionCount())
+      HotFunctions.push_back(&BF);
+  }
+  std::stable_sort(HotFunctions.begin(), HotFunctions.end(),
+                   [](const BinaryFunction *A, const BinaryFunction *B) {
+                     return A->getKnownExecutionCount() >
+                            B->getKnownExecutionCount();
+                   });
+
+  // Assign ranks to objects in the order they are first used by the hottest
+  // functions. Objects used by the same function end up next to each other,
+  // with the most frequently accessed ones first.
+  std::unordered_map<BinaryData *, uint64_t> Rank;
+  for (BinaryFunction *BF : HotFunctions) {
+    std::unordered_map<BinaryData *, uint64_t> Uses;
+    for (const BinaryBasicBlock &BB : *BF) {
+      if (BB.isCold())
+        continue;
+
+      for (const MCInst &Inst : BB) {
+        auto ErrorOrMemAccesssProfile =
+          BC.MIB->tryGetAnnotationAs<MemoryAccessProfile>(
+              Inst, "MemoryAccessProfile");
+        if (!ErrorOrMemAccesssProfile)
+          continue;
+
+        for (const AddressAccess &AccessInfo :
+             ErrorOrMemAccesssProfile.get().AddressAccessInfo) {
+          if (!AccessInfo.MemoryObject)
+            continue;
+          BinaryData *BD = AccessInfo.MemoryObject->getAtomicRoot();
+          if (&BD->getSection() != &Section ||
+              BC.getFunctionForSymbol(BD->getSymbol()))
+            continue;
+          Uses[BD] += AccessInfo.Count;
+        }
+      }
+    }
+
+    std::vector<std::pair<BinaryData *, uint64_t>> SortedUses(Uses.begin(),
+                                                              Uses.end());
+    std::sort(SortedUses.begin(), SortedUses.end(),
+              [](const std::pair<BinaryData *, uint64_t> &A,
+                 const std::pair<BinaryData *, uint64_t> &B) {
+                return (A.second > B.second ||
+                        (A.second == B.second &&
+                         A.first->getAddress() < B.first->getAddress()));
+              });
+    for (std::pair<BinaryData *, uint64_t> &Use : SortedUses) {
+      if (!Rank.count(Use.first)) {
+        const uint64_t NextRank = Rank.size();
+        Rank[Use.first] = NextRank;
+      }
+    }
+  }
+
+  auto isWritten = [&](BinaryData *BD) {
+    return opts::ReorderDataSeparateWritten && WrittenData.count(BD);
+  };
+
+  DataOrder Order = baseOrder(BC, Section);
+
+  std::sort(Order.begin(), Order.end(),
+            [&](const DataOrder::value_type &A,
+                const DataOrder::value_type &B) {
+              auto AI = Rank.find(A.first);
+              auto BI = Rank.find(B.first);
+              const bool AHot = AI != Rank.end();
+              const bool BHot = BI != Rank.end();
+              if (AHot != BHot)
+                return AHot;
+              if (!AHot)
+                return A.first->getAddress() < B.first->getAddress();
+              // Read-mostly data goes first so that written data does not
+              // share cache lines with it.
+              const bool AWritten = isWritten(A.first);
+              const bool BWritten = isWritten(B.first);
+              if (AWritten != BWritten)
+                return BWritten;
+              return AI->second < BI->second;
+            });
+
+  return std::make_pair(Order, Rank.size());
+}
+
 std::pair<DataOrder, unsigned> ReorderData::sortedByCount(
   BinaryContext &BC,
   const BinarySection &Section
@@ -363,6 +492,11 @@ void ReorderData::setSectionOrder(BinaryContext &BC,
   LLVM_DEBUG(dbgs() << "BOLT-DEBUG: setSectionOrder for "
                     << OutputSection.getName() << "\n");
 
+  const bool SeparateWritten =
+    opts::ReorderAlgorithm == opts::ReorderAlgo::REORDER_AFFINITY &&
+    opts::ReorderDataSeparateWritten;
+  bool PrevWritten = false;
+
   for (; Begin != End; ++Begin) {
     BinaryData *BD = Begin->first;
 
@@ -379,7 +513,13 @@ void ReorderData::setSectionOrder(BinaryContext &BC,
       break;
     }
 
-    uint16_t Alignment = std::max(BD->getAlignment(), MinAlignment);
+    uint64_t Alignment = std::max(BD->getAlignment(), MinAlignment);
+    // Start written data on a new cache line to avoid false sharing with
+    // the read-mostly data placed before it.
+    const bool IsWritten = SeparateWritten && WrittenData.count(BD);
+    if (IsWritten && !PrevWritten && Offset)
+      Alignment = std::max<uint64_t>(Alignment, opts::ReorderDataCacheLineSize);
+    PrevWritten = IsWritten;
     Offset = alignTo(Offset, Alignment);
 
     if ((Offset + BD->getSize()) > opts::ReorderDataMaxBytes) {
@@ -419,6 +559,60 @@ void ReorderData::setSectionOrder(BinaryContext &BC,
          << Offset << " hot bytes\n";
 }
 
+void ReorderData::printHeatmap(BinaryContext &BC,
+                               const BinarySection &Section,
+                               DataOrder::const_iterator Begin,
+                               DataOrder::const_iterator End) const {
+  Heatmap OrigMap(opts::ReorderDataCacheLineSize, Section.getAddress(),
+                  Section.getEndAddress());
+  Heatmap NewMap(opts::ReorderDataCacheLineSize, Section.getAddress(),
+                 Section.getEndAddress());
+
+  std::unordered_set<const BinaryData *> HotData;
+  for (; Begin != End; ++Begin)
+    HotData.insert(Begin->first);
+
+  for (auto &BFI : BC.getBinaryFunctions()) {
+    const BinaryFunction &BF = BFI.second;
+    if (!BF.hasMemoryProfile())
+      continue;
+
+    for (const BinaryBasicBlock &BB : BF) {
+      for (const MCInst &Inst : BB) {
+        auto ErrorOrMemAccesssProfile =
+          BC.MIB->tryGetAnnotationAs<MemoryAccessProfile>(
+              Inst, "MemoryAccessProfile");
+        if (!ErrorOrMemAccesssProfile)
+          continue;
+
+        for (const AddressAccess &AccessInfo :
+             ErrorOrMemAccesssProfile.get().AddressAccessInfo) {
+          const BinaryData *BD = AccessInfo.MemoryObject;
+          if (!BD || !HotData.count(BD->getAtomicRoot()))
+            continue;
+          const BinaryData *Root = BD->getAtomicRoot();
+          const uint64_t Address = BD->getAddress() + AccessInfo.Offset;
+          OrigMap.registerAddressRange(Address, Address, AccessInfo.Count);
+          if (&Root->getOutputSection() != &Section)
+            continue;
+          const uint64_t NewAddress = Section.getAddress() +
+                                      Root->getOutputOffset() +
+                                      (Address - Root->getAddress());
+          NewMap.registerAddressRange(NewAddress, NewAddress,
+                                      AccessInfo.Count);
+        }
+      }
+    }
+  }
+
+  const std::string Prefix = opts::ReorderDataHeatmap + Section.getName().str();
+  OrigMap.print(Prefix + ".orig");
+  NewMap.print(Prefix + ".new");
+  outs() << "BOLT-INFO: reorder-data: hot data in " << Section.getName()
+         << " spans " << OrigMap.size() << " cache lines before and "
+         << NewMap.size() << " after reordering\n";
+}
+
 bool ReorderData::markUnmoveableSymbols(BinaryContext &BC,
                                         BinarySection &Section) const {
   // Private symbols currently can't be moved because data can "leak" across
@@ -508,13 +702,21 @@ void ReorderData::runOnFunctions(BinaryContext &BC) {
     DataOrder Order;
     unsigned SplitPointIdx;
 
-    if (opts::ReorderAlgorithm == opts::ReorderAlgo::REORDER_COUNT) {
+    switch (opts::ReorderAlgorithm) {
+    case opts::ReorderAlgo::REORDER_COUNT:
       outs() << "BOLT-INFO: reorder-sections: ordering data by count\n";
       std::tie(Order, SplitPointIdx) = sortedByCount(BC, *Section);
-    } else {
+      break;
+    case opts::ReorderAlgo::REORDER_FUNCS:
       outs() << "BOLT-INFO: reorder-sections: ordering data by funcs\n";
       std::tie(Order, SplitPointIdx) =
         sortedByFunc(BC, *Section, BC.getBinaryFunctions());
+      break;
+    case opts::ReorderAlgo::REORDER_AFFINITY:
+      outs() << "BOLT-INFO: reorder-sections: ordering data by affinity\n";
+      std::tie(Order, SplitPointIdx) =
+        sortedByAffinity(BC, *Section, BC.getBinaryFunctions());
+      break;
     }
     auto SplitPoint = Order.begin() + SplitPointIdx;
 
@@ -548,6 +750,9 @@ void ReorderData::runOnFunctions(BinaryContext &BC) {
       outs() << "BOLT-WARNING: Inplace section reordering not supported yet.\n";
       setSectionOrder(BC, *Section, Order.begin(), Order.end());
     }
+
+    if (!opts::ReorderDataHeatmap.empty())
+      printHeatmap(BC, *Section, Order.begin(), SplitPoint);
   }
 }
 
@@ -13,6 +13,7 @@
 
 #include "BinaryPasses.h"
 #include <unordered_map>
+#include <unordered_set>
 
 namespace llvm {
 namespace bolt {
@@ -27,6 +28,9 @@ private:
 
   std::unordered_map<BinaryData *, uint64_t> BinaryDataCounts;
 
+  /// Objects with at least one sampled access from a store instruction.
+  std::unordered_set<BinaryData *> WrittenData;
+
   void assignMemData(BinaryContext &BC);
 
   /// Sort symbols by memory profiling data execution count.  The output
@@ -39,6 +43,20 @@ private:
                const BinarySection &Section,
                std::map<uint64_t, BinaryFunction> &BFs) const;
 
+  /// Cluster symbols accessed by the same hot functions, hottest function
+  /// first, and place read-mostly objects ahead of written ones.
+  std::pair<DataOrder, unsigned>
+  sortedByAffinity(BinaryContext &BC,
+                   const BinarySection &Section,
+                   std::map<uint64_t, BinaryFunction> &BFs) const;
+
+  /// Print cache-line granularity heatmaps of \p Section accesses for the
+  /// original and the new layout of the objects in [\p Begin, \p End).
+  void printHeatmap(BinaryContext &BC,
+                    const BinarySection &Section,
+                    DataOrder::const_iterator Begin,
+                    DataOrder::const_iterator End) const;
+
   void printOrder(const BinarySection &Section,
                   DataOrder::const_iterator Begin,
                   DataOrder::const_iterator End) const;
@@ -12,6 +12,7 @@
 #define LLVM_TOOLS_LLVM_BOLT_PASSES_SHRINKWRAPPING_H
 
 #include "FrameAnalysis.h"
+#include <atomic>
 
 namespace llvm {
 namespace bolt {
@@ -318,9 +319,9 @@ class ShrinkWrapping {
   std::vector<uint64_t> BestSaveCount;
   std::vector<MCInst *> BestSavePos;
 
-  /// Pass stats
-  static uint64_t SpillsMovedRegularMode;
-  static uint64_t SpillsMovedPushPopMode;
+  /// Pass stats, updated by functions shrink-wrapped in parallel
+  static std::atomic<uint64_t> SpillsMovedRegularMode;
+  static std::atomic<uint64_t> SpillsMovedPushPopMode;
 
   Optional<unsigned> AnnotationIndex;
 
@@ -0,0 +1,245 @@
+//===--- Passes/SpecializeMemOps.cpp --------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+//===----------------------------------------------------------------------===//
+
+#include "SpecializeMemOps.h"
+#include "llvm/Support/CommandLine.h"
+#include <fstream>
+
+#define DEBUG_TYPE "bolt-memops"
+
+using namespace llvm;
+
+namespace opts {
+
+extern cl::OptionCategory BoltOptCategory;
+
+cl::opt<std::string>
+MemOpSizeProfile("memop-size-profile",
+  cl::desc("specialize memcpy(), memset() and memcmp() calls for dominant "
+           "sizes from the size profile in the given file"),
+  cl::value_desc("filename"),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+MemOpSpecMaxSizes("memop-spec-max-sizes",
+  cl::desc("maximum number of sizes to specialize a call site for"),
+  cl::init(2),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+MemOpSpecMinPercent("memop-spec-min-percent",
+  cl::desc("minimum share in percent of calls at the site with a given size "
+           "to specialize for the size"),
+  cl::init(20),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+static cl::opt<unsigned>
+MemOpSpecMaxSize("memop-spec-max-size",
+  cl::desc("maximum size in bytes to inline (at most 127)"),
+  cl::init(64),
+  cl::ZeroOrMore,
+  cl::cat(BoltOptCategory));
+
+} // namespace opts
+
+namespace llvm {
+namespace bolt {
+
+bool SpecializeMemOps::readSizeProfile(StringRef FileName) {
+  std::ifstream ProfileFile(FileName.str(), std::ios::in);
+  if (!ProfileFile)
+    return false;
+
+  std::string Line;
+  while (std::getline(ProfileFile, Line)) {
+    StringRef Record = StringRef(Line).trim();
+    if (Record.empty() || Record.startswith("#"))
+      continue;
+
+    SmallVector<StringRef, 3> Fields;
+    Record.split(Fields, ' ', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+    uint64_t Address, Size, Count;
+    if (Fields.size() != 3 || Fields[0].getAsInteger(16, Address) ||
+        Fields[1].getAsInteger(10, Size) || Fields[2].getAsInteger(10, Count))
+      return false;
+
+    SizeProfile[Address][Size] += Count;
+  }
+
+  return true;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>>
+SpecializeMemOps::getDominantSizes(uint64_t Address,
+                                   uint64_t &TotalCount) const {
+  std::vector<std::pair<uint64_t, uint64_t>> Sizes;
+  TotalCount = 0;
+  auto SPI = SizeProfile.find(Address);
+  if (SPI == SizeProfile.end())
+    return Sizes;
+
+  for (const std::pair<const uint64_t, uint64_t> &SizeCount : SPI->second)
+    TotalCount += SizeCount.second;
+
+  // Sizes are compared against an 8-bit immediate.
+  const uint64_t MaxSize =
+      std::min<uint64_t>(opts::MemOpSpecMaxSize, INT8_MAX);
+  for (const std::pair<const uint64_t, uint64_t> &SizeCount : SPI->second)
+    if (SizeCount.first && SizeCount.first <= MaxSize &&
+        SizeCount.second * 100 >= TotalCount * opts::MemOpSpecMinPercent)
+      Sizes.emplace_back(SizeCount);
+
+  std::stable_sort(Sizes.begin(), Sizes.end(),
+                   [](const std::pair<uint64_t, uint64_t> &A,
+                      const std::pair<uint64_t, uint64_t> &B) {
+                     return A.second > B.second;
+                   });
+  if (Sizes.size() > opts::MemOpSpecMaxSizes)
+    Sizes.resize(opts::MemOpSpecMaxSizes);
+
+  return Sizes;
+}
+
+void SpecializeMemOps::runOnFunction(BinaryFunction &Function) {
+  BinaryContext &BC = Function.getBinaryContext();
+
+  std::vector<BinaryBasicBlock *> Blocks(Function.pbegin(), Function.pend());
+  for (BinaryBasicBlock *CurBB : Blocks) {
+    for (auto II = CurBB->begin(); II != CurBB->end(); ) {
+      MCInst &Inst = *II++;
+      if (!BC.MIB->isCall(Inst) || MCPlus::getNumPrimeOperands(Inst) != 1 ||
+          !Inst.getOperand(0).isExpr() || BC.MIB->isTailCall(Inst))
+        continue;
+
+      const StringRef CalleeName = BC.MIB->getTargetSymbol(Inst)->getName();
+      const bool IsMemcpy =
+          CalleeName == "memcpy" || CalleeName == "memcpy@PLT";
+      const bool IsMemset =
+          CalleeName == "memset" || CalleeName == "memset@PLT";
+      const bool IsMemcmp =
+          CalleeName == "memcmp" || CalleeName == "memcmp@PLT";
+      if (!IsMemcpy && !IsMemset && !IsMemcmp)
+        continue;
+
+      auto Offset = BC.MIB->tryGetAnnotationAs<uint32_t>(Inst, "Offset");
+      if (!Offset)
+        continue;
+
+      uint64_t TotalCount;
+      const std::vector<std::pair<uint64_t, uint64_t>> Sizes =
+          getDominantSizes(Function.getAddress() + *Offset, TotalCount);
+      if (Sizes.empty())
+        continue;
+
+      // A call at the end of a block without a successor does not return.
+      if (II == CurBB->end() && CurBB->succ_size() != 1)
+        continue;
+
+      LLVM_DEBUG(dbgs() << "BOLT-DEBUG: specializing call to " << CalleeName
+                        << " in " << Function << " for " << Sizes.size()
+                        << " sizes\n");
+
+      // Isolate the call in its own block.
+      const bool HasTail = II != CurBB->end();
+      BinaryBasicBlock *CallBB = CurBB->splitAt(std::prev(II));
+      BinaryBasicBlock *NextBB =
+          HasTail ? CallBB->splitAt(std::next(CallBB->begin()))
+                  : CallBB->getSuccessor();
+
+      // Chain size checks in front of the call:
+      //
+      //   CurBB:   cmp $size0, %rdx; je Spec0
+      //   Check1:  cmp $size1, %rdx; je Spec1
+      //   CallBB:  call memcpy
+      //   SpecN:   <inline code>; jmp NextBB
+      const uint64_t BBCount = CurBB->getKnownExecutionCount();
+      uint64_t RemainingCount = BBCount;
+      BinaryBasicBlock *CheckBB = CurBB;
+      CurBB->removeAllSuccessors();
+      for (size_t I = 0; I < Sizes.size(); ++I) {
+        const uint64_t Size = Sizes[I].first;
+        const uint64_t SpecCount =
+            TotalCount ? BBCount * Sizes[I].second / TotalCount : 0;
+
+        BinaryBasicBlock *SpecBB =
+            Function.addBasicBlock(CurBB->getInputOffset());
+        std::vector<MCInst> Code =
+            IsMemcpy   ? BC.MIB->createFixedSizeMemcpy(Size)
+            : IsMemset ? BC.MIB->createFixedSizeMemset(Size)
+                       : BC.MIB->createFixedSizeMemcmp(Size);
+        SpecBB->addInstructions(Code);
+        SpecBB->addSuccessor(NextBB, SpecCount, 0);
+        SpecBB->setCFIState(NextBB->getCFIState());
+        SpecBB->setExecutionCount(SpecCount);
+
+        CheckBB->addInstructions(
+            BC.MIB->createCmpJE(BC.MIB->getIntArgRegister(2), Size,
+                                SpecBB->getLabel(), BC.Ctx.get()));
+        CheckBB->addSuccessor(SpecBB, SpecCount, 0);
+        RemainingCount -= std::min(RemainingCount, SpecCount);
+
+        BinaryBasicBlock *FallthroughBB = CallBB;
+        if (I + 1 < Sizes.size()) {
+          FallthroughBB = Function.addBasicBlock(CurBB->getInputOffset());
+          FallthroughBB->setCFIState(CallBB->getCFIState());
+          FallthroughBB->setExecutionCount(RemainingCount);
+        }
+        CheckBB->addSuccessor(FallthroughBB, RemainingCount, 0);
+        CheckBB = FallthroughBB;
+
+        ++NumSpecializedSizes;
+        NumCallsRemoved += Sizes[I].second;
+      }
+
+      // To prevent the actual call from being moved to cold, we set its
+      // execution count to at least 1.
+      CallBB->setExecutionCount(BBCount ? std::max<uint64_t>(RemainingCount, 1)
+                                        : 0);
+
+      ++NumSpecializedSites;
+      NumProfiledCalls += TotalCount;
+
+      // Continue with the code following the call in the original block.
+      if (!HasTail)
+        break;
+      CurBB = NextBB;
+      II = CurBB->begin();
+    }
+  }
+}
+
+void SpecializeMemOps::runOnFunctions(BinaryContext &BC) {
+  if (!BC.isX86())
+    return;
+
+  if (!readSizeProfile(opts::MemOpSizeProfile)) {
+    errs() << "BOLT-ERROR: cannot read size profile from "
+           << opts::MemOpSizeProfile << '\n';
+    exit(1);
+  }
+
+  for (auto &BFI : BC.getBinaryFunctions()) {
+    BinaryFunction &Function = BFI.second;
+    if (!shouldOptimize(Function))
+      continue;
+    runOnFunction(Function);
+  }
+
+  outs() << "BOLT-INFO: specialized " << NumSpecializedSites
+         << " memcpy(), memset() and memcmp() call sites for "
+         << NumSpecializedSizes << " sizes, removing " << NumCallsRemoved << " out of "
+         << NumProfiledCalls << " profiled calls\n";
+}
+
+} // end namespace bolt
+} // end namespace llvm
@@ -0,0 +1,67 @@
+//===--- Passes/SpecializeMemOps.h ----------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Specialize calls to memcpy(), memset() and memcmp() for the sizes that
+// dominate the size profile of the call site. Each specialized call site
+// checks the size argument against the dominant sizes and executes an inline
+// copy, fill or comparison for a match, falling back to the library call
+// otherwise. The inline comparison only matches the sign of the memcmp()
+// result.
+//
+// The size profile is a text file with one record per line:
+//
+//   <call instruction address (hex)> <size> <count>
+//
+// where the address is the one in the input binary. The profile is written
+// by binaries instrumented with -instrument-memop-sizes.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TOOLS_LLVM_BOLT_PASSES_SPECIALIZE_MEM_OPS_H
+#define LLVM_TOOLS_LLVM_BOLT_PASSES_SPECIALIZE_MEM_OPS_H
+
+#include "BinaryPasses.h"
+
+namespace llvm {
+namespace bolt {
+
+class SpecializeMemOps : public BinaryFunctionPass {
+  /// Sizes and their counts for each call site address.
+  std::unordered_map<uint64_t, std::map<uint64_t, uint64_t>> SizeProfile;
+
+  /// Stats: call sites specialized and dynamic calls replaced with inline
+  /// code according to the size profile.
+  uint64_t NumSpecializedSites{0};
+  uint64_t NumSpecializedSizes{0};
+  uint64_t NumCallsRemoved{0};
+  uint64_t NumProfiledCalls{0};
+
+  /// Read the size profile. Return false on error.
+  bool readSizeProfile(StringRef FileName);
+
+  /// Return the sizes to specialize the call site at \p Address for, ordered
+  /// by decreasing frequency, together with their counts. Set \p TotalCount
+  /// to the number of profiled calls at the site.
+  std::vector<std::pair<uint64_t, uint64_t>>
+  getDominantSizes(uint64_t Address, uint64_t &TotalCount) const;
+
+  void runOnFunction(BinaryFunction &BF);
+
+public:
+  explicit SpecializeMemOps(const cl::opt<bool> &PrintPass)
+      : BinaryFunctionPass(PrintPass) {}
+
+  const char *getName() const override { return "specialize-mem-ops"; }
+
+  void runOnFunctions(BinaryContext &BC) override;
+};
+
+} // namespace bolt
+} // namespace llvm
+
+#endif
@@ -17,11 +17,10 @@
 namespace llvm {
 namespace bolt {
 
-StackAvailableExpressions::StackAvailableExpressions(const RegAnalysis &RA,
-                                                     const FrameAnalysis &FA,
-                                                     const BinaryContext &BC,
-                                                     BinaryFunction &BF)
-    : InstrsDataflowAnalysis(BC, BF), RA(RA), FA(FA) {}
+StackAvailableExpressions::StackAvailableExpressions(
+    const RegAnalysis &RA, const FrameAnalysis &FA, const BinaryContext &BC,
+    BinaryFunction &BF, MCPlusBuilder::AllocatorIdTy AllocId)
+    : InstrsDataflowAnalysis(BC, BF, AllocId), RA(RA), FA(FA) {}
 
 void StackAvailableExpressions::preflight() {
   LLVM_DEBUG(dbgs() << "Starting StackAvailableExpressions on \""
@@ -30,7 +30,8 @@ class StackAvailableExpressions
 
 public:
   StackAvailableExpressions(const RegAnalysis &RA, const FrameAnalysis &FA,
-                            const BinaryContext &BC, BinaryFunction &BF);
+                            const BinaryContext &BC, BinaryFunction &BF,
+                            MCPlusBuilder::AllocatorIdTy AllocId = 0);
   virtual ~StackAvailableExpressions() {}
 
   void run() {
@@ -180,6 +180,10 @@ protected:
     return StringRef("StackPointerTracking");
   }
 
+  bool hasDenseState() const {
+    return true;
+  }
+
 public:
   StackPointerTrackingBase(const BinaryContext &BC, BinaryFunction &BF,
                            MCPlusBuilder::AllocatorIdTy AllocatorId = 0)
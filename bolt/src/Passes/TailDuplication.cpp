@@ -9,6 +9,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "TailDuplication.h"
+#include "CacheMetrics.h"
 
 #include <numeric>
 
@@ -37,10 +38,63 @@ static cl::opt<unsigned> TailDuplicationMaximumDuplication(
     cl::desc("maximum size of duplicated blocks (in bytes)"), cl::ZeroOrMore,
     cl::ReallyHidden, cl::init(64), cl::cat(BoltOptCategory));
 
+static cl::opt<bool> TailDuplicationCostModel(
+    "tail-duplication-cost-model",
+    cl::desc("duplicate tails only if the gain in ExtTSP score of the block "
+             "layout outweighs the growth of hot code"),
+    cl::ZeroOrMore, cl::ReallyHidden, cl::init(false),
+    cl::cat(BoltOptCategory));
+
+static cl::opt<double> TailDuplicationMinScoreGain(
+    "tail-duplication-min-score-gain",
+    cl::desc("minimum gain in ExtTSP score per byte of duplicated hot code "
+             "for the tail duplication cost model"),
+    cl::ZeroOrMore, cl::ReallyHidden, cl::init(1.0),
+    cl::cat(BoltOptCategory));
+
 } // namespace opts
 
 namespace llvm {
 namespace bolt {
+
+namespace {
+
+/// A block in a layout model used to compute the ExtTSP score. Outgoing edges
+/// are given by the index of the destination block in the layout and count.
+struct BlockModel {
+  uint64_t Size{0};
+  std::vector<std::pair<size_t, uint64_t>> Succs;
+};
+
+/// Return the ExtTSP score of \p Blocks placed in order, and set
+/// \p Fallthroughs to the execution count of fall-through edges.
+double getLayoutScore(const std::vector<BlockModel> &Blocks,
+                      uint64_t &Fallthroughs) {
+  std::vector<uint64_t> Addresses;
+  Addresses.reserve(Blocks.size());
+  uint64_t Address = 0;
+  for (const BlockModel &Block : Blocks) {
+    Addresses.push_back(Address);
+    Address += Block.Size;
+  }
+
+  double Score = 0;
+  Fallthroughs = 0;
+  for (size_t I = 0; I < Blocks.size(); ++I) {
+    for (const std::pair<size_t, uint64_t> &Succ : Blocks[I].Succs) {
+      if (Succ.first == I)
+        continue;
+      Score += CacheMetrics::extTSPScore(Addresses[I], Blocks[I].Size,
+                                         Addresses[Succ.first], Succ.second);
+      if (Addresses[I] + Blocks[I].Size == Addresses[Succ.first])
+        Fallthroughs += Succ.second;
+    }
+  }
+  return Score;
+}
+
+} // end anonymous namespace
+
 void TailDuplication::getCallerSavedRegs(const MCInst &Inst, BitVector &Regs,
                                          BinaryContext &BC) const {
   if (!BC.MIB->isCall(Inst))
@@ -296,6 +350,102 @@ TailDuplication::aggressiveCodeToDuplicate(BinaryBasicBlock &BB) const {
   return BlocksToDuplicate;
 }
 
+double TailDuplication::getDuplicationGain(
+    const BinaryBasicBlock &BB,
+    const std::vector<BinaryBasicBlock *> &BlocksToDuplicate,
+    std::unordered_map<const BinaryBasicBlock *, uint64_t> &BlockSizes,
+    int64_t &FallthroughDelta) const {
+  auto getSize = [&](const BinaryBasicBlock *Block) {
+    auto Itr = BlockSizes.find(Block);
+    if (Itr == BlockSizes.end())
+      Itr = BlockSizes.emplace(Block, Block->estimateSize()).first;
+    return Itr->second;
+  };
+
+  std::vector<const BinaryBasicBlock *> Layout;
+  for (const BinaryBasicBlock *Block : BB.getFunction()->layout())
+    if (!Block->isCold())
+      Layout.push_back(Block);
+
+  // Share of the execution count of the tail moving to its duplicate, as
+  // computed by tailDuplicate()
+  const BinaryBasicBlock &Succ = *BB.getSuccessor();
+  const double Ratio =
+      BB.getKnownExecutionCount() > Succ.getKnownExecutionCount()
+          ? 1.0
+          : (double)BB.getKnownExecutionCount() /
+                Succ.getKnownExecutionCount();
+  const std::unordered_set<const BinaryBasicBlock *> Duplicated(
+      BlocksToDuplicate.begin(), BlocksToDuplicate.end());
+
+  auto buildModel = [&](bool WithDuplicates) {
+    // Indices of the original blocks in the model, followed by the duplicated
+    // blocks placed after BB
+    std::unordered_map<const BinaryBasicBlock *, size_t> Index;
+    size_t NumBlocks = 0;
+    for (const BinaryBasicBlock *Block : Layout) {
+      Index[Block] = NumBlocks++;
+      if (WithDuplicates && Block == &BB)
+        NumBlocks += BlocksToDuplicate.size();
+    }
+    const size_t FirstDuplicate = Index[&BB] + 1;
+
+    std::vector<BlockModel> Blocks(NumBlocks);
+    auto addSuccs = [&](size_t I, const BinaryBasicBlock &Block,
+                        const BinaryBasicBlock *OnlySucc, size_t OnlySuccIndex,
+                        double Scale) {
+      auto BI = Block.branch_info_begin();
+      for (const BinaryBasicBlock *Succ : Block.successors()) {
+        const uint64_t Count =
+            BI->Count == BinaryBasicBlock::COUNT_NO_PROFILE ? 0 : BI->Count;
+        ++BI;
+        if (OnlySucc) {
+          if (Succ == OnlySucc)
+            Blocks[I].Succs.emplace_back(OnlySuccIndex, Count * Scale);
+          continue;
+        }
+        auto Itr = Index.find(Succ);
+        if (Itr != Index.end())
+          Blocks[I].Succs.emplace_back(Itr->second, Count * Scale);
+      }
+    };
+
+    for (const BinaryBasicBlock *Block : Layout) {
+      const size_t I = Index[Block];
+      Blocks[I].Size = getSize(Block);
+      if (WithDuplicates && Block == &BB)
+        addSuccs(I, BB, &Succ, FirstDuplicate, 1.0);
+      else if (WithDuplicates && Duplicated.count(Block))
+        addSuccs(I, *Block, nullptr, 0, 1.0 - Ratio);
+      else
+        addSuccs(I, *Block, nullptr, 0, 1.0);
+    }
+
+    if (!WithDuplicates)
+      return Blocks;
+
+    for (size_t J = 0; J < BlocksToDuplicate.size(); ++J) {
+      const BinaryBasicBlock &Original = *BlocksToDuplicate[J];
+      Blocks[FirstDuplicate + J].Size = getSize(&Original);
+      if (J + 1 < BlocksToDuplicate.size())
+        addSuccs(FirstDuplicate + J, Original, BlocksToDuplicate[J + 1],
+                 FirstDuplicate + J + 1, Ratio);
+      else
+        addSuccs(FirstDuplicate + J, Original, nullptr, 0, Ratio);
+    }
+    return Blocks;
+  };
+
+  uint64_t FallthroughsBefore = 0;
+  uint64_t FallthroughsAfter = 0;
+  const double ScoreBefore =
+      getLayoutScore(buildModel(/*WithDuplicates=*/false), FallthroughsBefore);
+  const double ScoreAfter =
+      getLayoutScore(buildModel(/*WithDuplicates=*/true), FallthroughsAfter);
+  FallthroughDelta = (int64_t)FallthroughsAfter - (int64_t)FallthroughsBefore;
+  return ScoreAfter - ScoreBefore;
+}
+
 std::vector<BinaryBasicBlock *> TailDuplication::tailDuplicate(
     BinaryBasicBlock &BB,
     const std::vector<BinaryBasicBlock *> &BlocksToDuplicate) const {
@@ -364,6 +514,10 @@ std::vector<BinaryBasicBlock *> TailDuplication::tailDuplicate(
 }
 
 void TailDuplication::runOnFunction(BinaryFunction &Function) {
+  const bool UseCostModel =
+      opts::TailDuplicationCostModel && Function.hasValidProfile();
+  std::unordered_map<const BinaryBasicBlock *, uint64_t> BlockSizes;
+
   // New blocks will be added and layout will change,
   // so make a copy here to iterate over the original layout
   BinaryFunction::BasicBlockOrderType BlockLayout = Function.getLayout();
@@ -390,13 +544,39 @@ void TailDuplication::runOnFunction(BinaryFunction &Function) {
     // and we are estimating that this sucessor is not already in the same cache
     // line
     BinaryBasicBlock *Succ = BB->getSuccessor();
-    if (isInCacheLine(*BB, *Succ))
+    if (UseCostModel ? BB == Succ || BB->isCold() : isInCacheLine(*BB, *Succ))
       continue;
     std::vector<BinaryBasicBlock *> BlocksToDuplicate;
     if (opts::TailDuplicationAggressive)
       BlocksToDuplicate = aggressiveCodeToDuplicate(*Succ);
     else
       BlocksToDuplicate = moderateCodeToDuplicate(*Succ);
+
+    // The cost model replaces the distance check: the gain in ExtTSP score
+    // accounts for the distance of the removed jump and for the jumps that
+    // become longer, and has to outweigh the growth of hot code.
+    if (UseCostModel && BlocksToDuplicate.size() > 0) {
+      bool CanModel = true;
+      uint64_t Size = 0;
+      for (const BinaryBasicBlock *Block : BlocksToDuplicate) {
+        CanModel &= Block != BB && !Block->isCold();
+        Size += Block->estimateSize();
+      }
+      int64_t FallthroughDelta = 0;
+      const double Gain =
+          CanModel ? getDuplicationGain(*BB, BlocksToDuplicate, BlockSizes,
+                                        FallthroughDelta)
+                   : 0;
+      if (!CanModel || Gain <= 0 ||
+          Gain < opts::TailDuplicationMinScoreGain * Size) {
+        ++CostModelRejections;
+        continue;
+      }
+      ScoreGain += Gain;
+      FallthroughGain += FallthroughDelta;
+      DuplicatedHotBytes += Size;
+    }
+
     if (BlocksToDuplicate.size() > 0) {
       PossibleDuplications++;
       PossibleDuplicationsDynamicCount += BB->getExecutionCount();
@@ -409,6 +589,8 @@ void TailDuplication::runOnFunction(BinaryFunction &Function) {
         if (PredBB->succ_size() == 1)
           constantAndCopyPropagate(*PredBB, BlocksToDuplicate);
       }
+      // Sizes change with propagation and new blocks
+      BlockSizes.clear();
     }
   }
 }
@@ -439,6 +621,14 @@ void TailDuplication::runOnFunctions(BinaryContext &BC) {
          << StaticInstructionDeletionCount << "\n";
   outs() << "BOLT-INFO: tail duplication dynamic propagation deletions: "
          << DynamicInstructionDeletionCount << "\n"; //
+
+  if (opts::TailDuplicationCostModel) {
+    outs() << "BOLT-INFO: tail duplication cost model rejected "
+           << CostModelRejections << " duplications and duplicated "
+           << DuplicatedHotBytes << " bytes of hot code for an ExtTSP score "
+           << "gain of " << format("%.0f", ScoreGain)
+           << " and a net fall-through gain of " << FallthroughGain << "\n";
+  }
 }
 
 } // end namespace bolt
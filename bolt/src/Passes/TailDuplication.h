@@ -39,6 +39,15 @@
 // that if there is too much code duplication, we may end up evicting hot cache
 // lines and causing the opposite effect, hurting i-cache performance This needs
 // to be well balanced to achieve the optimal effect
+//
+// With -tail-duplication-cost-model, a duplication candidate in a function with
+// a valid profile is evaluated by the change in the ExtTSP score of the final
+// block layout of the hot fragment, which accounts both for the new
+// fall-through and for the jumps made longer by the duplicated code. The gain
+// has to outweigh the growth of hot code for the candidate to be duplicated.
+// The decision is not made jointly with block reordering: the pass runs after
+// ReorderBasicBlocks, and each candidate is evaluated against the layout that
+// pass produced, with the duplicates placed right after the branching block.
 
 namespace llvm {
 namespace bolt {
@@ -63,6 +72,17 @@ class TailDuplication : public BinaryFunctionPass {
   /// Record the number of instructions deleted because of propagation
   uint64_t DynamicInstructionDeletionCount = 0;
 
+  /// Record the number of duplications rejected by the cost model.
+  uint64_t CostModelRejections = 0;
+
+  /// Record the size of hot code duplicated with the cost model.
+  uint64_t DuplicatedHotBytes = 0;
+
+  /// Record the gain in ExtTSP score and in the execution count of
+  /// fall-through edges from duplications accepted by the cost model.
+  double ScoreGain = 0;
+  int64_t FallthroughGain = 0;
+
   /// Sets Regs with the caller saved registers
   void getCallerSavedRegs(const MCInst &Inst, BitVector &Regs,
                           BinaryContext &BC) const;
@@ -103,6 +123,16 @@ class TailDuplication : public BinaryFunctionPass {
   std::vector<BinaryBasicBlock *>
   aggressiveCodeToDuplicate(BinaryBasicBlock &BB) const;
 
+  /// Return the change in the ExtTSP score of the hot fragment of the function
+  /// if BlocksToDuplicate were duplicated after BB. Set FallthroughDelta to
+  /// the change in the execution count of fall-through edges. Block sizes are
+  /// looked up in and added to BlockSizes.
+  double getDuplicationGain(
+      const BinaryBasicBlock &BB,
+      const std::vector<BinaryBasicBlock *> &BlocksToDuplicate,
+      std::unordered_map<const BinaryBasicBlock *, uint64_t> &BlockSizes,
+      int64_t &FallthroughDelta) const;
+
   void runOnFunction(BinaryFunction &Function);
 
 public:
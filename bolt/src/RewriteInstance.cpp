@@ -22,6 +22,7 @@
 #include "Exceptions.h"
 #include "ExecutableFileMemoryManager.h"
 #include "MCPlusBuilder.h"
+#include "MemoryStats.h"
 #include "ParallelUtilities.h"
 #include "Passes/ReorderFunctions.h"
 #include "Relocation.h"
@@ -31,6 +32,7 @@
 #include "YAMLProfileReader.h"
 #include "YAMLProfileWriter.h"
 #include "llvm/ADT/Optional.h"
+#include "llvm/ADT/ScopeExit.h"
 #include "llvm/DebugInfo/DWARF/DWARFContext.h"
 #include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/MC/MCAsmBackend.h"
@@ -46,17 +48,22 @@
 #include "llvm/Support/Alignment.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compression.h"
 #include "llvm/Support/DataExtractor.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/LEB128.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <deque>
 #include <fstream>
+#include <future>
 #include <system_error>
 
 #undef  DEBUG_TYPE
@@ -82,6 +89,7 @@ extern cl::OptionCategory AggregatorCategory;
 
 extern cl::opt<MacroFusionType> AlignMacroOpFusion;
 extern cl::opt<bool> Hugify;
+extern cl::opt<bool> TextTiers;
 extern cl::opt<bool> Instrument;
 extern cl::opt<JumpTableSupportLevel> JumpTables;
 extern cl::list<std::string> ReorderData;
@@ -129,6 +137,12 @@ AllowStripped("allow-stripped",
   cl::Hidden,
   cl::cat(BoltCategory));
 
+static cl::opt<bool>
+CompressDebugSections("compress-debug-sections",
+  cl::desc("compress debug sections in the output binary with zlib"),
+  cl::ZeroOrMore,
+  cl::cat(BoltOutputCategory));
+
 cl::opt<bool>
 DumpDotAll("dump-dot-all",
   cl::desc("dump function CFGs to graphviz format after each stage"),
@@ -188,6 +202,13 @@ KeepTmp("keep-tmp",
   cl::Hidden,
   cl::cat(BoltCategory));
 
+static cl::opt<bool>
+FreeEmittedState("free-emitted-state",
+  cl::desc("free memory used for emission of functions once their output "
+           "addresses are known"),
+  cl::ZeroOrMore,
+  cl::cat(BoltCategory));
+
 static cl::opt<bool>
 Lite("lite",
   cl::desc("skip processing of cold functions"),
@@ -492,11 +513,8 @@ RewriteInstance::RewriteInstance(ELFObjectFileBase *File, const int Argc,
     IsPIC = true;
   }
 
-  BC = BinaryContext::createBinaryContext(
-      File, IsPIC,
-      DWARFContext::create(*File, nullptr, opts::DWPPathName,
-                           WithColor::defaultErrorHandler,
-                           WithColor::defaultWarningHandler));
+  // DWARF context is created in readDebugInfo() if debug info is updated.
+  BC = BinaryContext::createBinaryContext(File, IsPIC, nullptr);
 
   BAT = std::make_unique<BoltAddressTranslation>(*BC);
 
@@ -549,6 +567,7 @@ static bool shouldDisassemble(const BinaryFunction &BF) {
 void RewriteInstance::discoverStorage() {
   NamedRegionTimer T("discoverStorage", "discover storage", TimerGroupName,
                      TimerGroupDesc, opts::TimeRewrite);
+  MemoryStatsScope M("discoverStorage", "rewrite");
 
   // Stubs are harmful because RuntimeDyld may try to increase the size of
   // sections accounting for stubs when we need those sections to match the
@@ -851,6 +870,8 @@ void RewriteInstance::run() {
          << "\n";
   outs() << "BOLT-INFO: BOLT version: " << BoltRevision << "\n";
 
+  auto WriteMemoryStats = make_scope_exit([] { writeMemoryStats(); });
+
   discoverStorage();
   readSpecialSections();
   adjustCommandLineOptions();
@@ -884,6 +905,8 @@ void RewriteInstance::run() {
 
   runOptimizationPasses();
 
+  recordMemoryStatsFor(*BC);
+
   emitAndLink();
 
   updateMetadata();
@@ -903,6 +926,7 @@ void RewriteInstance::run() {
 void RewriteInstance::discoverFileObjects() {
   NamedRegionTimer T("discoverFileObjects", "discover file objects",
                      TimerGroupName, TimerGroupDesc, opts::TimeRewrite);
+  MemoryStatsScope M("discoverFileObjects", "rewrite");
   FileSymRefs.clear();
   BC->getBinaryFunctions().clear();
   BC->clearBinaryData();
@@ -1566,6 +1590,7 @@ uint64_t RewriteInstance::getLSDAAddress() {
 void RewriteInstance::readSpecialSections() {
   NamedRegionTimer T("readSpecialSections", "read special sections",
                      TimerGroupName, TimerGroupDesc, opts::TimeRewrite);
+  MemoryStatsScope M("readSpecialSections", "rewrite");
 
   bool HasTextRelocations = false;
   bool HasDebugInfo = false;
@@ -1644,10 +1669,14 @@ void RewriteInstance::readSpecialSections() {
   }
 
   // Read EH frame for function boundaries info.
-  Expected<const DWARFDebugFrame *> EHFrameOrError = BC->DwCtx->getEHFrame();
-  if (!EHFrameOrError)
-    report_error("expected valid eh_frame section", EHFrameOrError.takeError());
-  CFIRdWrt.reset(new CFIReaderWriter(*EHFrameOrError.get()));
+  EHFrame = std::make_unique<DWARFDebugFrame>(
+      BC->TheTriple->getArch(), /*IsEH=*/true,
+      EHFrameSection ? EHFrameSection->getAddress() : 0);
+  if (Error E = EHFrame->parse(DWARFDataExtractor(
+          EHFrameSection ? EHFrameSection->getContents() : StringRef(),
+          BC->AsmInfo->isLittleEndian(), BC->AsmInfo->getCodePointerSize())))
+    report_error("expected valid eh_frame section", std::move(E));
+  CFIRdWrt.reset(new CFIReaderWriter(*EHFrame));
 
   // Parse build-id
   parseBuildID();
@@ -1738,6 +1767,14 @@ void RewriteInstance::adjustCommandLineOptions() {
     opts::HotText = false;
   }
 
+  if (opts::TextTiers && !BC->HasRelocations) {
+    errs() << "BOLT-WARNING: text tiers are disabled in non-relocation mode\n";
+    opts::TextTiers = false;
+  } else if (opts::TextTiers && BC->isAArch64()) {
+    errs() << "BOLT-WARNING: text tiers are not supported on AArch64\n";
+    opts::TextTiers = false;
+  }
+
   if (opts::HotText && opts::HotTextMoveSections.getNumOccurrences() == 0) {
     opts::HotTextMoveSections.addValue(".stub");
     opts::HotTextMoveSections.addValue(".mover");
@@ -2755,9 +2792,17 @@ void RewriteInstance::selectFunctionsToProcess() {
 void RewriteInstance::readDebugInfo() {
   NamedRegionTimer T("readDebugInfo", "read debug info", TimerGroupName,
                      TimerGroupDesc, opts::TimeRewrite);
+  MemoryStatsScope M("readDebugInfo", "rewrite");
   if (!opts::UpdateDebugSections)
     return;
 
+  // Debug sections are only parsed when debug info is updated. Otherwise
+  // large debug sections, compressed ones in particular, would be loaded
+  // into memory for nothing.
+  BC->DwCtx = DWARFContext::create(*InputFile, nullptr, opts::DWPPathName,
+                                   WithColor::defaultErrorHandler,
+                                   WithColor::defaultWarningHandler);
+
   BC->preprocessDebugInfo();
 }
 
@@ -2767,6 +2812,7 @@ void RewriteInstance::preprocessProfileData() {
 
   NamedRegionTimer T("preprocessprofile", "pre-process profile data",
                      TimerGroupName, TimerGroupDesc, opts::TimeRewrite);
+  MemoryStatsScope M("preprocessprofile", "rewrite");
 
   outs() << "BOLT-INFO: pre-processing profile using "
          << ProfileReader->getReaderName() << '\n';
@@ -2798,6 +2844,7 @@ void RewriteInstance::processProfileDataPreCFG() {
 
   NamedRegionTimer T("processprofile-precfg", "process profile data pre-CFG",
                      TimerGroupName, TimerGroupDesc, opts::TimeRewrite);
+  MemoryStatsScope M("processprofile-precfg", "rewrite");
 
   if (Error E = ProfileReader->readProfilePreCFG(*BC.get()))
     report_error("cannot read profile pre-CFG", std::move(E));
@@ -2809,6 +2856,7 @@ void RewriteInstance::processProfileData() {
 
   NamedRegionTimer T("processprofile", "process profile data", TimerGroupName,
                      TimerGroupDesc, opts::TimeRewrite);
+  MemoryStatsScope M("processprofile", "rewrite");
 
   if (Error E = ProfileReader->readProfile(*BC.get()))
     report_error("cannot read profile", std::move(E));
@@ -2829,6 +2877,7 @@ void RewriteInstance::processProfileData() {
 void RewriteInstance::disassembleFunctions() {
   NamedRegionTimer T("disassembleFunctions", "disassemble functions",
                      TimerGroupName, TimerGroupDesc, opts::TimeRewrite);
+  MemoryStatsScope M("disassembleFunctions", "rewrite");
   for (auto &BFI : BC->getBinaryFunctions()) {
     BinaryFunction &Function = BFI.second;
 
@@ -2928,6 +2977,7 @@ void RewriteInstance::disassembleFunctions() {
 void RewriteInstance::buildFunctionsCFG() {
   NamedRegionTimer T("buildCFG", "buildCFG", "buildfuncs",
                      "Build Binary Functions", opts::TimeBuild);
+  MemoryStatsScope M("buildCFG", "rewrite");
 
   // Create annotation indices to allow lock-free execution
   BC->MIB->getOrCreateAnnotationIndex("Offset");
@@ -2990,6 +3040,7 @@ void RewriteInstance::postProcessFunctions() {
 void RewriteInstance::runOptimizationPasses() {
   NamedRegionTimer T("runOptimizationPasses", "run optimization passes",
                      TimerGroupName, TimerGroupDesc, opts::TimeRewrite);
+  MemoryStatsScope M("runOptimizationPasses", "rewrite");
   BinaryFunctionPassManager::runAllPasses(*BC);
 }
 
@@ -3064,6 +3115,7 @@ public:
 void RewriteInstance::emitAndLink() {
   NamedRegionTimer T("emitAndLink", "emit and link", TimerGroupName,
                      TimerGroupDesc, opts::TimeRewrite);
+  MemoryStatsScope M("emitAndLink", "rewrite");
   std::error_code EC;
 
   // This is an object file, which we keep for debugging purposes.
@@ -3139,6 +3191,37 @@ void RewriteInstance::emitAndLink() {
   // layout. Only do this for the object created by ourselves.
   updateOutputValues(FinalLayout);
 
+  if (opts::FreeEmittedState) {
+    // Code and output addresses of emitted functions are final. Fragments
+    // holding the encoded code, fixups and relaxable instructions are owned
+    // by sections of BC->Ctx and outlive the streamer, so release them
+    // explicitly. Symbols defined in a released fragment are moved to an
+    // empty fragment of the same section, and remain defined in it.
+    MCAssembler &Assembler =
+        static_cast<MCObjectStreamer *>(Streamer.get())->getAssembler();
+    DenseMap<const MCSection *, MCFragment *> Placeholders;
+    for (MCSection &Section : Assembler)
+      Placeholders[&Section] = new MCDataFragment(&Section);
+    for (const MCSymbol &Symbol : Assembler.symbols()) {
+      if (Symbol.isVariable() || !Symbol.isInSection())
+        continue;
+      auto PI = Placeholders.find(&Symbol.getSection());
+      if (PI != Placeholders.end())
+        Symbol.setFragment(PI->second);
+    }
+    for (MCSection &Section : Assembler) {
+      MCSection::FragmentListType &Fragments = Section.getFragmentList();
+      Fragments.erase(Fragments.begin(), std::prev(Fragments.end()));
+    }
+
+    // Release the assembler, and the per-function state that is only used
+    // for optimization and emission.
+    Streamer.reset();
+    for (BinaryFunction *Function : BC->getAllBinaryFunctions())
+      if (Function->getState() == BinaryFunction::State::Emitted)
+        Function->releaseEmittedState();
+  }
+
   if (RuntimeLibrary *RtLibrary = BC->getRuntimeLibrary()) {
     RtLibrary->link(*BC, ToolPath, *RTDyld, [this](RuntimeDyld &R) {
       this->mapExtraSections(*RTDyld);
@@ -3189,6 +3272,7 @@ void RewriteInstance::updateMetadata() {
   if (opts::UpdateDebugSections) {
     NamedRegionTimer T("updateDebugInfo", "update debug info", TimerGroupName,
                        TimerGroupDesc, opts::TimeRewrite);
+    MemoryStatsScope M("updateDebugInfo", "rewrite");
     DebugInfoRewriter->updateDebugInfo();
   }
 
@@ -3554,11 +3638,16 @@ RewriteInstance::getCodeSections() {
       return false;
 
     // Depending on the option, put main text at the beginning or at the end.
-    if (opts::HotFunctionsAtEnd) {
-      return B->getName() == BC->getMainCodeSectionName();
-    } else {
-      return A->getName() == BC->getMainCodeSectionName();
-    }
+    // Text tiers follow main text in the order of decreasing hotness.
+    auto getRank = [&](const BinarySection *Section) {
+      const StringRef Name = Section->getName();
+      const int Rank = Name == BC->getMainCodeSectionName()      ? 0
+                       : Name == BC->getWarmCodeSectionName()    ? 1
+                       : Name == BC->getStartupCodeSectionName() ? 2
+                                                                 : 3;
+      return opts::HotFunctionsAtEnd ? -Rank : Rank;
+    };
+    return getRank(A) < getRank(B);
   };
 
   // Determine the order of sections.
@@ -3610,7 +3699,12 @@ void RewriteInstance::mapCodeSections(RuntimeDyld &RTDyld) {
     // Allocate sections starting at a given Address.
     auto allocateAt = [&](uint64_t Address) {
       for (BinarySection *Section : CodeSections) {
-        Address = alignTo(Address, Section->getAlignment());
+        uint64_t Alignment = Section->getAlignment();
+        // Text tiers do not share pages.
+        if (opts::TextTiers && Section != &*TextSection &&
+            Section->getName() != BC->getHotTextMoverSectionName())
+          Alignment = std::max<uint64_t>(Alignment, BC->RegularPageSize);
+        Address = alignTo(Address, Alignment);
         Section->setOutputAddress(Address);
         Address += Section->getOutputSize();
       }
@@ -3664,6 +3758,20 @@ void RewriteInstance::mapCodeSections(RuntimeDyld &RTDyld) {
           getFileOffsetForAddress(Section->getOutputAddress()));
     }
 
+    if (opts::TextTiers) {
+      for (const BinarySection *Section : CodeSections) {
+        const uint64_t Start = Section->getOutputAddress();
+        const uint64_t End = Start + Section->getOutputSize();
+        const uint64_t NumPages =
+            (alignTo(End, BC->PageAlign) - alignDown(Start, BC->PageAlign)) /
+            BC->PageAlign;
+        outs() << "BOLT-INFO: text tiers: " << Section->getName() << " at 0x"
+               << Twine::utohexstr(Start) << " with size 0x"
+               << Twine::utohexstr(Section->getOutputSize()) << " spans "
+               << NumPages << " huge pages\n";
+      }
+    }
+
     // Check if we need to insert a padding section for hot text.
     if (PaddingSize && !opts::UseOldText) {
       outs() << "BOLT-INFO: padding code to 0x"
@@ -3800,6 +3908,38 @@ void RewriteInstance::mapDataSections(RuntimeDyld &RTDyld) {
     NextAvailableAddress += Section->getOutputSize();
   }
 
+  // Map sections with reordered data. Writable sections start on a new page
+  // after everything else, so that they can be given a separate writable
+  // segment in patchELFPHDRTable().
+  for (const bool Writable : {false, true}) {
+    for (BinarySection &Section : BC->allocatableSections()) {
+      if (!Section.isReordered() || Section.isReadOnly() == Writable ||
+          !Section.isFinalized() || !Section.hasValidSectionID() ||
+          Section.getOutputAddress())
+        continue;
+      if (Writable && !NewWritableSegmentAddress) {
+        NextAvailableAddress =
+            alignTo(NextAvailableAddress, BC->RegularPageSize);
+        NewWritableSegmentAddress = NextAvailableAddress;
+      }
+      NextAvailableAddress =
+          alignTo(NextAvailableAddress, Section.getAlignment());
+      LLVM_DEBUG(dbgs() << "BOLT: mapping reordered section "
+                        << Section.getName() << " (0x"
+                        << Twine::utohexstr(Section.getAllocAddress())
+                        << ") to 0x" << Twine::utohexstr(NextAvailableAddress)
+                        << '\n');
+
+      RTDyld.reassignSectionAddress(Section.getSectionID(),
+                                    NextAvailableAddress);
+      Section.setOutputAddress(NextAvailableAddress);
+      Section.setOutputFileOffset(
+          getFileOffsetForAddress(NextAvailableAddress));
+
+      NextAvailableAddress += Section.getOutputSize();
+    }
+  }
+
   // Handling for sections with relocations.
   for (BinarySection &Section : BC->sections()) {
     if (!Section.hasSectionRef())
@@ -3871,18 +4011,26 @@ void RewriteInstance::patchELFPHDRTable() {
   const ELFFile<ELF64LE> &Obj = ELF64LEFile->getELFFile();
   raw_fd_ostream &OS = Out->os();
 
+  // Reordered writable data gets its own segment if we write a new pheader
+  // table. Code of a runtime library is linked after the data, and in that
+  // case the new segment is made writable instead.
+  const bool AddWritableSegment = NewWritableSegmentAddress &&
+                                  PHDRTableOffset && !BC->getRuntimeLibrary();
+  const uint64_t NewTextSegmentEnd =
+      AddWritableSegment ? NewWritableSegmentAddress : NextAvailableAddress;
+
   // Write/re-write program headers.
   Phnum = Obj.getHeader().e_phnum;
   if (PHDRTableOffset) {
     // Writing new pheader table.
-    Phnum += 1; // only adding one new segment
+    Phnum += AddWritableSegment ? 2 : 1;
     // Segment size includes the size of the PHDR area.
-    NewTextSegmentSize = NextAvailableAddress - PHDRTableAddress;
+    NewTextSegmentSize = NewTextSegmentEnd - PHDRTableAddress;
   } else {
     assert(!PHDRTableAddress && "unexpected address for program header table");
     // Update existing table.
     PHDRTableOffset = Obj.getHeader().e_phoff;
-    NewTextSegmentSize = NextAvailableAddress - NewTextSegmentAddress;
+    NewTextSegmentSize = NewTextSegmentEnd - NewTextSegmentAddress;
   }
   OS.seek(PHDRTableOffset);
 
@@ -3908,13 +4056,32 @@ void RewriteInstance::patchELFPHDRTable() {
     NewPhdr.p_flags = ELF::PF_X | ELF::PF_R;
     // FIXME: Currently instrumentation is experimental and the runtime data
     // is emitted with code, thus everything needs to be writable
-    if (opts::Instrument)
+    if (opts::Instrument || (NewWritableSegmentAddress && !AddWritableSegment))
       NewPhdr.p_flags |= ELF::PF_W;
     NewPhdr.p_align = BC->PageAlign;
 
     return NewPhdr;
   };
 
+  auto writeNewPhdrs = [&]() {
+    ELF64LE::Phdr NewTextPhdr = createNewTextPhdr();
+    OS.write(reinterpret_cast<const char *>(&NewTextPhdr),
+             sizeof(NewTextPhdr));
+    if (!AddWritableSegment)
+      return;
+
+    ELF64LE::Phdr NewDataPhdr = NewTextPhdr;
+    NewDataPhdr.p_offset = getFileOffsetForAddress(NewWritableSegmentAddress);
+    NewDataPhdr.p_vaddr = NewWritableSegmentAddress;
+    NewDataPhdr.p_paddr = NewWritableSegmentAddress;
+    NewDataPhdr.p_filesz = NextAvailableAddress - NewWritableSegmentAddress;
+    NewDataPhdr.p_memsz = NextAvailableAddress - NewWritableSegmentAddress;
+    NewDataPhdr.p_flags = ELF::PF_R | ELF::PF_W;
+    NewDataPhdr.p_align = BC->RegularPageSize;
+    OS.write(reinterpret_cast<const char *>(&NewDataPhdr),
+             sizeof(NewDataPhdr));
+  };
+
   // Copy existing program headers with modifications.
   for (const ELF64LE::Phdr &Phdr : cantFail(Obj.program_headers())) {
     ELF64LE::Phdr NewPhdr = Phdr;
@@ -3940,20 +4107,16 @@ void RewriteInstance::patchELFPHDRTable() {
       NewPhdr = createNewTextPhdr();
       ModdedGnuStack = true;
     } else if (!opts::UseGnuStack && Phdr.p_type == ELF::PT_DYNAMIC) {
-      // Insert the new header before DYNAMIC.
-      ELF64LE::Phdr NewTextPhdr = createNewTextPhdr();
-      OS.write(reinterpret_cast<const char *>(&NewTextPhdr),
-               sizeof(NewTextPhdr));
+      // Insert the new headers before DYNAMIC.
+      writeNewPhdrs();
       AddedSegment = true;
     }
     OS.write(reinterpret_cast<const char *>(&NewPhdr), sizeof(NewPhdr));
   }
 
   if (!opts::UseGnuStack && !AddedSegment) {
-    // Append the new header to the end of the table.
-    ELF64LE::Phdr NewTextPhdr = createNewTextPhdr();
-    OS.write(reinterpret_cast<const char *>(&NewTextPhdr),
-             sizeof(NewTextPhdr));
+    // Append the new headers to the end of the table.
+    writeNewPhdrs();
   }
 
   assert((!opts::UseGnuStack || ModdedGnuStack) &&
@@ -3977,8 +4140,32 @@ uint64_t appendPadding(raw_pwrite_stream &OS,
   return Offset + PaddingSize;
 }
 
+/// Return contents of an SHF_COMPRESSED section holding \p Contents of a
+/// section aligned at \p Alignment, or an empty string if compression does not
+/// make the section smaller.
+std::string compressSectionContents(StringRef Contents, uint64_t Alignment) {
+  SmallVector<char, 0> Buffer;
+  if (Error E = zlib::compress(Contents, Buffer)) {
+    consumeError(std::move(E));
+    return std::string();
+  }
+  if (sizeof(ELF64LE::Chdr) + Buffer.size() >= Contents.size())
+    return std::string();
+
+  ELF64LE::Chdr Header;
+  Header.ch_type = ELF::ELFCOMPRESS_ZLIB;
+  Header.ch_reserved = 0;
+  Header.ch_size = Contents.size();
+  Header.ch_addralign = std::max<uint64_t>(Alignment, 1);
+  std::string Compressed;
+  Compressed.reserve(sizeof(Header) + Buffer.size());
+  Compressed.append(reinterpret_cast<const char *>(&Header), sizeof(Header));
+  Compressed.append(Buffer.data(), Buffer.size());
+  return Compressed;
 }
 
+} // anonymous namespace
+
 void RewriteInstance::rewriteNoteSections() {
   auto ELF64LEFile = dyn_cast<ELF64LEObjectFile>(InputFile);
   if (!ELF64LEFile) {
@@ -3993,6 +4180,101 @@ void RewriteInstance::rewriteNoteSections() {
          "next available offset calculation failure");
   OS.seek(NextAvailableOffset);
 
+  bool CompressSections = opts::CompressDebugSections;
+  if (CompressSections && !zlib::isAvailable()) {
+    errs() << "BOLT-WARNING: zlib is not available, debug sections will not "
+              "be compressed\n";
+    CompressSections = false;
+  }
+
+  // Compressed sections start with the ELF64 compression header.
+  constexpr uint64_t CompressedSectionAlignment = 8;
+
+  // Debug sections whose final contents are being compressed on the thread
+  // pool. Sections are written in order, so a section waits for the ones
+  // queued before it, and at most MaxPendingSections are held in memory.
+  struct PendingSection {
+    std::string Name;
+    SmallVector<char, 0> Contents;
+    uint64_t Alignment;
+    unsigned ELFType;
+    unsigned ELFFlags;
+    /// Section created by BOLT, or null for a section of the input.
+    BinarySection *NewSection;
+    /// Data of the input section registered if it is written uncompressed.
+    uint8_t *SectionData;
+    std::string Compressed;
+    std::shared_future<void> Done;
+  };
+  std::deque<PendingSection> PendingSections;
+  const size_t MaxPendingSections =
+      opts::NoThreads ? 1 : std::max<unsigned>(opts::ThreadCount, 1);
+  uint64_t NumCompressed = 0;
+  uint64_t UncompressedSize = 0;
+  uint64_t CompressedSize = 0;
+
+  auto writePendingSection = [&](PendingSection &Section) {
+    if (Section.Done.valid())
+      Section.Done.wait();
+
+    if (!Section.Compressed.empty()) {
+      NextAvailableOffset =
+          appendPadding(OS, NextAvailableOffset, CompressedSectionAlignment);
+      OS << Section.Compressed;
+
+      BinarySection &NewSection = BC->registerOrUpdateSection(
+          Section.Name, Section.ELFType,
+          Section.ELFFlags | ELF::SHF_COMPRESSED, nullptr,
+          Section.Compressed.size(), CompressedSectionAlignment);
+      NewSection.setOutputAddress(0);
+      NewSection.setOutputFileOffset(NextAvailableOffset);
+
+      NextAvailableOffset += Section.Compressed.size();
+      ++NumCompressed;
+      UncompressedSize += Section.Contents.size();
+      CompressedSize += Section.Compressed.size();
+      return;
+    }
+
+    // Compression did not pay off.
+    NextAvailableOffset =
+        appendPadding(OS, NextAvailableOffset, Section.Alignment);
+    OS.write(Section.Contents.data(), Section.Contents.size());
+    if (Section.NewSection) {
+      Section.NewSection->setOutputFileOffset(NextAvailableOffset);
+    } else {
+      BinarySection &NewSection = BC->registerOrUpdateSection(
+          Section.Name, Section.ELFType, Section.ELFFlags, Section.SectionData,
+          Section.Contents.size(), Section.Alignment);
+      NewSection.setOutputAddress(0);
+      NewSection.setOutputFileOffset(NextAvailableOffset);
+    }
+    NextAvailableOffset += Section.Contents.size();
+  };
+
+  // Write queued sections until at most \p MaxPending are left.
+  auto flushPendingSections = [&](size_t MaxPending) {
+    while (PendingSections.size() > MaxPending) {
+      writePendingSection(PendingSections.front());
+      PendingSections.pop_front();
+    }
+  };
+
+  auto queueSection = [&](PendingSection &&Section) {
+    flushPendingSections(MaxPendingSections - 1);
+    PendingSections.emplace_back(std::move(Section));
+    PendingSection &Queued = PendingSections.back();
+    auto compress = [&Queued] {
+      Queued.Compressed = compressSectionContents(
+          StringRef(Queued.Contents.data(), Queued.Contents.size()),
+          Queued.Alignment);
+    };
+    if (opts::NoThreads)
+      compress();
+    else
+      Queued.Done = ParallelUtilities::getThreadPool().async(compress);
+  };
+
   // Copy over non-allocatable section contents and update file offsets.
   for (const ELF64LE::Shdr &Section : cantFail(Obj.sections())) {
     if (Section.sh_type == ELF::SHT_NULL)
@@ -4007,6 +4289,53 @@ void RewriteInstance::rewriteNoteSections() {
     if (shouldStrip(Section, SectionName))
       continue;
 
+    // Assemble the final contents of a debug section for compression.
+    if (CompressSections && isDebugSection(SectionName) &&
+        Section.sh_type != ELF::SHT_NOBITS &&
+        !(Section.sh_flags & ELF::SHF_COMPRESSED)) {
+      PendingSection Pending;
+      Pending.Name = std::string(SectionName);
+      Pending.Alignment = Section.sh_addralign;
+      Pending.ELFType = BSec ? BSec->getELFType() : ELF::SHT_PROGBITS;
+      Pending.ELFFlags =
+          BinarySection::getFlags(BSec ? BSec->isReadOnly() : false);
+      Pending.NewSection = nullptr;
+      Pending.SectionData = nullptr;
+      if (!willOverwriteSection(SectionName)) {
+        StringRef Data =
+            InputFile->getData().substr(Section.sh_offset, Section.sh_size);
+        raw_svector_ostream ContentsOS(Pending.Contents);
+        if (BSec && BSec->getPatcher())
+          BSec->getPatcher()->writePatched(ContentsOS, Data);
+        else
+          ContentsOS << Data;
+        if (Section.sh_addralign)
+          Pending.Contents.resize(
+              alignTo(Pending.Contents.size(), Section.sh_addralign), 0);
+      }
+      if (BSec && !BSec->isAllocatable() && BSec->getAllocAddress()) {
+        Pending.SectionData = BSec->getOutputData();
+        Pending.Contents.append(
+            reinterpret_cast<const char *>(BSec->getOutputData()),
+            reinterpret_cast<const char *>(BSec->getOutputData()) +
+                BSec->getOutputSize());
+      }
+      // Resolve pending relocations in the contents. They are relative to the
+      // output file offset of the section, which is the start of the buffer.
+      if (BSec && !BSec->isAllocatable()) {
+        BSec->setOutputFileOffset(0);
+        raw_svector_ostream ContentsOS(Pending.Contents);
+        BSec->flushPendingRelocations(ContentsOS,
+          [this] (const MCSymbol *S) {
+            return getNewValueForSymbol(S->getName());
+          });
+      }
+      queueSection(std::move(Pending));
+      continue;
+    }
+
+    flushPendingSections(0);
+
     // Insert padding as needed.
     NextAvailableOffset =
       appendPadding(OS, NextAvailableOffset, Section.sh_addralign);
@@ -4018,23 +4347,15 @@ void RewriteInstance::rewriteNoteSections() {
     // Copy over section contents unless it's one of the sections we overwrite.
     if (!willOverwriteSection(SectionName)) {
       Size = Section.sh_size;
-      std::string Data =
-          std::string(InputFile->getData().substr(Section.sh_offset, Size));
+      StringRef Data = InputFile->getData().substr(Section.sh_offset, Size);
       if (BSec && BSec->getPatcher())
-        BSec->getPatcher()->patchBinary(Data, 0);
-
-      // Section was expanded, so need to treat it as overwrite.
-      if (Size != Data.size()) {
-        BSec = BC->registerOrUpdateNoteSection(SectionName, copyByteArray(Data),
-                                               Data.size());
-        Size = 0;
-      } else {
+        BSec->getPatcher()->writePatched(OS, Data);
+      else
         OS << Data;
-        DataWritten = true;
+      DataWritten = true;
 
-        // Add padding as the section extension might rely on the alignment.
-        Size = appendPadding(OS, Size, Section.sh_addralign);
-      }
+      // Add padding as the section extension might rely on the alignment.
+      Size = appendPadding(OS, Size, Section.sh_addralign);
     }
 
     // Perform section post-processing.
@@ -4075,6 +4396,10 @@ void RewriteInstance::rewriteNoteSections() {
     NextAvailableOffset += Size;
   }
 
+  // Input sections still queued have no output file offset yet and would be
+  // taken for new sections below.
+  flushPendingSections(0);
+
   // Write new note sections.
   for (BinarySection &Section : BC->nonAllocatableSections()) {
     if (Section.getOutputFileOffset() || !Section.getAllocAddress())
@@ -4082,6 +4407,22 @@ void RewriteInstance::rewriteNoteSections() {
 
     assert(!Section.hasPendingRelocations() && "cannot have pending relocs");
 
+    if (CompressSections && isDebugSection(Section.getName())) {
+      PendingSection Pending;
+      Pending.Name = std::string(Section.getName());
+      StringRef Contents = Section.getOutputContents();
+      Pending.Contents.assign(Contents.begin(), Contents.end());
+      Pending.Alignment = Section.getAlignment();
+      Pending.ELFType = Section.getELFType();
+      Pending.ELFFlags = Section.getELFFlags();
+      Pending.NewSection = &Section;
+      Pending.SectionData = nullptr;
+      queueSection(std::move(Pending));
+      continue;
+    }
+
+    flushPendingSections(0);
+
     NextAvailableOffset = appendPadding(OS, NextAvailableOffset,
                                         Section.getAlignment());
     Section.setOutputFileOffset(NextAvailableOffset);
@@ -4094,6 +4435,13 @@ void RewriteInstance::rewriteNoteSections() {
     OS.write(Section.getOutputContents().data(), Section.getOutputSize());
     NextAvailableOffset += Section.getOutputSize();
   }
+
+  flushPendingSections(0);
+
+  if (CompressSections)
+    outs() << "BOLT-INFO: compressed " << NumCompressed
+           << " debug sections from " << UncompressedSize << " to "
+           << CompressedSize << " bytes\n";
 }
 
 template <typename ELFT>
@@ -4313,6 +4661,11 @@ std::vector<ELFShdrTy> RewriteInstance::getOutputSections(
     NewSection.sh_offset = BSec->getOutputFileOffset();
     NewSection.sh_size = BSec->getOutputSize();
 
+    if (BSec->getELFFlags() & ELF::SHF_COMPRESSED) {
+      NewSection.sh_flags |= ELF::SHF_COMPRESSED;
+      NewSection.sh_addralign = BSec->getAlignment();
+    }
+
     if (NewSection.sh_type == ELF::SHT_SYMTAB) {
       NewSection.sh_info = NumLocalSymbols;
     }
@@ -5119,31 +5472,115 @@ uint64_t RewriteInstance::getNewFunctionAddress(uint64_t OldAddress) {
 }
 
 void RewriteInstance::rewriteFile() {
+  MemoryStatsScope M("rewriteFile", "rewrite");
+
+  // Open the output for reading as well, so that it can be mapped below.
   std::error_code EC;
-  Out = std::make_unique<ToolOutputFile>(opts::OutputFilename, EC,
-                                          sys::fs::OF_None);
-  check_error(EC, "cannot create output executable file");
+  int OutputFD = -1;
+  if (!sys::fs::openFileForReadWrite(opts::OutputFilename, OutputFD,
+                                     sys::fs::CD_CreateAlways,
+                                     sys::fs::OF_None)) {
+    Out = std::make_unique<ToolOutputFile>(opts::OutputFilename, OutputFD);
+  } else {
+    OutputFD = -1;
+    Out = std::make_unique<ToolOutputFile>(opts::OutputFilename, EC,
+                                            sys::fs::OF_None);
+    check_error(EC, "cannot create output executable file");
+  }
 
   raw_fd_ostream &OS = Out->os();
 
-  // Copy allocatable part of the input.
-  OS << InputFile->getData().substr(0, FirstNonAllocatableOffset);
+  // The allocatable part of the output is assembled in a writable mapping of
+  // the output file, where functions and sections are copied in parallel. The
+  // mapped pages are backed by the file and can be written back and reclaimed
+  // by the kernel, unlike an anonymous buffer holding the whole image. If the
+  // output cannot be mapped, e.g. when it is not a regular file, the image is
+  // assembled in memory and written with a single write.
+  const uint64_t ImageSize = getFileOffsetForAddress(NextAvailableAddress);
+  assert(ImageSize >= FirstNonAllocatableOffset &&
+         "next available offset calculation failure");
+  OS.flush();
+  std::unique_ptr<sys::fs::mapped_file_region> ImageMap;
+  if (OutputFD >= 0 &&
+      !sys::fs::resize_file_before_mapping_readwrite(OutputFD, ImageSize)) {
+    ImageMap = std::make_unique<sys::fs::mapped_file_region>(
+        sys::fs::convertFDToNativeFile(OutputFD),
+        sys::fs::mapped_file_region::readwrite, ImageSize, 0, EC);
+    if (EC)
+      ImageMap.reset();
+  }
+  std::unique_ptr<WritableMemoryBuffer> Image;
+  char *ImageData;
+  if (ImageMap) {
+    ImageData = ImageMap->data();
+  } else {
+    Image = WritableMemoryBuffer::getNewUninitMemBuffer(ImageSize);
+    if (!Image) {
+      errs() << "BOLT-ERROR: cannot allocate " << ImageSize
+             << " bytes for the output image\n";
+      exit(1);
+    }
+    ImageData = Image->getBufferStart();
+  }
+
+  auto writeToImage = [&](uint64_t FileOffset, const void *Data,
+                          uint64_t Size) {
+    assert(FileOffset + Size <= ImageSize && "write outside of output image");
+    memcpy(ImageData + FileOffset, Data, Size);
+  };
+
+  // Writes within a phase run concurrently and have to go to disjoint regions
+  // of the image. Regions are given as (file offset, size) pairs.
+  auto assertNoOverlap =
+      [](std::vector<std::pair<uint64_t, uint64_t>> Regions) {
+#ifndef NDEBUG
+    std::sort(Regions.begin(), Regions.end());
+    for (size_t I = 1; I < Regions.size(); ++I)
+      assert(Regions[I - 1].first + Regions[I - 1].second <=
+                 Regions[I].first &&
+             "overlapping writes to output image");
+#endif
+  };
+
+  // Run \p Work for indices [0, NumItems) in blocks on the thread pool.
+  auto runInParallel = [](size_t NumItems,
+                          std::function<void(size_t)> Work) {
+    if (opts::NoThreads || NumItems < 2) {
+      for (size_t I = 0; I < NumItems; ++I)
+        Work(I);
+      return;
+    }
+    const size_t BlockSize = std::max<size_t>(
+        1, NumItems / (opts::TaskCount * opts::ThreadCount));
+    ThreadPool &Pool = ParallelUtilities::getThreadPool();
+    for (size_t Begin = 0; Begin < NumItems; Begin += BlockSize) {
+      const size_t End = std::min(NumItems, Begin + BlockSize);
+      Pool.async([&Work, Begin, End] {
+        for (size_t I = Begin; I < End; ++I)
+          Work(I);
+      });
+    }
+    Pool.wait();
+  };
+
+  // Copy allocatable part of the input, and zero-fill the rest of the image.
+  // A freshly resized output file already reads as zeros.
+  const StringRef AllocatableData =
+      InputFile->getData().substr(0, FirstNonAllocatableOffset);
+  memcpy(ImageData, AllocatableData.data(), AllocatableData.size());
+  if (!ImageMap)
+    memset(ImageData + AllocatableData.size(), 0,
+           ImageSize - AllocatableData.size());
 
   // We obtain an asm-specific writer so that we can emit nops in an
   // architecture-specific way at the end of the function.
   std::unique_ptr<MCAsmBackend> MAB(
       BC->TheTarget->createMCAsmBackend(*BC->STI, *BC->MRI, MCTargetOptions()));
-  auto Streamer = BC->createStreamer(OS);
-  // Make sure output stream has enough reserved space, otherwise
-  // pwrite() will fail.
-  uint64_t Offset = OS.seek(getFileOffsetForAddress(NextAvailableAddress));
-  (void)Offset;
-  assert(Offset == getFileOffsetForAddress(NextAvailableAddress) &&
-         "error resizing output file");
 
   // Overwrite functions with fixed output address. This is mostly used by
   // non-relocation mode, with one exception: injected functions are covered
   // here in both modes.
+  std::vector<BinaryFunction *> OverwrittenFunctions;
   uint64_t CountOverwrittenFunctions = 0;
   uint64_t OverwrittenScore = 0;
   for (BinaryFunction *Function : BC->getAllBinaryFunctions()) {
@@ -5176,41 +5613,13 @@ void RewriteInstance::rewriteFile() {
       continue;
 
     OverwrittenScore += Function->getFunctionScore();
-    // Overwrite function in the output file.
     if (opts::Verbosity >= 2) {
       outs() << "BOLT: rewriting function \"" << *Function << "\"\n";
+      if (Function->isSplit())
+        outs() << "BOLT: rewriting function \"" << *Function
+               << "\" (cold part)\n";
     }
-    OS.pwrite(reinterpret_cast<char *>(Function->getImageAddress()),
-              Function->getImageSize(),
-              Function->getFileOffset());
-
-    // Write nops at the end of the function.
-    if (Function->getMaxSize() != std::numeric_limits<uint64_t>::max()) {
-      uint64_t Pos = OS.tell();
-      OS.seek(Function->getFileOffset() + Function->getImageSize());
-      MAB->writeNopData(OS, Function->getMaxSize() - Function->getImageSize());
-
-      OS.seek(Pos);
-    }
-
-    if (!Function->isSplit()) {
-      ++CountOverwrittenFunctions;
-      if (opts::MaxFunctions &&
-          CountOverwrittenFunctions == opts::MaxFunctions) {
-        outs() << "BOLT: maximum number of functions reached\n";
-        break;
-      }
-      continue;
-    }
-
-    // Write cold part
-    if (opts::Verbosity >= 2) {
-      outs() << "BOLT: rewriting function \"" << *Function
-             << "\" (cold part)\n";
-    }
-    OS.pwrite(reinterpret_cast<char*>(Function->cold().getImageAddress()),
-              Function->cold().getImageSize(),
-              Function->cold().getFileOffset());
+    OverwrittenFunctions.push_back(Function);
 
     ++CountOverwrittenFunctions;
     if (opts::MaxFunctions &&
@@ -5220,6 +5629,42 @@ void RewriteInstance::rewriteFile() {
     }
   }
 
+  std::vector<std::pair<uint64_t, uint64_t>> Regions;
+  for (const BinaryFunction *Function : OverwrittenFunctions) {
+    Regions.emplace_back(Function->getFileOffset(),
+                         Function->getMaxSize() !=
+                                 std::numeric_limits<uint64_t>::max()
+                             ? Function->getMaxSize()
+                             : Function->getImageSize());
+    if (Function->isSplit())
+      Regions.emplace_back(Function->cold().getFileOffset(),
+                           Function->cold().getImageSize());
+  }
+  assertNoOverlap(std::move(Regions));
+
+  runInParallel(OverwrittenFunctions.size(), [&](size_t I) {
+    BinaryFunction *Function = OverwrittenFunctions[I];
+    writeToImage(Function->getFileOffset(),
+                 reinterpret_cast<const void *>(Function->getImageAddress()),
+                 Function->getImageSize());
+
+    // Write nops at the end of the function.
+    if (Function->getMaxSize() != std::numeric_limits<uint64_t>::max()) {
+      SmallString<256> Nops;
+      raw_svector_ostream NopOS(Nops);
+      MAB->writeNopData(NopOS,
+                        Function->getMaxSize() - Function->getImageSize());
+      writeToImage(Function->getFileOffset() + Function->getImageSize(),
+                   Nops.data(), Nops.size());
+    }
+
+    if (Function->isSplit())
+      writeToImage(
+          Function->cold().getFileOffset(),
+          reinterpret_cast<const void *>(Function->cold().getImageAddress()),
+          Function->cold().getImageSize());
+  });
+
   // Print function statistics for non-relocation mode.
   if (!BC->HasRelocations) {
     outs() << "BOLT: " << CountOverwrittenFunctions
@@ -5234,21 +5679,30 @@ void RewriteInstance::rewriteFile() {
   }
 
   if (BC->HasRelocations && opts::TrapOldCode) {
-    uint64_t SavedPos = OS.tell();
     // Overwrite function body to make sure we never execute these instructions.
+    std::vector<BinaryFunction *> TrappedFunctions;
     for (auto &BFI : BC->getBinaryFunctions()) {
       BinaryFunction &BF = BFI.second;
-      if (!BF.getFileOffset() || !BF.isEmitted())
-        continue;
-      OS.seek(BF.getFileOffset());
-      for (unsigned I = 0; I < BF.getMaxSize(); ++I)
-        OS.write((unsigned char)BC->MIB->getTrapFillValue());
-    }
-    OS.seek(SavedPos);
+      if (BF.getFileOffset() && BF.isEmitted())
+        TrappedFunctions.push_back(&BF);
+    }
+    Regions.clear();
+    for (const BinaryFunction *BF : TrappedFunctions)
+      Regions.emplace_back(BF->getFileOffset(), BF->getMaxSize());
+    assertNoOverlap(std::move(Regions));
+
+    const char TrapFillValue = BC->MIB->getTrapFillValue();
+    runInParallel(TrappedFunctions.size(), [&](size_t I) {
+      const BinaryFunction &BF = *TrappedFunctions[I];
+      assert(BF.getFileOffset() + BF.getMaxSize() <= ImageSize &&
+             "write outside of output image");
+      memset(ImageData + BF.getFileOffset(), TrapFillValue, BF.getMaxSize());
+    });
   }
 
   // Write all allocatable sections - reloc-mode text is written here as well
-  for (BinarySection &Section : BC->allocatableSections()) {
+  std::vector<const BinarySection *> NewSections;
+  for (const BinarySection &Section : BC->allocatableSections()) {
     if (!Section.isFinalized() || !Section.getOutputData())
       continue;
 
@@ -5258,9 +5712,27 @@ void RewriteInstance::rewriteFile() {
              << "\n of size " << Section.getOutputSize()
              << "\n at offset " << Section.getOutputFileOffset() << '\n';
     }
-    OS.pwrite(reinterpret_cast<const char*>(Section.getOutputData()),
-              Section.getOutputSize(),
-              Section.getOutputFileOffset());
+    NewSections.push_back(&Section);
+  }
+
+  Regions.clear();
+  for (const BinarySection *Section : NewSections)
+    Regions.emplace_back(Section->getOutputFileOffset(),
+                         Section->getOutputSize());
+  assertNoOverlap(std::move(Regions));
+
+  runInParallel(NewSections.size(), [&](size_t I) {
+    const BinarySection &Section = *NewSections[I];
+    writeToImage(Section.getOutputFileOffset(), Section.getOutputData(),
+                 Section.getOutputSize());
+  });
+
+  if (ImageMap) {
+    ImageMap.reset();
+    OS.seek(ImageSize);
+  } else {
+    OS.write(ImageData, ImageSize);
+    Image.reset();
   }
 
   for (BinarySection &Section : BC->allocatableSections()) {
@@ -25,6 +25,7 @@
 
 namespace llvm {
 
+class DWARFDebugFrame;
 class ToolOutputFile;
 
 namespace bolt {
@@ -230,7 +231,9 @@ private:
                          uint64_t &SymbolAddress, int64_t &Addend,
                          uint64_t &ExtractedValue, bool &Skip) const;
 
-  /// Rewrite non-allocatable sections with modifications.
+  /// Rewrite non-allocatable sections with modifications. With
+  /// -compress-debug-sections, debug sections are compressed on the thread
+  /// pool while the sections before them are written.
   void rewriteNoteSections();
 
   /// Write .eh_frame_hdr.
@@ -405,6 +408,9 @@ private:
   std::unique_ptr<ProfileReaderBase> ProfileReader;
 
   std::unique_ptr<BinaryContext> BC;
+
+  /// Parsed .eh_frame of the input binary, referenced by CFIRdWrt.
+  std::unique_ptr<DWARFDebugFrame> EHFrame;
   std::unique_ptr<CFIReaderWriter> CFIRdWrt;
 
   // Run ExecutionEngine linker with custom memory manager and symbol resolver.
@@ -427,6 +433,9 @@ private:
   uint64_t NewTextSegmentOffset{0};
   uint64_t NewTextSegmentSize{0};
 
+  /// Start of writable reordered data placed after the new code segment.
+  uint64_t NewWritableSegmentAddress{0};
+
   /// Track next available address for new allocatable sections.
   uint64_t NextAvailableAddress{0};
 
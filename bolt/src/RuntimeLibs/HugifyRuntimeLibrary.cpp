@@ -50,8 +50,7 @@ void HugifyRuntimeLibrary::adjustCommandLineOptions(
   opts::HotText = true;
   if (!BC.StartFunctionAddress) {
     errs() << "BOLT-ERROR: hugify runtime libraries require a known entry "
-              "point of "
-              "the input binary\n";
+              "point of the input binary (DT_INIT for shared objects)\n";
     exit(1);
   }
 }
@@ -184,6 +184,19 @@ void InstrumentationRuntimeLibrary::emitBinary(BinaryContext &BC,
   emitString("__bolt_instr_filename", opts::InstrumentationFilename);
   emitString("__bolt_instr_binpath", opts::InstrumentationBinpath);
   emitIntValue("__bolt_instr_use_pid", !!opts::InstrumentationFileAppendPID, 1);
+  emitIntValue("__bolt_instr_num_memop_sites",
+               Summary->MemOpSiteDescriptions.size());
+  emitIntValue("__bolt_instr_num_memop_size_counters",
+               InstrumentationSummary::NUM_MEMOP_SIZE_COUNTERS);
+  // Pairs of the input address of the call site and the index of its first
+  // size counter.
+  emitPadding(8);
+  emitLabelByName("__bolt_instr_memop_sites");
+  for (const MemOpSiteDescription &Desc : Summary->MemOpSiteDescriptions) {
+    emitDataSize(16);
+    Streamer.emitIntValue(Desc.Address, 8);
+    Streamer.emitIntValue(Desc.Counter, 8);
+  }
 
   if (BC.isMachO()) {
     MCSection *TablesSection = BC.Ctx->getMachOSection(
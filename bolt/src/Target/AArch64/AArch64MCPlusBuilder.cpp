@@ -762,6 +762,33 @@ public:
     }
   }
 
+  bool convertMoveToConditionalMove(MCInst &Inst, const MCInst &Branch,
+                                    bool Invert) const override {
+    // Only "mov xd, xm", i.e. "orr xd, xzr, xm". The 32-bit form zeroes the
+    // upper half of the destination even if the condition fails.
+    if (Inst.getOpcode() != AArch64::ORRXrs ||
+        Inst.getOperand(1).getReg() != AArch64::XZR ||
+        Inst.getOperand(3).getImm() != 0)
+      return false;
+
+    // Only flag-based conditional branches.
+    if (Branch.getOpcode() != AArch64::Bcc)
+      return false;
+    auto CC = static_cast<AArch64CC::CondCode>(Branch.getOperand(0).getImm());
+    if (Invert)
+      CC = AArch64CC::getInvertedCondCode(CC);
+
+    const MCOperand Dst = Inst.getOperand(0);
+    const MCOperand Src = Inst.getOperand(2);
+    Inst.clear();
+    Inst.setOpcode(AArch64::CSELXr);
+    Inst.addOperand(Dst);
+    Inst.addOperand(Src);
+    Inst.addOperand(Dst);
+    Inst.addOperand(MCOperand::createImm(CC));
+    return true;
+  }
+
   bool reverseBranchCondition(MCInst &Inst, const MCSymbol *TBB,
                               MCContext *Ctx) const override {
     if (isTB(Inst) || isCB(Inst)) {
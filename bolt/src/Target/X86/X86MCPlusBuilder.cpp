@@ -400,6 +400,30 @@ public:
     }
   }
 
+  bool convertMoveToConditionalMove(MCInst &Inst, const MCInst &Branch,
+                                    bool Invert) const override {
+    // CMOV32rr zero-extends the destination even if the condition fails,
+    // hence only 64-bit moves preserve the semantics.
+    if (Inst.getOpcode() != X86::MOV64rr)
+      return false;
+
+    unsigned CC = getCondCode(Branch);
+    if (Invert)
+      CC = getInvertedCondCode(CC);
+    if (CC == X86::COND_INVALID)
+      return false;
+
+    const MCOperand Dst = Inst.getOperand(0);
+    const MCOperand Src = Inst.getOperand(1);
+    Inst.clear();
+    Inst.setOpcode(X86::CMOV64rr);
+    Inst.addOperand(Dst);
+    Inst.addOperand(Dst);
+    Inst.addOperand(Src);
+    Inst.addOperand(MCOperand::createImm(CC));
+    return true;
+  }
+
   unsigned getInvertedCondCode(unsigned CC) const override {
     switch (CC) {
     default: return X86::COND_INVALID;
@@ -637,6 +661,43 @@ public:
     return Inst.getOpcode() == X86::LEA64r;
   }
 
+  bool isRegisterIncrement(const MCInst &Inst, MCPhysReg &Reg,
+                           int64_t &Increment) const override {
+    switch (Inst.getOpcode()) {
+    default:
+      return false;
+    case X86::ADD64ri8:
+    case X86::ADD64ri32:
+    case X86::SUB64ri8:
+    case X86::SUB64ri32:
+      if (!Inst.getOperand(2).isImm())
+        return false;
+      Reg = Inst.getOperand(0).getReg();
+      Increment = Inst.getOperand(2).getImm();
+      if (::isSUB(Inst.getOpcode()))
+        Increment = -Increment;
+      return true;
+    case X86::INC64r:
+    case X86::DEC64r:
+      Reg = Inst.getOperand(0).getReg();
+      Increment = Inst.getOpcode() == X86::INC64r ? 1 : -1;
+      return true;
+    case X86::LEA64r: {
+      unsigned BaseReg, IndexReg, SegReg;
+      int64_t Scale, Disp;
+      const MCExpr *DispExpr;
+      if (!evaluateX86MemoryOperand(Inst, &BaseReg, &Scale, &IndexReg, &Disp,
+                                    &SegReg, &DispExpr) ||
+          DispExpr || IndexReg != X86::NoRegister ||
+          SegReg != X86::NoRegister || BaseReg != Inst.getOperand(0).getReg())
+        return false;
+      Reg = BaseReg;
+      Increment = Disp;
+      return true;
+    }
+    }
+  }
+
   bool isMOVSX64rm32(const MCInst &Inst) const override {
     return Inst.getOpcode() == X86::MOVSX64rm32;
   }
@@ -2873,6 +2934,58 @@ public:
     return true;
   }
 
+  bool createPrefetch(MCInst &Inst, const MCInst &MemInst,
+                      int64_t Offset) const override {
+    unsigned BaseReg, IndexReg, SegReg;
+    int64_t Scale, Disp;
+    const MCExpr *DispExpr;
+    if (!evaluateX86MemoryOperand(MemInst, &BaseReg, &Scale, &IndexReg, &Disp,
+                                  &SegReg, &DispExpr) ||
+        DispExpr || BaseReg == X86::RIP || !isInt<32>(Disp + Offset))
+      return false;
+
+    Inst.clear();
+    Inst.setOpcode(X86::PREFETCHT0);
+    Inst.addOperand(MCOperand::createReg(BaseReg));
+    Inst.addOperand(MCOperand::createImm(Scale));
+    Inst.addOperand(MCOperand::createReg(IndexReg));
+    Inst.addOperand(MCOperand::createImm(Disp + Offset));
+    Inst.addOperand(MCOperand::createReg(SegReg));
+    return true;
+  }
+
+  std::vector<MCInst> createNoops(uint64_t Size) const override {
+    std::vector<MCInst> Code;
+    while (Size) {
+      // Multi-byte nops use the memory form "nopl/nopw disp(base,index,1)".
+      // The base register and displacement are picked to force the encoder to
+      // emit the desired displacement size, e.g. %rbp always needs disp8.
+      // A 2-byte chunk is emitted as two single-byte nops.
+      const uint64_t ChunkSize = Size == 2 ? 1 : std::min<uint64_t>(Size, 9);
+      Size -= ChunkSize;
+      if (ChunkSize == 1) {
+        Code.emplace_back(MCInstBuilder(X86::NOOP));
+        continue;
+      }
+
+      const unsigned Opcode =
+          (ChunkSize == 6 || ChunkSize == 9) ? X86::NOOPW : X86::NOOPL;
+      const bool HasIndex = ChunkSize == 5 || ChunkSize == 6 ||
+                            ChunkSize == 8 || ChunkSize == 9;
+      const int64_t Disp = ChunkSize >= 7 ? 0x80 : 0;
+      const unsigned BaseReg =
+          (ChunkSize == 4 || ChunkSize == 5 || ChunkSize == 6) ? X86::RBP
+                                                               : X86::RAX;
+      Code.emplace_back(MCInstBuilder(Opcode)
+                            .addReg(BaseReg)
+                            .addImm(1)
+                            .addReg(HasIndex ? X86::RAX : X86::NoRegister)
+                            .addImm(Disp)
+                            .addReg(X86::NoRegister));
+    }
+    return Code;
+  }
+
   bool createReturn(MCInst &Inst) const override {
     Inst.setOpcode(X86::RETQ);
     return true;
@@ -2923,6 +3036,193 @@ public:
     return Code;
   }
 
+  std::vector<MCInst> createFixedSizeMemcpy(uint64_t Size) const override {
+    // Copy with the largest moves first. The scratch registers are clobbered
+    // by the call being replaced anyway.
+    struct ChunkInfo {
+      uint64_t Size;
+      unsigned LoadOpcode;
+      unsigned StoreOpcode;
+      MCPhysReg Reg;
+    };
+    static const ChunkInfo Chunks[] = {
+        {16, X86::MOVUPSrm, X86::MOVUPSmr, X86::XMM0},
+        {8, X86::MOV64rm, X86::MOV64mr, X86::RCX},
+        {4, X86::MOV32rm, X86::MOV32mr, X86::ECX},
+        {2, X86::MOV16rm, X86::MOV16mr, X86::CX},
+        {1, X86::MOV8rm, X86::MOV8mr, X86::CL}};
+
+    std::vector<MCInst> Code;
+    int64_t Offset = 0;
+    for (const ChunkInfo &Chunk : Chunks) {
+      for (; Size >= Chunk.Size; Size -= Chunk.Size, Offset += Chunk.Size) {
+        Code.emplace_back(MCInstBuilder(Chunk.LoadOpcode)
+                              .addReg(Chunk.Reg)
+                              .addReg(X86::RSI)
+                              .addImm(1)
+                              .addReg(X86::NoRegister)
+                              .addImm(Offset)
+                              .addReg(X86::NoRegister));
+        Code.emplace_back(MCInstBuilder(Chunk.StoreOpcode)
+                              .addReg(X86::RDI)
+                              .addImm(1)
+                              .addReg(X86::NoRegister)
+                              .addImm(Offset)
+                              .addReg(X86::NoRegister)
+                              .addReg(Chunk.Reg));
+      }
+    }
+    Code.emplace_back(MCInstBuilder(X86::MOV64rr)
+                          .addReg(X86::RAX)
+                          .addReg(X86::RDI));
+    return Code;
+  }
+
+  std::vector<MCInst> createFixedSizeMemset(uint64_t Size) const override {
+    struct ChunkInfo {
+      uint64_t Size;
+      unsigned StoreOpcode;
+      MCPhysReg Reg;
+    };
+    static const ChunkInfo Chunks[] = {{8, X86::MOV64mr, X86::RCX},
+                                       {4, X86::MOV32mr, X86::ECX},
+                                       {2, X86::MOV16mr, X86::CX},
+                                       {1, X86::MOV8mr, X86::CL}};
+
+    std::vector<MCInst> Code;
+    // Replicate the fill byte into all bytes of RCX.
+    Code.emplace_back(MCInstBuilder(X86::MOVZX32rr8)
+                          .addReg(X86::ECX)
+                          .addReg(X86::SIL));
+    if (Size > 1) {
+      Code.emplace_back(MCInstBuilder(X86::MOV64ri)
+                            .addReg(X86::R8)
+                            .addImm(0x0101010101010101LL));
+      Code.emplace_back(MCInstBuilder(X86::IMUL64rr)
+                            .addReg(X86::RCX)
+                            .addReg(X86::RCX)
+                            .addReg(X86::R8));
+    }
+
+    int64_t Offset = 0;
+    for (const ChunkInfo &Chunk : Chunks) {
+      for (; Size >= Chunk.Size; Size -= Chunk.Size, Offset += Chunk.Size) {
+        Code.emplace_back(MCInstBuilder(Chunk.StoreOpcode)
+                              .addReg(X86::RDI)
+                              .addImm(1)
+                              .addReg(X86::NoRegister)
+                              .addImm(Offset)
+                              .addReg(X86::NoRegister)
+                              .addReg(Chunk.Reg));
+      }
+    }
+    Code.emplace_back(MCInstBuilder(X86::MOV64rr)
+                          .addReg(X86::RAX)
+                          .addReg(X86::RDI));
+    return Code;
+  }
+
+  std::vector<MCInst> createFixedSizeMemcmp(uint64_t Size) const override {
+    // Compare chunks as big-endian unsigned integers, which orders them the
+    // same way as their bytes. The result of each chunk that differs is
+    // written to R8D, starting from the last chunk, so that the first chunk
+    // that differs determines the result.
+    struct ChunkInfo {
+      uint64_t Offset;
+      uint64_t Size;
+    };
+    std::vector<ChunkInfo> Chunks;
+    uint64_t Offset = 0;
+    for (uint64_t ChunkSize : {8, 4, 1})
+      for (; Size - Offset >= ChunkSize; Offset += ChunkSize)
+        Chunks.push_back({Offset, ChunkSize});
+
+    auto createLoad = [](unsigned Opcode, MCPhysReg Reg, MCPhysReg BaseReg,
+                         int64_t Disp) {
+      return MCInstBuilder(Opcode)
+          .addReg(Reg)
+          .addReg(BaseReg)
+          .addImm(1)
+          .addReg(X86::NoRegister)
+          .addImm(Disp)
+          .addReg(X86::NoRegister);
+    };
+
+    std::vector<MCInst> Code;
+    Code.emplace_back(MCInstBuilder(X86::XOR32rr)
+                          .addReg(X86::R8D)
+                          .addReg(X86::R8D)
+                          .addReg(X86::R8D));
+    for (auto CI = Chunks.rbegin(); CI != Chunks.rend(); ++CI) {
+      if (CI->Size == 1) {
+        //   movzbl off(%rdi), %eax
+        //   movzbl off(%rsi), %ecx
+        //   subl %ecx, %eax
+        //   cmovnel %eax, %r8d
+        Code.emplace_back(
+            createLoad(X86::MOVZX32rm8, X86::EAX, X86::RDI, CI->Offset));
+        Code.emplace_back(
+            createLoad(X86::MOVZX32rm8, X86::ECX, X86::RSI, CI->Offset));
+        Code.emplace_back(MCInstBuilder(X86::SUB32rr)
+                              .addReg(X86::EAX)
+                              .addReg(X86::EAX)
+                              .addReg(X86::ECX));
+        Code.emplace_back(MCInstBuilder(X86::CMOV32rr)
+                              .addReg(X86::R8D)
+                              .addReg(X86::R8D)
+                              .addReg(X86::EAX)
+                              .addImm(X86::COND_NE));
+        continue;
+      }
+
+      //   mov off(%rdi), %rax
+      //   mov off(%rsi), %rcx
+      //   bswap %rax
+      //   bswap %rcx
+      //   cmp %rcx, %rax
+      //   seta %r9b
+      //   sbbl %r10d, %r10d
+      //   movzbl %r9b, %r9d
+      //   orl %r10d, %r9d
+      //   cmovnel %r9d, %r8d
+      const bool Is64 = CI->Size == 8;
+      const MCPhysReg RegA = Is64 ? X86::RAX : X86::EAX;
+      const MCPhysReg RegB = Is64 ? X86::RCX : X86::ECX;
+      const unsigned LoadOpcode = Is64 ? X86::MOV64rm : X86::MOV32rm;
+      const unsigned BSwapOpcode = Is64 ? X86::BSWAP64r : X86::BSWAP32r;
+      Code.emplace_back(createLoad(LoadOpcode, RegA, X86::RDI, CI->Offset));
+      Code.emplace_back(createLoad(LoadOpcode, RegB, X86::RSI, CI->Offset));
+      Code.emplace_back(MCInstBuilder(BSwapOpcode).addReg(RegA).addReg(RegA));
+      Code.emplace_back(MCInstBuilder(BSwapOpcode).addReg(RegB).addReg(RegB));
+      Code.emplace_back(MCInstBuilder(Is64 ? X86::CMP64rr : X86::CMP32rr)
+                            .addReg(RegA)
+                            .addReg(RegB));
+      Code.emplace_back(MCInstBuilder(X86::SETCCr)
+                            .addReg(X86::R9B)
+                            .addImm(X86::COND_A));
+      Code.emplace_back(MCInstBuilder(X86::SBB32rr)
+                            .addReg(X86::R10D)
+                            .addReg(X86::R10D)
+                            .addReg(X86::R10D));
+      Code.emplace_back(MCInstBuilder(X86::MOVZX32rr8)
+                            .addReg(X86::R9D)
+                            .addReg(X86::R9B));
+      Code.emplace_back(MCInstBuilder(X86::OR32rr)
+                            .addReg(X86::R9D)
+                            .addReg(X86::R9D)
+                            .addReg(X86::R10D));
+      Code.emplace_back(MCInstBuilder(X86::CMOV32rr)
+                            .addReg(X86::R8D)
+                            .addReg(X86::R8D)
+                            .addReg(X86::R9D)
+                            .addImm(X86::COND_NE));
+    }
+    Code.emplace_back(MCInstBuilder(X86::MOV32rr)
+                          .addReg(X86::EAX)
+                          .addReg(X86::R8D));
+    return Code;
+  }
+
   std::vector<MCInst>
   createCmpJE(MCPhysReg RegNo, int64_t Imm, const MCSymbol *Target,
               MCContext *Ctx) const override {
@@ -3584,6 +3884,48 @@ public:
     return Insts;
   }
 
+  std::vector<MCInst>
+  createInstrSizeCounterIncrement(MCPhysReg SizeReg, uint64_t MaxIndex,
+                                  const MCSymbol *Counters,
+                                  MCContext *Ctx) const override {
+    assert(SizeReg != X86::RAX && SizeReg != X86::RCX &&
+           "size register is used as a scratch register");
+    // The code sequence is:
+    //   pushfq
+    //   push %rax
+    //   push %rcx
+    //   movl $MaxIndex, %eax
+    //   cmp %rax, %SizeReg
+    //   cmovb %SizeReg, %rax
+    //   lea Counters(%rip), %rcx
+    //   lock incq (%rcx,%rax,8)
+    //   pop %rcx
+    //   pop %rax
+    //   popfq
+    std::vector<MCInst> Insts(11);
+    createPushFlags(Insts[0], 8);
+    createPushRegister(Insts[1], X86::RAX, 8);
+    createPushRegister(Insts[2], X86::RCX, 8);
+    Insts[3] = MCInstBuilder(X86::MOV32ri).addReg(X86::EAX).addImm(MaxIndex);
+    Insts[4] = MCInstBuilder(X86::CMP64rr).addReg(SizeReg).addReg(X86::RAX);
+    Insts[5] = MCInstBuilder(X86::CMOV64rr)
+                   .addReg(X86::RAX)
+                   .addReg(X86::RAX)
+                   .addReg(SizeReg)
+                   .addImm(X86::COND_B);
+    createLea(Insts[6], Counters, X86::RCX, Ctx);
+    Insts[7] = MCInstBuilder(X86::LOCK_INC64m)
+                   .addReg(X86::RCX)
+                   .addImm(8)
+                   .addReg(X86::RAX)
+                   .addImm(0)
+                   .addReg(X86::NoRegister);
+    createPopRegister(Insts[8], X86::RCX, 8);
+    createPopRegister(Insts[9], X86::RAX, 8);
+    createPopFlags(Insts[10], 8);
+    return Insts;
+  }
+
   std::vector<MCInst> createInstrumentedIndCallHandlerExitBB() const override {
     const MCPhysReg TempReg = getIntArgRegister(0);
     // We just need to undo the sequence created for every ind call in
@@ -3796,18 +4138,33 @@ public:
         NewCall->push_back(CallInst);
         MCInst &Compare = NewCall->back();
         Compare.clear();
-        if (isBranchOnReg(CallInst)) {
+        if (LoadElim) {
+          // Compare the vtable pointer instead of the method loaded from it.
+          // The last method fetch instruction accesses the vtable through the
+          // vtable register, which the erased fetch instructions leave
+          // pointing at the vtable.
+          unsigned VtableReg;
+          int64_t Scale, Disp;
+          unsigned IndexReg, SegReg;
+          if (!evaluateX86MemoryOperand(*MethodFetchInsns.back(), &VtableReg,
+                                        &Scale, &IndexReg, &Disp, &SegReg))
+            return BlocksVectorTy();
           Compare.setOpcode(X86::CMP64ri32);
+          Compare.addOperand(MCOperand::createReg(VtableReg));
         } else {
-          Compare.setOpcode(X86::CMP64mi32);
-        }
+          if (isBranchOnReg(CallInst)) {
+            Compare.setOpcode(X86::CMP64ri32);
+          } else {
+            Compare.setOpcode(X86::CMP64mi32);
+          }
 
-        // Original call address.
-        for (unsigned i = 0;
-             i < Info->get(CallInst.getOpcode()).getNumOperands();
-             ++i) {
-          if (!CallInst.getOperand(i).isInst())
-            Compare.addOperand(CallInst.getOperand(i));
+          // Original call address.
+          for (unsigned i = 0;
+               i < Info->get(CallInst.getOpcode()).getNumOperands();
+               ++i) {
+            if (!CallInst.getOperand(i).isInst())
+              Compare.addOperand(CallInst.getOperand(i));
+          }
         }
 
         // Target address.
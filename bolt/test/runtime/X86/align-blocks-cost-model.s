@@ -0,0 +1,59 @@
+# Check that the block alignment cost model aligns a hot loop spanning two
+# fetch windows and reports the executed padding and the saved windows.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# RUN: llvm-strip --strip-unneeded %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -o %t.out -data %t.fdata -align-blocks \
+# RUN:   -align-blocks-cost-model -dyno-stats | FileCheck %s
+# RUN: llvm-objdump -d --no-show-raw-insn --disassemble-symbols=work %t.out \
+# RUN:   | FileCheck %s --check-prefix=CHECK-ASM
+# RUN: %t.out
+
+# CHECK: BOLT-INFO: aligner: 24 bytes of padding inserted, saving 1000
+# CHECK-SAME: executed fetch windows in blocks executed 1000 times
+# CHECK: BOLT-INFO: program-wide dynostats after basic block alignment:
+# CHECK: 24 : executed alignment padding bytes
+# CHECK: 1000 : fetch windows saved by alignment
+
+# The loop body is moved from offset 8 to the start of the next window.
+# CHECK-ASM:      xorl %eax, %eax
+# CHECK-ASM-NEXT: nop
+# CHECK-ASM:      {{[0-9a-f]*}}20: addq $4096, %rax
+
+  .text
+  .globl work
+  .type work, %function
+work:
+  pushq %rbx
+  movl $1000, %ebx
+.xor:
+  xorl %eax, %eax
+.loop:
+  addq $0x1000, %rax
+  addq $0x1000, %rax
+  addq $0x1000, %rax
+  addq $0x1000, %rax
+  decl %ebx
+.jnz:
+  jnz .loop
+.exit:
+  popq %rbx
+  retq
+  .size work, .-work
+# FDATA: 1 work #.xor# 1 work #.loop# 0 1
+# FDATA: 1 work #.jnz# 1 work #.loop# 0 999
+# FDATA: 1 work #.jnz# 1 work #.exit# 0 1
+
+  .globl main
+  .type main, %function
+main:
+.call:
+  callq work
+  xorl %eax, %eax
+  retq
+  .size main, .-main
+# FDATA: 1 main #.call# 1 work 0 0 1
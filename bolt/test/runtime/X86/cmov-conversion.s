@@ -0,0 +1,64 @@
+# Check that -cmov-conversion replaces a frequently mispredicted branch over a
+# register move with a conditional move, and that the mispredictions are no
+# longer reported in dyno stats.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# RUN: llvm-strip --strip-unneeded %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -o %t.out -data %t.fdata -cmov-conversion \
+# RUN:   -print-cmov-conversion -print-only=work -dyno-stats | FileCheck %s
+# RUN: %t.out
+
+# CHECK: BOLT-INFO: converted 1 out of 1 frequently mispredicted branches
+# CHECK-SAME: into conditional moves, removing 700 out of 700 mispredictions
+# CHECK-SAME: in 1000 executions
+# CHECK: Binary Function "work" after cmov-conversion
+# CHECK-NOT: jb
+# CHECK: cmovaeq %rsi, %rax
+# CHECK: End of Function "work"
+# CHECK: 700 : mispredicted conditional branches
+# CHECK: 0 : mispredicted conditional branches (-100.0%)
+
+  .text
+  .globl main
+  .type main, %function
+main:
+  movl $3, %edi
+  movl $7, %esi
+.call:
+  callq work
+  cmpq $3, %rax
+  jne .fail
+  movl $9, %edi
+  movl $7, %esi
+  callq work
+  cmpq $7, %rax
+  jne .fail
+  xorl %eax, %eax
+  retq
+.fail:
+  movl $1, %eax
+  retq
+  .size main, .-main
+# FDATA: 1 main #.call# 1 work 0 0 1000
+
+# Keep work in its own section, so that the FDATA offsets are relative to the
+# function start.
+  .section .text.work, "ax", @progbits
+  .globl work
+  .type work, %function
+work:
+  movq %rdi, %rax
+  cmpq $5, %rdi
+.br:
+  jb .join
+.arm:
+  movq %rsi, %rax
+.join:
+  retq
+  .size work, .-work
+# FDATA: 1 work #.br# 1 work #.join# 400 500
+# FDATA: 1 work #.br# 1 work #.arm# 300 500
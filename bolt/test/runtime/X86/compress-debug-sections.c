@@ -0,0 +1,47 @@
+/* Checks that -compress-debug-sections writes debug sections compressed with
+ * SHF_COMPRESSED, and that they decompress to the contents written without
+ * the option.
+ */
+#include <stdio.h>
+
+static int square(int X) { return X * X; }
+
+int main(int argc, char **argv) {
+  printf("%d\n", square(argc + 1));
+  return 0;
+}
+
+/*
+REQUIRES: system-linux, zlib
+
+RUN: %clang %cflags -gdwarf-4 -O0 %s -o %t.exe -Wl,-q
+RUN: llvm-bolt %t.exe -o %t.plain -update-debug-sections
+RUN: llvm-bolt %t.exe -o %t.out -update-debug-sections \
+RUN:   -compress-debug-sections | FileCheck %s
+RUN: llvm-readelf -S %t.out | FileCheck %s --check-prefix=CHECK-SECTIONS
+RUN: llvm-dwarfdump --verify %t.out | FileCheck %s --check-prefix=CHECK-VERIFY
+
+Debug info reads the same from the compressed sections.
+RUN: llvm-dwarfdump --debug-info %t.plain | tail -n +2 > %t.plain.dump
+RUN: llvm-dwarfdump --debug-info %t.out | tail -n +2 > %t.out.dump
+RUN: diff %t.plain.dump %t.out.dump
+
+Sections decompress to the contents written without compression.
+RUN: llvm-objcopy --decompress-debug-sections %t.out %t.decompressed
+RUN: llvm-objcopy --dump-section .debug_info=%t.info \
+RUN:   --dump-section .debug_abbrev=%t.abbrev %t.decompressed %t.unused
+RUN: llvm-objcopy --dump-section .debug_info=%t.plain.info \
+RUN:   --dump-section .debug_abbrev=%t.plain.abbrev %t.plain %t.unused
+RUN: cmp %t.info %t.plain.info
+RUN: cmp %t.abbrev %t.plain.abbrev
+RUN: %t.out | FileCheck %s --check-prefix=CHECK-OUTPUT
+
+CHECK: BOLT-INFO: compressed {{[1-9][0-9]*}} debug sections
+
+CHECK-SECTIONS: .debug_info PROGBITS {{[0-9a-f]+ [0-9a-f]+ [0-9a-f]+ 00}} C 0 0 8
+CHECK-SECTIONS: .debug_abbrev PROGBITS {{[0-9a-f]+ [0-9a-f]+ [0-9a-f]+ 00}} C 0 0 8
+
+CHECK-VERIFY: No errors.
+
+CHECK-OUTPUT: 4
+*/
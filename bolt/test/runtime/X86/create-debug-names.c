@@ -0,0 +1,44 @@
+/* Checks that -create-debug-names adds a .debug_names accelerator table that
+ * indexes the functions, variables and types of the input and passes the
+ * verifier.
+ */
+#include <stdio.h>
+
+struct Point {
+  int X;
+  int Y;
+};
+
+int Counter;
+
+static int square(int X) { return X * X; }
+
+int distance(struct Point P) { return square(P.X) + square(P.Y); }
+
+int main(int argc, char **argv) {
+  struct Point P = {argc, 2};
+  Counter = distance(P);
+  printf("%d\n", Counter);
+  return 0;
+}
+
+/*
+REQUIRES: system-linux
+
+RUN: %clang %cflags -gdwarf-4 -O0 %s -o %t.exe -Wl,-q
+RUN: llvm-bolt %t.exe -o %t.out -update-debug-sections -create-debug-names
+RUN: llvm-dwarfdump --verify --debug-names %t.out | FileCheck %s
+RUN: llvm-dwarfdump --debug-names %t.out \
+RUN:   | FileCheck %s --check-prefix=CHECK-NAMES
+RUN: %t.out | FileCheck %s --check-prefix=CHECK-OUTPUT
+
+CHECK: No errors.
+
+CHECK-NAMES-DAG: String: {{.*}} "main"
+CHECK-NAMES-DAG: String: {{.*}} "distance"
+CHECK-NAMES-DAG: String: {{.*}} "square"
+CHECK-NAMES-DAG: String: {{.*}} "Counter"
+CHECK-NAMES-DAG: String: {{.*}} "Point"
+
+CHECK-OUTPUT: 5
+*/
@@ -0,0 +1,91 @@
+# Check that frame optimizations produce the same output when dataflow
+# analyses keep their per-instruction states in annotations and when they keep
+# them in storage owned by the analysis.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown \
+# RUN:   %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# Delete our BB symbols so BOLT doesn't mark them as entry points
+# RUN: llvm-strip --strip-unneeded %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+
+# RUN: llvm-bolt %t.exe -relocs=1 -frame-opt=all -lite=0 -data %t.fdata \
+# RUN:   -dataflow-dense-state=0 -o %t.annotations | FileCheck %s
+# RUN: llvm-bolt %t.exe -relocs=1 -frame-opt=all -lite=0 -data %t.fdata \
+# RUN:   -dataflow-dense-state=1 -o %t.dense | FileCheck %s
+# RUN: llvm-objcopy --remove-section=.note.bolt_info %t.annotations \
+# RUN:   %t.annotations.cmp
+# RUN: llvm-objcopy --remove-section=.note.bolt_info %t.dense %t.dense.cmp
+# RUN: cmp %t.annotations.cmp %t.dense.cmp
+# RUN: %t.dense
+
+# CHECK: BOLT-INFO: FOP optimized 2 redundant load(s)
+# CHECK: BOLT-INFO: Shrink wrapping moved 2 spills inserting load/stores and 0
+# CHECK-SAME: spills inserting push/pops
+
+# Keep every function in its own section, so that the FDATA offsets are
+# relative to the function start.
+  .text
+  .globl  main
+  .type main, %function
+  .p2align  4
+main:
+# FDATA: 0 [unknown] 0 1 main 0 0 510
+  pushq %rbp
+  movq  %rsp, %rbp
+  pushq %rbx
+  subq  $0x18, %rsp
+  movq  %rdi, -0x18(%rbp)
+  movq  -0x18(%rbp), %rax
+  cmpl  $0x2, %eax
+.J0:
+  jb    .BBend0
+# FDATA: 1 main #.J0# 1 main #.BB0# 0 10
+# FDATA: 1 main #.J0# 1 main #.BBend0# 0 500
+.BB0:
+  movq $2, %rbx
+  xorq %rax, %rax
+  movb mystring, %al
+  addq %rbx, %rax
+  movb %al, mystring
+.BBend0:
+  mov -0x08(%rbp), %rbx
+  xorq %rax, %rax
+  leaveq
+  retq
+  .size main, .-main
+
+  .section .text.foo, "ax", @progbits
+  .globl  foo
+  .type foo, %function
+  .p2align  4
+foo:
+# FDATA: 0 [unknown] 0 1 foo 0 0 510
+  pushq %rbp
+  movq  %rsp, %rbp
+  pushq %rbx
+  subq  $0x18, %rsp
+  movq  %rdi, -0x18(%rbp)
+  movq  -0x18(%rbp), %rax
+  cmpl  $0x2, %eax
+.J1:
+  jb    .BBend1
+# FDATA: 1 foo #.J1# 1 foo #.BB1# 0 10
+# FDATA: 1 foo #.J1# 1 foo #.BBend1# 0 500
+.BB1:
+  movq $2, %rbx
+  xorq %rax, %rax
+  movb mystring, %al
+  addq %rbx, %rax
+  movb %al, mystring
+.BBend1:
+  mov -0x08(%rbp), %rbx
+  xorq %rax, %rax
+  leaveq
+  retq
+  .size foo, .-foo
+
+  .data
+mystring: .asciz "0 is rbx mod 10 contents in decimal\n"
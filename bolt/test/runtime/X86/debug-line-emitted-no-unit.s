@@ -0,0 +1,95 @@
+# Check that the line table of a unit is regenerated rather than copied when it
+# describes an emitted function that is missing from the address ranges of the
+# unit. The unit ranges below only cover main, while its line table also has
+# rows for f. Only f is emitted, so the rows of its original code must go.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# RUN: llvm-objcopy --strip-symbol=.br --strip-symbol=.zero %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -o %t.out -data %t.fdata -update-debug-sections
+# RUN: llvm-nm %t.exe > %t.lines
+# RUN: llvm-dwarfdump --debug-line %t.exe >> %t.lines
+# RUN: llvm-dwarfdump --debug-line %t.out >> %t.lines
+# RUN: FileCheck %s < %t.lines
+# RUN: %t.out
+
+# CHECK: [[#%x,F:]] T f
+# CHECK: [[#%x,MAIN:]] T main
+
+# The input line table has rows for both functions.
+# CHECK:      debug_line[
+# CHECK:      0x[[#%.16x,MAIN]] 3
+# CHECK:      0x[[#%.16x,F]] 11
+
+# The output keeps the rows of main, which is not emitted, and drops the rows
+# of the original code of f.
+# CHECK:      debug_line[
+# CHECK-NOT:  0x[[#%.16x,F]] 11
+# CHECK:      0x[[#%.16x,MAIN]] 3
+# CHECK-NOT:  0x[[#%.16x,F]] 11
+
+  .file 1 "main.c"
+  .text
+  .globl main
+  .type main, %function
+main:
+  .loc 1 3 0
+  xorl %edi, %edi
+  .loc 1 4 0
+  callq f
+  .loc 1 5 0
+  xorl %eax, %eax
+  retq
+.Lmain_end:
+  .size main, .-main
+
+  .section .text.f, "ax", @progbits
+  .globl f
+  .type f, %function
+f:
+  .loc 1 11 0
+  testl %edi, %edi
+.br:
+  jz .zero
+  .loc 1 12 0
+  movl $1, %eax
+  retq
+.zero:
+  .loc 1 14 0
+  xorl %eax, %eax
+  retq
+  .size f, .-f
+# FDATA: 1 f #.br# 1 f #.zero# 0 100
+
+  .section .debug_abbrev, "", @progbits
+.Labbrev_start:
+  .byte 1                       # Abbreviation code
+  .byte 0x11                    # DW_TAG_compile_unit
+  .byte 0                       # DW_CHILDREN_no
+  .byte 0x10                    # DW_AT_stmt_list
+  .byte 0x17                    # DW_FORM_sec_offset
+  .byte 0x11                    # DW_AT_low_pc
+  .byte 0x01                    # DW_FORM_addr
+  .byte 0x12                    # DW_AT_high_pc
+  .byte 0x06                    # DW_FORM_data4
+  .byte 0
+  .byte 0
+  .byte 0
+
+  .section .debug_info, "", @progbits
+  .long .Linfo_end - .Linfo_start # Length of unit
+.Linfo_start:
+  .short 4                      # DWARF version
+  .long .Labbrev_start          # Offset into abbreviation section
+  .byte 8                       # Address size
+  .byte 1                       # DW_TAG_compile_unit
+  .long .Lline_table_start0     # DW_AT_stmt_list
+  .quad main                    # DW_AT_low_pc
+  .long .Lmain_end - main       # DW_AT_high_pc
+.Linfo_end:
+
+  .section .debug_line, "", @progbits
+.Lline_table_start0:
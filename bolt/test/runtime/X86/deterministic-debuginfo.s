@@ -0,0 +1,61 @@
+# Check that -deterministic-debuginfo produces the same debug sections whether
+# compile units are processed in parallel or on a single thread. The binary
+# has two compile units, and splitting main gives its unit non-contiguous
+# address ranges.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown -g %s \
+# RUN:   --defsym FIRST=1 -o %t.first.o
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown -g %s \
+# RUN:   -o %t.second.o
+# RUN: link_fdata %s %t.first.o %t.fdata
+# RUN: llvm-objcopy --strip-symbol=.br --strip-symbol=.ok %t.first.o
+# RUN: %clang %cflags %t.first.o %t.second.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -o %t.threads -data %t.fdata -update-debug-sections \
+# RUN:   -deterministic-debuginfo -reorder-blocks=cache+ -split-functions=3 \
+# RUN:   -thread-count=4
+# RUN: llvm-bolt %t.exe -o %t.nothreads -data %t.fdata \
+# RUN:   -update-debug-sections -deterministic-debuginfo \
+# RUN:   -reorder-blocks=cache+ -split-functions=3 -no-threads
+# The command line recorded in .note.bolt_info differs between the two runs.
+# RUN: llvm-objcopy --remove-section=.note.bolt_info %t.threads \
+# RUN:   %t.threads.stripped
+# RUN: llvm-objcopy --remove-section=.note.bolt_info %t.nothreads \
+# RUN:   %t.nothreads.stripped
+# RUN: cmp %t.threads.stripped %t.nothreads.stripped
+# RUN: llvm-dwarfdump --debug-info %t.threads | FileCheck %s
+# RUN: %t.threads
+
+# CHECK: DW_TAG_compile_unit
+# CHECK: DW_AT_ranges
+# CHECK: DW_TAG_compile_unit
+# CHECK-NOT: DW_TAG_compile_unit
+
+.ifdef FIRST
+  .text
+  .globl main
+  .type main, %function
+main:
+  xorl %edi, %edi
+  callq g
+  testl %eax, %eax
+.br:
+  jz .ok
+  movl $1, %eax
+  retq
+.ok:
+  xorl %eax, %eax
+  retq
+  .size main, .-main
+# FDATA: 1 main #.br# 1 main #.ok# 0 100
+
+.else
+  .text
+  .globl g
+  .type g, %function
+g:
+  xorl %eax, %eax
+  retq
+  .size g, .-g
+.endif
@@ -0,0 +1,150 @@
+# Check that frame optimizations produce the same output when functions are
+# processed on the thread pool and when they are processed sequentially.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown \
+# RUN:   %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# Delete our BB symbols so BOLT doesn't mark them as entry points
+# RUN: llvm-strip --strip-unneeded %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+
+# RUN: llvm-bolt %t.exe -relocs=1 -frame-opt=all -lite=0 -data %t.fdata \
+# RUN:   -no-threads -o %t.serial | FileCheck %s
+# RUN: llvm-bolt %t.exe -relocs=1 -frame-opt=all -lite=0 -data %t.fdata \
+# RUN:   -thread-count=4 -o %t.parallel | FileCheck %s
+# RUN: llvm-objcopy --remove-section=.note.bolt_info %t.serial %t.serial.cmp
+# RUN: llvm-objcopy --remove-section=.note.bolt_info %t.parallel \
+# RUN:   %t.parallel.cmp
+# RUN: cmp %t.serial.cmp %t.parallel.cmp
+# RUN: %t.parallel
+
+# CHECK: BOLT-INFO: FOP optimized 4 redundant load(s)
+# CHECK: BOLT-INFO: Shrink wrapping moved 4 spills inserting load/stores and 0
+# CHECK-SAME: spills inserting push/pops
+
+# Keep every function in its own section, so that the FDATA offsets are
+# relative to the function start.
+  .text
+  .globl  main
+  .type main, %function
+  .p2align  4
+main:
+# FDATA: 0 [unknown] 0 1 main 0 0 510
+  pushq %rbp
+  movq  %rsp, %rbp
+  pushq %rbx
+  subq  $0x18, %rsp
+  movq  %rdi, -0x18(%rbp)
+  movq  -0x18(%rbp), %rax
+  cmpl  $0x2, %eax
+.J0:
+  jb    .BBend0
+# FDATA: 1 main #.J0# 1 main #.BB0# 0 10
+# FDATA: 1 main #.J0# 1 main #.BBend0# 0 500
+.BB0:
+  movq $2, %rbx
+  xorq %rax, %rax
+  movb mystring, %al
+  addq %rbx, %rax
+  movb %al, mystring
+.BBend0:
+  mov -0x08(%rbp), %rbx
+  xorq %rax, %rax
+  leaveq
+  retq
+  .size main, .-main
+
+  .section .text.foo, "ax", @progbits
+  .globl  foo
+  .type foo, %function
+  .p2align  4
+foo:
+# FDATA: 0 [unknown] 0 1 foo 0 0 510
+  pushq %rbp
+  movq  %rsp, %rbp
+  pushq %rbx
+  subq  $0x18, %rsp
+  movq  %rdi, -0x18(%rbp)
+  movq  -0x18(%rbp), %rax
+  cmpl  $0x2, %eax
+.J1:
+  jb    .BBend1
+# FDATA: 1 foo #.J1# 1 foo #.BB1# 0 10
+# FDATA: 1 foo #.J1# 1 foo #.BBend1# 0 500
+.BB1:
+  movq $2, %rbx
+  xorq %rax, %rax
+  movb mystring, %al
+  addq %rbx, %rax
+  movb %al, mystring
+.BBend1:
+  mov -0x08(%rbp), %rbx
+  xorq %rax, %rax
+  leaveq
+  retq
+  .size foo, .-foo
+
+  .section .text.bar, "ax", @progbits
+  .globl  bar
+  .type bar, %function
+  .p2align  4
+bar:
+# FDATA: 0 [unknown] 0 1 bar 0 0 510
+  pushq %rbp
+  movq  %rsp, %rbp
+  pushq %rbx
+  subq  $0x18, %rsp
+  movq  %rdi, -0x18(%rbp)
+  movq  -0x18(%rbp), %rax
+  cmpl  $0x2, %eax
+.J2:
+  jb    .BBend2
+# FDATA: 1 bar #.J2# 1 bar #.BB2# 0 10
+# FDATA: 1 bar #.J2# 1 bar #.BBend2# 0 500
+.BB2:
+  movq $2, %rbx
+  xorq %rax, %rax
+  movb mystring, %al
+  addq %rbx, %rax
+  movb %al, mystring
+.BBend2:
+  mov -0x08(%rbp), %rbx
+  xorq %rax, %rax
+  leaveq
+  retq
+  .size bar, .-bar
+
+  .section .text.baz, "ax", @progbits
+  .globl  baz
+  .type baz, %function
+  .p2align  4
+baz:
+# FDATA: 0 [unknown] 0 1 baz 0 0 510
+  pushq %rbp
+  movq  %rsp, %rbp
+  pushq %rbx
+  subq  $0x18, %rsp
+  movq  %rdi, -0x18(%rbp)
+  movq  -0x18(%rbp), %rax
+  cmpl  $0x2, %eax
+.J3:
+  jb    .BBend3
+# FDATA: 1 baz #.J3# 1 baz #.BB3# 0 10
+# FDATA: 1 baz #.J3# 1 baz #.BBend3# 0 500
+.BB3:
+  movq $2, %rbx
+  xorq %rax, %rax
+  movb mystring, %al
+  addq %rbx, %rax
+  movb %al, mystring
+.BBend3:
+  mov -0x08(%rbp), %rbx
+  xorq %rax, %rax
+  leaveq
+  retq
+  .size baz, .-baz
+
+  .data
+mystring: .asciz "0 is rbx mod 10 contents in decimal\n"
@@ -0,0 +1,49 @@
+/* Checks that releasing emission state with -free-emitted-state does not
+ * change the output binary, including updated debug info and the address
+ * translation tables.
+ */
+#include <stdio.h>
+
+int fib(int x) {
+  if (x < 2)
+    return x;
+  return fib(x - 1) + fib(x - 2);
+}
+
+int classify(int x) {
+  switch (x % 5) {
+  case 0:
+    return 10;
+  case 1:
+    return 20;
+  case 2:
+    return 30;
+  case 3:
+    return 40;
+  default:
+    return 50;
+  }
+}
+
+int main(int argc, char **argv) {
+  printf("%d %d\n", fib(argc + 5), classify(argc));
+  return 0;
+}
+
+/*
+REQUIRES: system-linux
+
+RUN: %clang %cflags -gdwarf-4 -O1 %s -o %t.exe -Wl,-q
+RUN: llvm-bolt %t.exe -o %t.base -lite=0 -reorder-blocks=reverse \
+RUN:   -update-debug-sections -enable-bat
+RUN: llvm-bolt %t.exe -o %t.out -lite=0 -reorder-blocks=reverse \
+RUN:   -update-debug-sections -enable-bat -free-emitted-state
+
+The command line recorded in .note.bolt_info differs between the two runs.
+RUN: llvm-objcopy --remove-section=.note.bolt_info %t.base %t.base.stripped
+RUN: llvm-objcopy --remove-section=.note.bolt_info %t.out %t.out.stripped
+RUN: cmp %t.base.stripped %t.out.stripped
+RUN: %t.out | FileCheck %s
+
+CHECK: 8 20
+*/
@@ -0,0 +1,29 @@
+/* Checks that BOLT correctly remaps hot text of executables built with PIE
+ * to huge pages at run time.
+ */
+#include <stdio.h>
+
+int fib(int x) {
+  if (x < 2)
+    return x;
+  return fib(x - 1) + fib(x - 2);
+}
+
+int main(int argc, char **argv) {
+  printf("fib(%d) = %d\n", argc, fib(argc));
+  return 0;
+}
+
+/*
+REQUIRES: system-linux
+
+RUN: %clang %cflags %s -o %t.exe -Wl,-q -pie -fpie
+
+RUN: llvm-bolt %t.exe -hugify -o %t.hugified
+
+# The hugified program needs to resume execution at the original entry point
+# relative to its load base.
+RUN: %t.hugified 1 2 3 | FileCheck %s -check-prefix=CHECK-OUTPUT
+
+CHECK-OUTPUT: fib(4) = 3
+*/
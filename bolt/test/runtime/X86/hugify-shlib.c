@@ -0,0 +1,49 @@
+/* Checks that BOLT correctly remaps hot text of shared objects to huge pages
+ * at run time, and resumes at the DT_INIT routine of the library.
+ */
+#include <stdio.h>
+
+#ifdef LIB
+static int initialized;
+
+__attribute__((constructor)) static void init(void) { initialized = 1; }
+
+int fib(int x) {
+  if (!initialized)
+    return -1;
+  if (x < 2)
+    return x;
+  return fib(x - 1) + fib(x - 2);
+}
+#endif
+
+#ifndef LIB
+int fib(int x);
+
+int main(int argc, char **argv) {
+  printf("fib(%d) = %d\n", argc, fib(argc));
+  return 0;
+}
+#endif
+
+/*
+REQUIRES: system-linux
+
+RUN: %clang %cflags %s -o %t.so -Wl,-q -fPIC -shared -DLIB
+RUN: %clang %cflags %s -o %t.exe %t.so
+
+RUN: llvm-bolt %t.so -hugify -o %t.hugified.so
+RUN: llvm-readelf -d %t.so | FileCheck %s -check-prefix=CHECK-ORG-INIT
+RUN: llvm-readelf -d %t.hugified.so | FileCheck %s -check-prefix=CHECK-INIT
+
+# The hugify hook replaces DT_INIT of the library. BOLT places the hook with
+# the new text at or above 2MB, past the original segments.
+CHECK-ORG-INIT: (INIT) 0x{{[0-9a-f]{1,5}$}}
+CHECK-INIT: (INIT) 0x{{[2-9a-f][0-9a-f]{5,}$}}
+
+# Constructors of the library need to run after the hook returns.
+RUN: cp %t.hugified.so %t.so
+RUN: %t.exe 1 2 3 | FileCheck %s -check-prefix=CHECK-OUTPUT
+
+CHECK-OUTPUT: fib(4) = 3
+*/
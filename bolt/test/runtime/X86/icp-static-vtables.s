@@ -0,0 +1,90 @@
+# Check that -icp-static-vtables finds the vtable of a promoted method call in
+# vtable symbols of the binary without a memory profile, and compares the
+# vtable pointer instead of loading the method.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# RUN: llvm-strip --strip-unneeded %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -o %t.out -data %t.fdata \
+# RUN:   -indirect-call-promotion=calls -icp-static-vtables -print-icp \
+# RUN:   -print-only=main | FileCheck %s
+# RUN: %t.out
+
+# CHECK: BOLT-INFO: ICP number of method load elimination candidates = 1
+# CHECK: BOLT-INFO: ICP percentage of method calls candidates that have loads
+# CHECK-SAME: eliminated = 100.0%
+# CHECK: BOLT-INFO: ICP number of method calls with vtables found in vtable
+# CHECK-SAME: symbols = 1
+# CHECK: Binary Function "main" after indirect-call-promotion
+# CHECK: cmpq $_ZTV3Foo, %rax
+# CHECK-NEXT: jne
+# CHECK: callq _ZN3Foo3getEv
+# CHECK: End of Function "main"
+
+  .text
+  .globl main
+  .type main, %function
+main:
+  pushq %rbx
+  leaq obj(%rip), %rdi
+  movq (%rdi), %rax
+.call:
+  callq *0x10(%rax)
+  cmpl $42, %eax
+  jne .fail
+  leaq obj2(%rip), %rdi
+  movq (%rdi), %rax
+  callq *0x10(%rax)
+  cmpl $7, %eax
+  jne .fail
+  xorl %eax, %eax
+  popq %rbx
+  retq
+.fail:
+  movl $1, %eax
+  popq %rbx
+  retq
+  .size main, .-main
+# FDATA: 1 main #.call# 1 _ZN3Foo3getEv 0 0 100
+
+  .globl _ZN3Foo3getEv
+  .type _ZN3Foo3getEv, %function
+_ZN3Foo3getEv:
+  movl $42, %eax
+  retq
+  .size _ZN3Foo3getEv, .-_ZN3Foo3getEv
+
+  .globl _ZN3Bar3getEv
+  .type _ZN3Bar3getEv, %function
+_ZN3Bar3getEv:
+  movl $7, %eax
+  retq
+  .size _ZN3Bar3getEv, .-_ZN3Bar3getEv
+
+  .section .data.rel.ro, "aw", @progbits
+  .p2align 3
+  .globl _ZTV3Foo
+  .type _ZTV3Foo, %object
+_ZTV3Foo:
+  .quad 0
+  .quad 0
+  .quad _ZN3Foo3getEv
+  .size _ZTV3Foo, .-_ZTV3Foo
+
+  .globl _ZTV3Bar
+  .type _ZTV3Bar, %object
+_ZTV3Bar:
+  .quad 0
+  .quad 0
+  .quad _ZN3Bar3getEv
+  .size _ZTV3Bar, .-_ZTV3Bar
+
+  .data
+  .p2align 3
+obj:
+  .quad _ZTV3Foo
+obj2:
+  .quad _ZTV3Bar
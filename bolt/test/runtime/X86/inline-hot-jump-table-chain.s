@@ -0,0 +1,116 @@
+# Check that -inline-hot inlines a callee with a jump table through a chain of
+# calls. The table is duplicated into b, and the duplicate has to be
+# duplicated again when b is inlined into a, and then into main.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# RUN: llvm-strip --strip-unneeded %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -o %t.out -data %t.fdata -inline-hot \
+# RUN:   -inline-hot-budget=100 -jump-tables=move -print-finalized \
+# RUN:   -print-only=main | FileCheck %s
+# RUN: %t.out
+# RUN: llvm-bolt %t.exe -o %t.null -data %t.fdata -inline-hot \
+# RUN:   -inline-hot-budget=100 -jump-tables=move -dyno-stats \
+# RUN:   | FileCheck %s --check-prefix=CHECK-DYNO
+
+# CHECK: BOLT-INFO: hot inlining used {{[0-9]+}} of {{[0-9]+}} bytes of code
+# CHECK-SAME: growth budget for 3 out of 3 eligible call sites
+# CHECK: Binary Function "main" after finalize-functions
+# CHECK-NOT: callq
+# CHECK: jmpq *.LduplicatedJT{{[0-9]+}}(,%rdi,8)
+# CHECK: End of Function "main"
+
+# Every call site executed 1000 times is inlined.
+# CHECK-DYNO: 3000 : all function calls
+# CHECK-DYNO: 0 : executed calls removed by inlining
+# CHECK-DYNO: 0 : all function calls (-100.0%)
+# CHECK-DYNO: 3000 : executed calls removed by inlining (+
+
+  .text
+  .globl main
+  .type main, %function
+main:
+  pushq %rbx
+  movl $1000, %ebx
+.loop:
+  movl $2, %edi
+.call_a:
+  callq a
+  decl %ebx
+  jnz .loop
+  subl $11, %eax
+  popq %rbx
+  retq
+  .size main, .-main
+# FDATA: 1 main #.call_a# 1 a 0 0 1000
+
+# Keep every function in its own section, so that the FDATA offsets are
+# relative to the function start.
+  .section .text.a, "ax", @progbits
+  .globl a
+  .type a, %function
+a:
+  testq %rdi, %rdi
+.a_test:
+  js .a_neg
+.a_tail:
+  jmp b
+.a_neg:
+  xorl %eax, %eax
+  retq
+  .size a, .-a
+# FDATA: 1 a #.a_test# 1 a #.a_tail# 0 1000
+# FDATA: 1 a #.a_tail# 1 b 0 0 1000
+
+  .section .text.b, "ax", @progbits
+  .globl b
+  .type b, %function
+b:
+  testq %rdi, %rdi
+.b_test:
+  js .b_neg
+.b_tail:
+  jmp c
+.b_neg:
+  xorl %eax, %eax
+  retq
+  .size b, .-b
+# FDATA: 1 b #.b_test# 1 b #.b_tail# 0 1000
+# FDATA: 1 b #.b_tail# 1 c 0 0 1000
+
+  .section .text.c, "ax", @progbits
+  .globl c
+  .type c, %function
+c:
+  cmpq $3, %rdi
+  ja .default
+.jump:
+  jmpq *.LJT(,%rdi,8)
+.case0:
+  movl $10, %eax
+  retq
+.case1:
+  movl $12, %eax
+  retq
+.case2:
+  movl $11, %eax
+  retq
+.case3:
+  movl $13, %eax
+  retq
+.default:
+  xorl %eax, %eax
+  retq
+  .size c, .-c
+# FDATA: 1 c #.jump# 1 c #.case2# 0 1000
+
+  .section .rodata
+  .p2align 3
+.LJT:
+  .quad .case0
+  .quad .case1
+  .quad .case2
+  .quad .case3
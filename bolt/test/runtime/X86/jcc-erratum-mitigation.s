@@ -0,0 +1,57 @@
+# Check that the JCC erratum mitigation accounts for branch relaxation: the
+# loop branch is relaxed to the long form by the assembler, which makes the
+# fused pair end past a 32-byte boundary. The reported counts should match the
+# emitted code.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# RUN: llvm-strip --strip-unneeded %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -o %t.out -data %t.fdata -jcc-erratum-mitigation \
+# RUN:   | FileCheck %s
+# RUN: llvm-objdump -d --no-show-raw-insn --disassemble-symbols=work %t.out \
+# RUN:   | FileCheck %s --check-prefix=CHECK-ASM
+# RUN: %t.out
+
+# CHECK: BOLT-INFO: JCC erratum: 1 hot branches executed 999 times cross or
+# CHECK-SAME: end on a 32-byte boundary
+# CHECK: BOLT-INFO: JCC erratum: inserted 5 bytes of padding in 1 functions,
+# CHECK-SAME: 0 hot branches executed 0 times remain affected
+
+# The fused pair starts at 0xbb in the input layout. It is moved to the next
+# boundary and the relaxed branch ends before the following one.
+# CHECK-ASM:      {{[0-9a-f]+}}bb: nop
+# CHECK-ASM-NEXT: {{[0-9a-f]+}}c0: decl %ecx
+# CHECK-ASM-NEXT: {{[0-9a-f]+}}c2: jne
+# CHECK-ASM-NEXT: {{[0-9a-f]+}}c8: retq
+
+  .text
+  .globl work
+  .type work, %function
+work:
+  movl $1000, %ecx
+  xorl %eax, %eax
+.loop:
+  .rept 30
+  addq $0x1000, %rax
+  .endr
+  decl %ecx
+.jnz:
+  jnz .loop
+.exit:
+  retq
+  .size work, .-work
+# FDATA: 1 work #.jnz# 1 work #.loop# 0 999
+# FDATA: 1 work #.jnz# 1 work #.exit# 0 1
+
+  .globl main
+  .type main, %function
+main:
+.call:
+  callq work
+  xorl %eax, %eax
+  retq
+  .size main, .-main
+# FDATA: 1 main #.call# 1 work 0 0 1
@@ -0,0 +1,96 @@
+# Check that -unroll-loops unrolls a single-block loop with a high trip count,
+# and that -peel-loops peels a single-block loop with a low trip count without
+# overflowing the estimated counts of its exit edge.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# RUN: llvm-strip --strip-unneeded %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -o %t.out -data %t.fdata -unroll-loops -peel-loops \
+# RUN:   -loop-unroll-factor=4 -print-loop-unrolling -print-only=sum,peel \
+# RUN:   | FileCheck %s
+# RUN: %t.out
+
+# CHECK: BOLT-INFO: unrolled 1 hot loops executed 1600 times and peeled 1 hot
+# CHECK-SAME: loops executed 8000000000 times
+
+# Every copy of the unrolled block keeps the exit test.
+# CHECK: Binary Function "sum" after loop-unrolling
+# CHECK-COUNT-3: je .LFT
+# CHECK: jne .Ltmp
+# CHECK: End of Function "sum"
+
+# The peeled iteration exits with probability 5/8.
+# CHECK: Binary Function "peel" after loop-unrolling
+# CHECK: {{^}}.Lpeel
+# CHECK-NEXT: Exec Count : 5000000000
+# CHECK: Successors: {{.*}}count: 3125000000{{.*}}count: 1875000000
+# CHECK: End of Function "peel"
+
+  .text
+  .globl main
+  .type main, %function
+main:
+  leaq arr(%rip), %rdi
+  movl $16, %esi
+.call_sum:
+  callq sum
+  cmpq $120, %rax
+  jne .fail
+  movl $3, %edi
+.call_peel:
+  callq peel
+  cmpq $3, %rax
+  jne .fail
+  xorl %eax, %eax
+  retq
+.fail:
+  movl $1, %eax
+  retq
+  .size main, .-main
+# FDATA: 1 main #.call_sum# 1 sum 0 0 100
+# FDATA: 1 main #.call_peel# 1 peel 0 0 5000000000
+
+# Keep every function in its own section, so that the FDATA offsets are
+# relative to the function start.
+  .section .text.sum, "ax", @progbits
+  .globl sum
+  .type sum, %function
+sum:
+  xorl %eax, %eax
+.sum_entry:
+  jmp .sum_loop
+.sum_loop:
+  addq (%rdi), %rax
+  addq $8, %rdi
+  decl %esi
+.sum_br:
+  jnz .sum_loop
+  retq
+  .size sum, .-sum
+# FDATA: 1 sum #.sum_entry# 1 sum #.sum_loop# 0 100
+# FDATA: 1 sum #.sum_br# 1 sum #.sum_loop# 0 1500
+
+  .section .text.peel, "ax", @progbits
+  .globl peel
+  .type peel, %function
+peel:
+  xorl %eax, %eax
+.peel_entry:
+  jmp .peel_loop
+.peel_loop:
+  incq %rax
+  decl %edi
+.peel_br:
+  jnz .peel_loop
+  retq
+  .size peel, .-peel
+# FDATA: 1 peel #.peel_entry# 1 peel #.peel_loop# 0 5000000000
+# FDATA: 1 peel #.peel_br# 1 peel #.peel_loop# 0 3000000000
+
+  .data
+  .p2align 3
+arr:
+  .quad 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
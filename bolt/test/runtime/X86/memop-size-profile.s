@@ -0,0 +1,126 @@
+# Check that -instrument-memop-sizes records the sizes passed to memcpy(),
+# memset() and memcmp(), and that -memop-size-profile specializes the calls
+# for the recorded sizes without changing the behavior of the program.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -instrument -instrument-memop-sizes \
+# RUN:   -instrumentation-file=%t.fdata -o %t.instrumented \
+# RUN:   | FileCheck %s --check-prefix=CHECK-INSTR
+# RUN: %t.instrumented
+# RUN: cat %t.fdata.memop | FileCheck %s --check-prefix=CHECK-PROFILE
+# RUN: llvm-bolt %t.exe -o %t.out -memop-size-profile=%t.fdata.memop \
+# RUN:   | FileCheck %s
+# RUN: %t.out
+
+# CHECK-INSTR: BOLT-INSTRUMENTER: Number of memop size counters: 516 for 4
+# CHECK-INSTR-SAME: call sites
+
+# Sizes of 128 and above are counted together.
+# CHECK-PROFILE-DAG: {{^[0-9a-f]+}} 16 8{{$}}
+# CHECK-PROFILE-DAG: {{^[0-9a-f]+}} 128 2{{$}}
+# CHECK-PROFILE-DAG: {{^[0-9a-f]+}} 8 10{{$}}
+# CHECK-PROFILE-DAG: {{^[0-9a-f]+}} 12 10{{$}}
+# CHECK-PROFILE-DAG: {{^[0-9a-f]+}} 12 30{{$}}
+
+# CHECK: BOLT-INFO: specialized 4 memcpy(), memset() and memcmp() call sites
+# CHECK-SAME: for 4 sizes, removing 58 out of 60 profiled calls
+
+  .text
+  .globl main
+  .type main, %function
+main:
+  pushq %rbx
+  movl $10, %ebx
+.loop:
+  leaq dst(%rip), %rdi
+  leaq src(%rip), %rsi
+  movl $16, %edx
+  cmpl $2, %ebx
+  ja .copy
+  movl $200, %edx
+.copy:
+  callq memcpy
+  leaq buf(%rip), %rdi
+  movl $0x5a, %esi
+  movl $8, %edx
+  callq memset
+  leaq dst(%rip), %rdi
+  leaq src(%rip), %rsi
+  movl $12, %edx
+  callq memcmp
+  testl %eax, %eax
+  jne .fail
+
+# The first difference decides the result of memcmp(), regardless of later
+# bytes and of the 8-byte chunk it falls into.
+  leaq s1(%rip), %rdi
+  leaq s2(%rip), %rsi
+  callq cmp12
+  testl %eax, %eax
+  jle .fail
+  leaq s2(%rip), %rdi
+  leaq s3(%rip), %rsi
+  callq cmp12
+  testl %eax, %eax
+  jge .fail
+  leaq s1(%rip), %rdi
+  leaq s1(%rip), %rsi
+  callq cmp12
+  testl %eax, %eax
+  jne .fail
+
+  decl %ebx
+  jnz .loop
+
+  movq src(%rip), %rax
+  cmpq %rax, dst(%rip)
+  jne .fail
+  movq src+8(%rip), %rax
+  cmpq %rax, dst+8(%rip)
+  jne .fail
+  movabsq $0x5a5a5a5a5a5a5a5a, %rax
+  cmpq %rax, buf(%rip)
+  jne .fail
+  cmpb $0, buf+8(%rip)
+  jne .fail
+  xorl %eax, %eax
+  popq %rbx
+  retq
+.fail:
+  movl $1, %eax
+  popq %rbx
+  retq
+  .size main, .-main
+
+  .globl cmp12
+  .type cmp12, %function
+cmp12:
+  subq $8, %rsp
+  movl $12, %edx
+  callq memcmp
+  addq $8, %rsp
+  retq
+  .size cmp12, .-cmp12
+
+  .data
+  .p2align 3
+src:
+  .rept 32
+  .quad 0x0807060504030201
+  .endr
+s1:
+  .ascii "abcdefghiJkl"
+s2:
+  .ascii "abcDefghiZkl"
+s3:
+  .ascii "abcDefghiakl"
+
+  .bss
+  .p2align 3
+dst:
+  .zero 256
+buf:
+  .zero 16
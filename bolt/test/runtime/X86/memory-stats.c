@@ -0,0 +1,68 @@
+/* Checks that -memory-stats writes the memory usage of rewriting phases and
+ * optimization passes to a JSON file, and that peaks are reported for the
+ * whole process when they cannot be reset for each phase.
+ */
+#include <stdio.h>
+
+int main(int argc, char **argv) {
+  printf("%d\n", argc);
+  return 0;
+}
+
+/*
+REQUIRES: system-linux
+
+RUN: %clang %cflags -O1 %s -o %t.exe -Wl,-q
+RUN: llvm-bolt %t.exe -o %t.out -memory-stats=%t.json \
+RUN:   | FileCheck %s --check-prefix=CHECK-INFO
+RUN: FileCheck %s --input-file=%t.json
+
+Without resetting the high water mark, peaks cover the process.
+RUN: llvm-bolt %t.exe -o %t.out -memory-stats=%t.process.json \
+RUN:   -memory-stats-reset-peak=0
+RUN: FileCheck %s --check-prefix=CHECK-PROCESS --input-file=%t.process.json
+
+A file that cannot be written is reported without failing the run.
+RUN: llvm-bolt %t.exe -o %t.out -memory-stats=%t.missing/stats.json \
+RUN:   2>&1 | FileCheck %s --check-prefix=CHECK-WARNING
+RUN: %t.out | FileCheck %s --check-prefix=CHECK-OUTPUT
+
+CHECK-INFO: BOLT-INFO: memory statistics written to {{.*}}.json
+
+CHECK: "phases": [
+CHECK:     "group": "rewrite",
+CHECK-NEXT:     "name": "discoverStorage",
+CHECK-NEXT:     "rss-before": {{[0-9]+}},
+CHECK-NEXT:     "rss-after": {{[0-9]+}},
+CHECK-NEXT:     "{{(process-)?}}peak-rss": {{[1-9][0-9]*}},
+CHECK-NEXT:     "heap-before": {{[0-9]+}},
+CHECK-NEXT:     "heap-after": {{[0-9]+}}
+CHECK:     "name": "discoverFileObjects",
+CHECK:     "name": "buildCFG",
+CHECK:     "name": "runOptimizationPasses",
+CHECK:     "group": "pass",
+CHECK:     "name": "emitAndLink",
+CHECK:     "name": "rewriteFile",
+CHECK: "structures": [
+CHECK:     "functions": {{[1-9][0-9]*}},
+CHECK-NEXT:     "basic-blocks": {{[1-9][0-9]*}},
+CHECK-NEXT:     "instructions": {{[1-9][0-9]*}},
+CHECK-NEXT:     "instruction-bytes": {{[1-9][0-9]*}},
+CHECK-NEXT:     "annotated-instructions": {{[0-9]+}},
+CHECK-NEXT:     "annotation-bytes": {{[0-9]+}},
+CHECK-NEXT:     "mc-symbols": {{[1-9][0-9]*}},
+CHECK-NEXT:     "binary-data": {{[1-9][0-9]*}},
+CHECK-NEXT:     "sections": {{[1-9][0-9]*}},
+CHECK-NEXT:     "section-bytes": {{[0-9]+}}
+CHECK: "peak-rss": {{[1-9][0-9]*}}
+
+CHECK-PROCESS: "name": "discoverStorage",
+CHECK-PROCESS-NOT: "peak-rss"
+CHECK-PROCESS: "process-peak-rss": {{[1-9][0-9]*}},
+CHECK-PROCESS-NOT: "peak-rss"
+CHECK-PROCESS: "structures": [
+
+CHECK-WARNING: BOLT-WARNING: cannot write memory statistics to {{.*}}stats.json
+
+CHECK-OUTPUT: 1
+*/
@@ -0,0 +1,144 @@
+# Check that -outline-cold-code replaces a sequence repeated in the cold
+# fragments of two functions with calls to a shared stub, leaves the hot
+# fragments unchanged, and gives the stub an FDE.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# RUN: llvm-strip --strip-unneeded %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -o %t.out -data %t.fdata -reorder-blocks=cache+ \
+# RUN:   -split-functions=3 -outline-cold-code -print-outliner -print-only=f,g \
+# RUN:   | FileCheck %s
+# RUN: llvm-nm %t.out > %t.syms
+# RUN: llvm-dwarfdump --eh-frame %t.out >> %t.syms
+# RUN: FileCheck %s --check-prefix=CHECK-FDE < %t.syms
+# RUN: %t.out
+
+# Two occurrences of a 36-byte sequence are replaced with 5-byte calls, and
+# the stub adds the sequence and a return: 2 * (36 - 5) - 37 = 25 bytes.
+# CHECK: BOLT-INFO: outlined 2 cold instruction sequences into 1 stubs,
+# CHECK-SAME: saving 25 out of {{[0-9]+}} bytes of cold code
+
+# The hot fragments keep all their instructions.
+# CHECK: Binary Function "f" after outliner
+# CHECK:      pushq %rbx
+# CHECK-NEXT: testl %edi, %edi
+# CHECK-NEXT: j{{n?}}e
+# CHECK-NOT:  __bolt_outlined_cold
+# CHECK:      callq h
+# CHECK-NEXT: popq %rbx
+# CHECK-NEXT: retq
+# CHECK-NOT:  __bolt_outlined_cold
+# CHECK:      -------   HOT-COLD SPLIT POINT   -------
+# CHECK:      callq __bolt_outlined_cold_0
+# CHECK-NEXT: popq %rbx
+# CHECK: End of Function "f"
+
+# CHECK: Binary Function "g" after outliner
+# CHECK:      pushq %rbx
+# CHECK-NEXT: cmpl $0x1, %edi
+# CHECK-NEXT: j{{n?}}e
+# CHECK-NOT:  __bolt_outlined_cold
+# CHECK:      callq h
+# CHECK-NEXT: popq %rbx
+# CHECK-NEXT: retq
+# CHECK-NOT:  __bolt_outlined_cold
+# CHECK:      -------   HOT-COLD SPLIT POINT   -------
+# CHECK:      callq __bolt_outlined_cold_0
+# CHECK-NEXT: popq %rbx
+# CHECK: End of Function "g"
+
+# CHECK-FDE: {{0*}}[[#%x,STUB:]] {{[tT]}} __bolt_outlined_cold_0
+# CHECK-FDE: FDE {{.*}} pc=[[#%.8x,STUB]]...
+
+  .text
+  .globl main
+  .type main, %function
+main:
+  pushq %rbx
+  xorl %edi, %edi
+.call_f:
+  callq f
+  testq %rax, %rax
+  jne .fail
+  movl $1, %edi
+  callq f
+  movq %rax, %rbx
+  xorl %edi, %edi
+.call_g:
+  callq g
+  testq %rax, %rax
+  jne .fail
+  movl $1, %edi
+  callq g
+  cmpq %rax, %rbx
+  jne .fail
+  movabsq $0x3333333333333333, %rcx
+  cmpq %rcx, %rax
+  jne .fail
+  xorl %eax, %eax
+  popq %rbx
+  retq
+.fail:
+  movl $1, %eax
+  popq %rbx
+  retq
+  .size main, .-main
+# FDATA: 1 main #.call_f# 1 f 0 0 100
+# FDATA: 1 main #.call_g# 1 g 0 0 100
+
+# Keep every function in its own section, so that the FDATA offsets are
+# relative to the function start.
+  .section .text.f, "ax", @progbits
+  .globl f
+  .type f, %function
+f:
+  pushq %rbx
+  testl %edi, %edi
+.f_br:
+  jz .f_hot
+  movabsq $0x1111111111111111, %rax
+  movabsq $0x1111111111111111, %rcx
+  addq %rcx, %rax
+  movabsq $0x1111111111111111, %rdx
+  addq %rdx, %rax
+  popq %rbx
+  retq
+.f_hot:
+  callq h
+  popq %rbx
+  retq
+  .size f, .-f
+# FDATA: 1 f #.f_br# 1 f #.f_hot# 0 100
+
+  .section .text.g, "ax", @progbits
+  .globl g
+  .type g, %function
+g:
+  pushq %rbx
+  cmpl $1, %edi
+.g_br:
+  jne .g_hot
+  movabsq $0x1111111111111111, %rax
+  movabsq $0x1111111111111111, %rcx
+  addq %rcx, %rax
+  movabsq $0x1111111111111111, %rdx
+  addq %rdx, %rax
+  popq %rbx
+  retq
+.g_hot:
+  callq h
+  popq %rbx
+  retq
+  .size g, .-g
+# FDATA: 1 g #.g_br# 1 g #.g_hot# 0 100
+
+  .section .text.h, "ax", @progbits
+  .globl h
+  .type h, %function
+h:
+  xorl %eax, %eax
+  retq
+  .size h, .-h
@@ -0,0 +1,97 @@
+# Check that -insert-prefetches prefetches a load whose base register is
+# incremented on every loop iteration, and skips a load whose base register
+# is incremented only on some iterations or by a symbolic displacement.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# RUN: llvm-strip --strip-unneeded %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -o %t.out -data %t.fdata -insert-prefetches \
+# RUN:   -prefetch-distance=4 -print-prefetch-insertion -print-only=work \
+# RUN:   | FileCheck %s
+# RUN: %t.out
+
+# CHECK: BOLT-INFO: inserted 1 prefetches for 100 out of 300 memory samples
+# CHECK-SAME: of 3 loads in loops
+# CHECK: Binary Function "work" after prefetch-insertion
+# CHECK:      prefetcht0 0x20(%rdi)
+# CHECK-NEXT: movq (%rdi), %rcx
+# CHECK-NOT:  prefetch
+# CHECK: End of Function "work"
+
+  .text
+  .globl main
+  .type main, %function
+main:
+  leaq arr(%rip), %rdi
+  leaq arr(%rip), %rdx
+  movl $16, %esi
+.call:
+  callq work
+  cmpq $120, %rax
+  jne .fail
+  xorl %eax, %eax
+  retq
+.fail:
+  movl $1, %eax
+  retq
+  .size main, .-main
+# FDATA: 1 main #.call# 1 work 0 0 1
+
+# Keep work in its own section, so that the FDATA offsets are relative to the
+# function start.
+  .section .text.work, "ax", @progbits
+  .globl work
+  .type work, %function
+work:
+  xorl %eax, %eax
+  movq %rsi, %r8
+.loop1:
+.load1:
+  movq (%rdi), %rcx
+  addq %rcx, %rax
+  addq $8, %rdi
+  decq %rsi
+.br1:
+  jnz .loop1
+# The base register of the second load only advances past odd elements.
+.loop2:
+.load2:
+  movq (%rdx), %rcx
+  addq %rcx, %rax
+  testq $1, %rcx
+.br2:
+  jz .skip
+  addq $8, %rdx
+.skip:
+  decq %r8
+.br3:
+  jnz .loop2
+# An lea with a symbolic displacement is not an increment by a known stride.
+# The loop runs once and loads arr[0].
+  movl $1, %r8d
+  xorl %r11d, %r11d
+.loop3:
+  leaq arr(%r11), %r11
+.load3:
+  movq (%r11), %rcx
+  addq %rcx, %rax
+  decq %r8
+  jnz .loop3
+  retq
+  .size work, .-work
+# FDATA: 1 work #.br1# 1 work #.loop1# 0 15
+# FDATA: 1 work #.br2# 1 work #.skip# 0 8
+# FDATA: 1 work #.br3# 1 work #.loop2# 0 15
+# FDATA: 4 work #.load1# 4 arr 0 100
+# FDATA: 4 work #.load2# 4 arr 0 100
+# FDATA: 4 work #.load3# 4 arr 0 100
+
+  .data
+  .globl arr
+  .p2align 3
+arr:
+  .quad 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+  .size arr, .-arr
@@ -0,0 +1,88 @@
+# Check that hot .bss data is moved to a new writable segment and that data
+# written by hot stores starts on a separate cache line.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -o %t.out -data %t.fdata -reorder-data=.bss \
+# RUN:   -reorder-data-algo=affinity -reorder-data-separate-written \
+# RUN:   | FileCheck %s
+# RUN: llvm-readelf -lSW %t.out | FileCheck %s --check-prefix=CHECK-ELF
+# RUN: llvm-nm -n %t.out | FileCheck %s --check-prefix=CHECK-NM
+# RUN: %t.out
+
+# CHECK: BOLT-INFO: reorder-sections: ordering data by affinity
+# CHECK: BOLT-INFO: reorder-data: 3000/3000 (100.0%) events
+
+# The hot part of .bss is stored in the file.
+# CHECK-ELF: .bss PROGBITS [[#%x,BSS:]] [[#%x,BSSOFF:]]
+# CHECK-ELF: LOAD 0x{{0*}}[[#BSSOFF]] 0x{{0*}}[[#BSS]] {{.*}} RW 0x1000
+
+# CHECK-NM:      B cold_c
+# CHECK-NM:      [[#%x,HOTR:]] D hot_r
+# CHECK-NM-NEXT: [[#%x,HOTR + 0x40]] D hot_w
+
+  .text
+  .globl work
+  .type work, %function
+work:
+  movq $3, cold_c(%rip)
+.store_w:
+  movq $5, hot_w(%rip)
+.load_r:
+  movq hot_r(%rip), %rax
+.load_w:
+  addq hot_w(%rip), %rax
+  addq cold_c(%rip), %rax
+  retq
+  .size work, .-work
+
+  .globl main
+  .type main, %function
+main:
+  pushq %rbx
+  movq $1000, %rbx
+.loop:
+.call_work:
+  callq work
+  decq %rbx
+  jnz .loop
+  subq $8, %rax
+  popq %rbx
+  retq
+  .size main, .-main
+
+# FDATA: 1 main #.call_work# 1 work 0 0 1000
+# FDATA: 4 work #.store_w# 4 hot_w 0 1000
+# FDATA: 4 work #.load_r# 4 hot_r 0 1000
+# FDATA: 4 work #.load_w# 4 hot_w 0 1000
+
+  .bss
+  .globl hot_w
+  .type hot_w, @object
+  .align 8
+hot_w:
+  .zero 8
+  .size hot_w, 8
+  .type pad1, @object
+pad1:
+  .zero 4096
+  .size pad1, 4096
+  .globl cold_c
+  .type cold_c, @object
+  .align 8
+cold_c:
+  .zero 8
+  .size cold_c, 8
+  .type pad2, @object
+pad2:
+  .zero 4096
+  .size pad2, 4096
+  .globl hot_r
+  .type hot_r, @object
+  .align 8
+hot_r:
+  .zero 8
+  .size hot_r, 8
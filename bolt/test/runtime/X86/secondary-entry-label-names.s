@@ -0,0 +1,55 @@
+# Check that secondary entry points of a function keep working with local
+# labels created without names, which is the default unless functions are
+# printed, and that printed functions show label names.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+
+# RUN: llvm-bolt %t.exe -o %t.out -lite=0 -reorder-blocks=reverse
+# RUN: llvm-objdump -d --no-show-raw-insn %t.out | FileCheck %s
+# RUN: %t.out
+# RUN: llvm-bolt %t.exe -o %t.unnamed -lite=0 -reorder-blocks=reverse \
+# RUN:   -local-label-names=0
+# RUN: %t.unnamed
+# RUN: llvm-bolt %t.exe -o %t.named -lite=0 -reorder-blocks=reverse \
+# RUN:   -print-cfg -print-only=foo | FileCheck %s --check-prefix=CHECK-NAMED
+# RUN: %t.named
+
+# CHECK: <main>:
+# CHECK: callq 0x[[#%x,FOO:]]
+# CHECK: callq 0x[[#FOO+2]]
+
+# CHECK-NAMED: Binary Function "foo"
+# CHECK-NAMED: Secondary Entry Points : foo_secondary
+# CHECK-NAMED: BB Layout   : .LBB{{[0-9]+}}, .Ltmp{{[0-9]+}}
+# CHECK-NAMED: Secondary Entry Point: foo_secondary
+
+  .text
+  .globl  main
+  .type main, %function
+  .p2align  4
+main:
+  pushq %rbx
+  callq foo
+  movl  %eax, %ebx
+  movl  $5, %eax
+  callq foo_secondary
+  addl  %ebx, %eax
+  subl  $7, %eax
+  popq  %rbx
+  retq
+  .size main, .-main
+
+# foo() returns 1, foo_secondary(%eax) returns %eax + 1.
+  .globl  foo
+  .type foo, %function
+  .p2align  4
+foo:
+  xorl  %eax, %eax
+  .globl  foo_secondary
+foo_secondary:
+  addl  $1, %eax
+  retq
+  .size foo, .-foo
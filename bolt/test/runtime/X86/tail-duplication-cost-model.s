@@ -0,0 +1,95 @@
+# Check that -tail-duplication-cost-model duplicates a tail reached by a
+# frequently taken jump, and rejects the same tail when the jump is rarely
+# taken and the gain in ExtTSP score does not pay for the duplicated code.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# RUN: llvm-strip --strip-unneeded %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: llvm-bolt %t.exe -o %t.out -data %t.fdata -tail-duplication \
+# RUN:   -tail-duplication-cost-model -print-finalized -print-only=hot,warm \
+# RUN:   | FileCheck %s
+# RUN: %t.out
+
+# CHECK: BOLT-INFO: tail duplication possible duplications: 1
+# CHECK: BOLT-INFO: tail duplication cost model rejected 1 duplications and
+# CHECK-SAME: duplicated {{[1-9][0-9]*}} bytes of hot code
+
+# CHECK: Binary Function "hot" after finalize-functions
+# CHECK: BB Layout : {{.*}}.Ltail-dup
+# CHECK: End of Function "hot"
+
+# CHECK: Binary Function "warm" after finalize-functions
+# CHECK-NOT: tail-dup
+# CHECK: End of Function "warm"
+
+  .text
+  .globl main
+  .type main, %function
+main:
+  movl $1, %edi
+.call_hot:
+  callq hot
+  cmpq $8, %rax
+  jne .fail
+  xorl %edi, %edi
+  callq hot
+  cmpq $12, %rax
+  jne .fail
+  movl $1, %edi
+.call_warm:
+  callq warm
+  cmpq $8, %rax
+  jne .fail
+  xorl %eax, %eax
+  retq
+.fail:
+  movl $1, %eax
+  retq
+  .size main, .-main
+# FDATA: 1 main #.call_hot# 1 hot 0 0 1000
+# FDATA: 1 main #.call_warm# 1 warm 0 0 5
+
+# Keep every function in its own section, so that the FDATA offsets are
+# relative to the function start.
+  .section .text.hot, "ax", @progbits
+  .globl hot
+  .type hot, %function
+hot:
+  testq %rdi, %rdi
+.hot_br:
+  jnz .hot_jump
+  movq $5, %rax
+.hot_tail:
+  addq $3, %rax
+  addq $4, %rax
+  retq
+.hot_jump:
+  movq %rdi, %rax
+.hot_jmp:
+  jmp .hot_tail
+  .size hot, .-hot
+# FDATA: 1 hot #.hot_br# 1 hot #.hot_jump# 0 1000
+# FDATA: 1 hot #.hot_jmp# 1 hot #.hot_tail# 0 1000
+
+  .section .text.warm, "ax", @progbits
+  .globl warm
+  .type warm, %function
+warm:
+  testq %rdi, %rdi
+.warm_br:
+  jnz .warm_jump
+  movq $5, %rax
+.warm_tail:
+  addq $3, %rax
+  addq $4, %rax
+  retq
+.warm_jump:
+  movq %rdi, %rax
+.warm_jmp:
+  jmp .warm_tail
+  .size warm, .-warm
+# FDATA: 1 warm #.warm_br# 1 warm #.warm_jump# 0 5
+# FDATA: 1 warm #.warm_jmp# 1 warm #.warm_tail# 0 5
@@ -0,0 +1,114 @@
+# Check that -text-tiers places the densest profiled functions into .text,
+# other profiled functions into .text.warm, unprofiled functions listed in the
+# -startup-functions file into .text.startup and the rest into .text.cold, and
+# that each tier starts on a new page.
+
+# REQUIRES: system-linux
+
+# RUN: llvm-mc -filetype=obj -triple x86_64-unknown-unknown %s -o %t.o
+# RUN: link_fdata %s %t.o %t.fdata
+# RUN: llvm-strip --strip-unneeded %t.o
+# RUN: %clang %cflags %t.o -o %t.exe -Wl,-q
+# RUN: echo init > %t.startup
+# RUN: echo missing >> %t.startup
+# RUN: llvm-bolt %t.exe -o %t.out -data %t.fdata -lite=0 -text-tiers \
+# RUN:   -text-tiers-hot-coverage=50 -startup-functions=%t.startup \
+# RUN:   | FileCheck %s
+# RUN: llvm-readelf -S %t.out | FileCheck %s --check-prefix=CHECK-SECTIONS
+# RUN: llvm-objdump -d %t.out | FileCheck %s --check-prefix=CHECK-DISASM
+# RUN: %t.out
+
+# RUN: not llvm-bolt %t.exe -o %t.null -data %t.fdata -text-tiers \
+# RUN:   -startup-functions=%t.nonexistent 2>&1 \
+# RUN:   | FileCheck %s --check-prefix=CHECK-ERROR
+
+# CHECK: BOLT-INFO: text tiers: 1 hot functions cover 5000 out of 8006
+# CHECK-SAME: executed instructions, 2 warm functions, 1 startup functions
+# CHECK-DAG: BOLT-INFO: text tiers: .text at 0x{{[0-9a-f]+}}
+# CHECK-DAG: BOLT-INFO: text tiers: .text.warm at 0x{{[0-9a-f]+}}000 with
+# CHECK-DAG: BOLT-INFO: text tiers: .text.startup at 0x{{[0-9a-f]+}}000 with
+# CHECK-DAG: BOLT-INFO: text tiers: .text.cold at 0x{{[0-9a-f]+}}000 with
+
+# Tiers follow in the order of decreasing hotness.
+# CHECK-SECTIONS:      {{ }}.text PROGBITS
+# CHECK-SECTIONS-NEXT: {{ }}.text.warm PROGBITS {{[0-9a-f]+}}000
+# CHECK-SECTIONS-NEXT: {{ }}.text.startup PROGBITS {{[0-9a-f]+}}000
+# CHECK-SECTIONS-NEXT: {{ }}.text.cold PROGBITS {{[0-9a-f]+}}000
+
+# CHECK-DISASM:      Disassembly of section .text:
+# CHECK-DISASM-NOT:  Disassembly of section
+# CHECK-DISASM:      <hot>:
+# CHECK-DISASM:      Disassembly of section .text.warm:
+# CHECK-DISASM-NOT:  Disassembly of section
+# CHECK-DISASM-DAG:  <main>:
+# CHECK-DISASM-DAG:  <warm>:
+# CHECK-DISASM:      Disassembly of section .text.startup:
+# CHECK-DISASM-NOT:  Disassembly of section
+# CHECK-DISASM:      <init>:
+# CHECK-DISASM:      Disassembly of section .text.cold:
+# CHECK-DISASM-NOT:  Disassembly of section
+# CHECK-DISASM:      <unlikely>:
+
+# CHECK-ERROR: BOLT-ERROR: startup functions file "{{.*}}.nonexistent" can't
+# CHECK-ERROR-SAME: be opened
+
+  .text
+  .globl main
+  .type main, %function
+main:
+  pushq %rbx
+  callq init
+  movl $1000, %ebx
+.loop:
+  callq hot
+  decl %ebx
+.br:
+  jnz .loop
+.call:
+  callq warm
+  xorl %eax, %eax
+  popq %rbx
+  retq
+  .size main, .-main
+# FDATA: 1 main #.br# 1 main #.loop# 0 999
+
+  .globl hot
+  .type hot, %function
+hot:
+  xorl %eax, %eax
+  addl $1, %eax
+  addl $2, %eax
+  addl $3, %eax
+  retq
+  .size hot, .-hot
+# FDATA: 1 main #.loop# 1 hot 0 0 1000
+
+  .globl warm
+  .type warm, %function
+warm:
+  xorl %eax, %eax
+  nop
+  nop
+  nop
+  nop
+  nop
+  nop
+  nop
+  nop
+  retq
+  .size warm, .-warm
+# FDATA: 1 main #.call# 1 warm 0 0 1
+
+  .globl init
+  .type init, %function
+init:
+  xorl %eax, %eax
+  retq
+  .size init, .-init
+
+  .globl unlikely
+  .type unlikely, %function
+unlikely:
+  xorl %eax, %eax
+  retq
+  .size unlikely, .-unlikely
@@ -318,6 +318,10 @@ class MCDwarfLineTable {
   MCDwarfLineTableHeader Header;
   MCLineSection MCLineSections;
 
+  /// Contents of the line table to be emitted as is instead of the header
+  /// and line entries.
+  StringRef RawData;
+
 public:
   // This emits the Dwarf file and the line tables for all Compile Units.
   static void emit(MCStreamer *MCOS, MCDwarfLineTableParams Params);
@@ -366,6 +370,10 @@ public:
     Header.Label = Label;
   }
 
+  void setRawData(StringRef Data) { RawData = Data; }
+
+  StringRef getRawData() const { return RawData; }
+
   const SmallVectorImpl<std::string> &getMCDwarfDirs() const {
     return Header.MCDwarfDirs;
   }
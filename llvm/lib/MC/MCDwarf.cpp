@@ -549,6 +549,15 @@ MCDwarfLineTableHeader::Emit(MCStreamer *MCOS, MCDwarfLineTableParams Params,
 
 void MCDwarfLineTable::emitCU(MCStreamer *MCOS, MCDwarfLineTableParams Params,
                               Optional<MCDwarfLineStr> &LineStr) const {
+  if (!RawData.empty()) {
+    assert(MCLineSections.getMCLineEntries().empty() &&
+           "line entries are not expected for raw line table");
+    if (Header.Label)
+      MCOS->emitLabel(Header.Label);
+    MCOS->emitBytes(RawData);
+    return;
+  }
+
   MCSymbol *LineEndSym = Header.Emit(MCOS, Params, LineStr).second;
 
   // Put out the line tables.